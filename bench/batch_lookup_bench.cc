@@ -0,0 +1,57 @@
+#include <lib/notstd/set.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using bench_set = notstd::set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                              bst_balance::red_black_tag>;
+
+template<class Lookup>
+static void Time(const char* name, size_t lookups, Lookup lookup) {
+    auto start = std::chrono::steady_clock::now();
+    long hits = lookup();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << name << ": " << (lookups / elapsed.count() / 1e6) << " Mlookups/s, " << hits << " hits"
+              << std::endl;
+}
+
+// Random lookups one at a time and in request-sized batches.
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? std::atoi(argv[1]) : 4000000;
+    int lookups = (argc > 2) ? std::atoi(argv[2]) : 4000000;
+    size_t batch = (argc > 3) ? std::atoi(argv[3]) : 256;
+
+    bench_set my_set;
+    for (int i = 0; i < count; ++i) {
+        my_set.insert(static_cast<int>((i * 2654435761u) % (2u * static_cast<unsigned>(count))));
+    }
+
+    std::vector<int> queries(lookups);
+    for (int i = 0; i < lookups; ++i) {
+        queries[i] = static_cast<int>((i * 40503u + 17) % (2u * static_cast<unsigned>(count)));
+    }
+    std::unique_ptr<bool[]> results(new bool[lookups]);
+
+    Time("contains      ", lookups, [&] {
+        long hits = 0;
+        for (int key : queries) {
+            hits += my_set.contains(key);
+        }
+        return hits;
+    });
+    Time("contains_batch", lookups, [&] {
+        for (size_t first = 0; first < queries.size(); first += batch) {
+            size_t width = std::min(batch, queries.size() - first);
+            my_set.contains_batch(std::span<const int>(queries.data() + first, width),
+                                  std::span<bool>(results.get() + first, width));
+        }
+        return std::count(results.get(), results.get() + lookups, true);
+    });
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include <lib/notstd/set.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+template<class Balance>
+using bench_set = notstd::set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>, Balance>;
+
+template<class Set>
+static void SortedInsert(const char* name, int count) {
+    auto start = std::chrono::steady_clock::now();
+
+    Set my_set;
+    for (int i = 0; i < count; ++i) {
+        my_set.insert(i);
+    }
+
+    int found = 0;
+    for (int i = 0; i < count; ++i) {
+        found += my_set.contains(i) ? 1 : 0;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << name << ": " << count << " sorted inserts + lookups in " << elapsed.count() << " s ("
+              << (2.0 * count / elapsed.count() / 1e6) << " Mops/s), found " << found << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? std::atoi(argv[1]) : 20000;
+
+    SortedInsert<bench_set<bst_balance::none_tag>>("none_tag     ", count);
+    SortedInsert<bench_set<bst_balance::red_black_tag>>("red_black_tag", count);
+
+    return 0;
+}
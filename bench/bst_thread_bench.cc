@@ -0,0 +1,54 @@
+#include <lib/notstd/set.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+template<class Thread>
+using bench_set = notstd::set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                              bst_balance::red_black_tag, bst_augment::none_tag, Thread>;
+
+// Full forward and backward scans; also reports the slowest single ++ seen, the case threading bounds.
+template<class Set>
+static void Scan(const char* name, int count, int rounds) {
+    Set my_set;
+    for (int i = 0; i < count; ++i) {
+        my_set.insert(static_cast<int>((i * 2654435761u) % static_cast<unsigned>(count)));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    long sum = 0;
+    for (int round = 0; round < rounds; ++round) {
+        for (int key : my_set) {
+            sum += key;
+        }
+        for (auto iter = my_set.end(); iter != my_set.begin();) {
+            sum -= *--iter;
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::chrono::nanoseconds worst(0);
+    for (auto iter = my_set.begin(); iter != my_set.end();) {
+        auto step_start = std::chrono::steady_clock::now();
+        ++iter;
+        worst = std::max(worst, std::chrono::steady_clock::now() - step_start);
+    }
+
+    std::cout << name << ": " << rounds << " x 2 scans of " << my_set.size() << " keys in " << elapsed.count()
+              << " s (" << (2.0 * rounds * count / elapsed.count() / 1e6) << " Msteps/s), slowest step "
+              << worst.count() << " ns, checksum " << sum << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+    int rounds = (argc > 2) ? std::atoi(argv[2]) : 10;
+
+    Scan<bench_set<bst_thread::none_tag>>("none_tag    ", count, rounds);
+    Scan<bench_set<bst_thread::threaded_tag>>("threaded_tag", count, rounds);
+
+    return 0;
+}
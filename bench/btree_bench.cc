@@ -0,0 +1,80 @@
+#include <lib/notstd/set.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+static size_t live_bytes = 0;
+
+// Counts the bytes a set holds, nodes and padding included.
+template<class Tp>
+struct MeasuringAllocator {
+    using value_type = Tp;
+
+    MeasuringAllocator() = default;
+
+    template<class Up>
+    MeasuringAllocator(const MeasuringAllocator<Up>&) {}
+
+    Tp* allocate(size_t count) {
+        live_bytes += count * sizeof(Tp);
+        return std::allocator<Tp>().allocate(count);
+    }
+
+    void deallocate(Tp* ptr, size_t count) {
+        live_bytes -= count * sizeof(Tp);
+        std::allocator<Tp>().deallocate(ptr, count);
+    }
+
+    template<class Up>
+    bool operator==(const MeasuringAllocator<Up>&) const {
+        return true;
+    }
+};
+
+template<class Backend>
+using bench_set = notstd::set<int, bst_order::in_order_tag, std::less<int>, MeasuringAllocator<int>,
+                              bst_balance::red_black_tag, bst_augment::none_tag, bst_thread::none_tag, Backend>;
+
+// Random hits and misses over a set of count random keys.
+template<class Set>
+static void Lookup(const char* name, int count, int lookups) {
+    size_t bytes_before = live_bytes;
+    Set my_set;
+    for (int i = 0; i < count; ++i) {
+        my_set.insert(static_cast<int>((i * 2654435761u) % (2u * static_cast<unsigned>(count))));
+    }
+    size_t bytes = live_bytes - bytes_before;
+
+    std::vector<int> queries(lookups);
+    for (int i = 0; i < lookups; ++i) {
+        queries[i] = static_cast<int>((i * 40503u + 17) % (2u * static_cast<unsigned>(count)));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    long hits = 0;
+    for (int key : queries) {
+        hits += my_set.contains(key);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << name << ": " << lookups << " lookups in " << my_set.size() << " keys, "
+              << (lookups / elapsed.count() / 1e6) << " Mlookups/s, "
+              << static_cast<double>(bytes) / static_cast<double>(my_set.size()) << " bytes/key, " << hits
+              << " hits" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? std::atoi(argv[1]) : 4000000;
+    int lookups = (argc > 2) ? std::atoi(argv[2]) : 4000000;
+
+    Lookup<bench_set<set_backend::bst_tag>>("bst            ", count, lookups);
+    Lookup<bench_set<set_backend::btree_tag<256>>>("btree_tag<256> ", count, lookups);
+    Lookup<bench_set<set_backend::btree_tag<1024>>>("btree_tag<1024>", count, lookups);
+    Lookup<bench_set<set_backend::btree_tag<4096>>>("btree_tag<4096>", count, lookups);
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <lib/notstd/concurrent/concurrent_set.h>
+#include <lib/notstd/set.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+using locked_set = notstd::set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                               bst_balance::red_black_tag>;
+
+// A notstd::set behind a reader-writer lock, what concurrent_set replaces.
+struct shared_mutex_set {
+    locked_set set;
+    mutable std::shared_mutex mutex;
+
+    bool contains(int key) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return set.contains(key);
+    }
+
+    void insert(int key) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        set.insert(key);
+    }
+
+    void erase(int key) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        set.erase(key);
+    }
+};
+
+// Lookups per second across readers while one writer keeps inserting and erasing.
+template<class Set>
+static void Time(const char* name, Set& my_set, int count, int readers, double seconds) {
+    std::atomic<bool> stop = false;
+    std::atomic<long> lookups = 0;
+
+    std::thread writer([&] {
+        for (unsigned i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+            int key = static_cast<int>((i * 2654435761u) % (2u * static_cast<unsigned>(count)));
+            if (i % 2 == 0) {
+                my_set.insert(key);
+            } else {
+                my_set.erase(key);
+            }
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int reader = 0; reader < readers; ++reader) {
+        threads.emplace_back([&, reader] {
+            long done = 0;
+            for (unsigned i = reader; !stop.load(std::memory_order_relaxed); ++i, ++done) {
+                my_set.contains(static_cast<int>((i * 40503u) % (2u * static_cast<unsigned>(count))));
+            }
+            lookups += done;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    writer.join();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::cout << name << " readers=" << readers << ": " << (lookups / seconds / 1e6) << " Mlookups/s"
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+    int max_readers = (argc > 2) ? std::atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    double seconds = (argc > 3) ? std::atof(argv[3]) : 1.0;
+
+    notstd::concurrent_set<int> concurrent;
+    shared_mutex_set shared;
+    for (int i = 0; i < count; ++i) {
+        int key = static_cast<int>((i * 2654435761u) % (2u * static_cast<unsigned>(count)));
+        concurrent.insert(key);
+        shared.set.insert(key);
+    }
+
+    for (int readers = 1; readers <= std::max(max_readers, 1); readers *= 2) {
+        Time("concurrent_set      ", concurrent, count, readers, seconds);
+        Time("shared_mutex + set  ", shared, count, readers, seconds);
+    }
+
+    return 0;
+}
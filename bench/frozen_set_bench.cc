@@ -0,0 +1,61 @@
+#include <lib/notstd/set.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+template<class Lookup>
+static void Time(const char* name, size_t lookups, Lookup lookup) {
+    auto start = std::chrono::steady_clock::now();
+    long hits = lookup();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << name << ": " << (lookups / elapsed.count() / 1e6) << " Mlookups/s, " << hits << " hits"
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? std::atoi(argv[1]) : 4000000;
+    int lookups = (argc > 2) ? std::atoi(argv[2]) : 4000000;
+
+    notstd::set<int32_t, bst_order::in_order_tag, std::less<int32_t>, std::allocator<int32_t>,
+                bst_balance::red_black_tag> my_set;
+    for (int i = 0; i < count; ++i) {
+        my_set.insert(static_cast<int32_t>((i * 2654435761u) % (2u * static_cast<unsigned>(count))));
+    }
+    notstd::frozen_set<int32_t> frozen = my_set.freeze();
+
+    std::vector<int32_t> queries(lookups);
+    for (int i = 0; i < lookups; ++i) {
+        queries[i] = static_cast<int32_t>((i * 40503u + 17) % (2u * static_cast<unsigned>(count)));
+    }
+    std::unique_ptr<bool[]> results(new bool[lookups]);
+
+    Time("set::contains             ", lookups, [&] {
+        long hits = 0;
+        for (int32_t key : queries) {
+            hits += my_set.contains(key);
+        }
+        return hits;
+    });
+    Time("frozen_set::contains      ", lookups, [&] {
+        long hits = 0;
+        for (int32_t key : queries) {
+            hits += frozen.contains(key);
+        }
+        return hits;
+    });
+    Time("frozen_set::contains_batch", lookups, [&] {
+        frozen.contains_batch(queries, std::span<bool>(results.get(), queries.size()));
+        long hits = 0;
+        for (int i = 0; i < lookups; ++i) {
+            hits += results[i];
+        }
+        return hits;
+    });
+
+    return 0;
+}
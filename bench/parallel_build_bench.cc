@@ -0,0 +1,56 @@
+#include <lib/notstd/set.h>
+#include <lib/notstd/thread_pool.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using rb_set = notstd::set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                           bst_balance::red_black_tag>;
+
+template<class Work>
+static double Seconds(Work work) {
+    auto start = std::chrono::steady_clock::now();
+    work();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+// Cold-start build of a set from unsorted keys with some duplicates: one insert per key against the bulk build
+// under the sequenced policy and on thread pools of growing size.
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? std::atoi(argv[1]) : 10000000;
+    size_t max_workers = (argc > 2) ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+
+    std::vector<int> keys;
+    keys.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        keys.push_back(static_cast<int>((i * 2654435761u) % static_cast<unsigned>(count)));
+    }
+
+    double inserts = Seconds([&] {
+        rb_set my_set;
+        for (int key : keys) {
+            my_set.insert(key);
+        }
+    });
+    std::cout << "inserts:          " << (inserts * 1e3) << " ms" << std::endl;
+
+    double sequenced = Seconds([&] {
+        rb_set my_set(notstd::execution::seq, keys.begin(), keys.end());
+    });
+    std::cout << "seq:              " << (sequenced * 1e3) << " ms" << std::endl;
+
+    for (size_t workers = 1; workers <= max_workers; workers *= 2) {
+        notstd::thread_pool pool(workers);
+        double parallel = Seconds([&] {
+            rb_set my_set(notstd::execution::par(pool), keys.begin(), keys.end());
+        });
+        std::cout << "par, " << workers << " workers:   " << (parallel * 1e3) << " ms" << std::endl;
+    }
+
+    return 0;
+}
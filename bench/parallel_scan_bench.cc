@@ -0,0 +1,66 @@
+#include <lib/notstd/set.h>
+#include <lib/notstd/thread_pool.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using rb_set = notstd::set<long, bst_order::in_order_tag, std::less<long>, std::allocator<long>,
+                           bst_balance::red_black_tag>;
+
+template<class Work>
+static double Seconds(Work work) {
+    auto start = std::chrono::steady_clock::now();
+    work();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+// An aggregate over a whole set: an iterator loop against transform_reduce under the sequenced policy and on
+// thread pools of growing size.
+int main(int argc, char** argv) {
+    long count = (argc > 1) ? std::atol(argv[1]) : 10000000;
+    size_t max_workers = (argc > 2) ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    int rounds = 5;
+
+    std::vector<long> keys;
+    keys.reserve(count);
+    for (long i = 0; i < count; ++i) {
+        keys.push_back(static_cast<long>((i * 2654435761u) % static_cast<unsigned long>(count)));
+    }
+    rb_set my_set(notstd::execution::seq, keys.begin(), keys.end());
+    auto square = [](long key) { return key * key % 1000003; };
+
+    long sink = 0;
+    double loop = Seconds([&] {
+        for (int round = 0; round < rounds; ++round) {
+            for (long key : my_set) {
+                sink += square(key);
+            }
+        }
+    });
+    std::cout << "iterator loop:    " << (loop / rounds * 1e3) << " ms" << std::endl;
+
+    double sequenced = Seconds([&] {
+        for (int round = 0; round < rounds; ++round) {
+            sink += transform_reduce(notstd::execution::seq, my_set, 0L, std::plus<>(), square);
+        }
+    });
+    std::cout << "seq:              " << (sequenced / rounds * 1e3) << " ms" << std::endl;
+
+    for (size_t workers = 1; workers <= max_workers; workers *= 2) {
+        notstd::thread_pool pool(workers);
+        double parallel = Seconds([&] {
+            for (int round = 0; round < rounds; ++round) {
+                sink += transform_reduce(notstd::execution::par(pool), my_set, 0L, std::plus<>(), square);
+            }
+        });
+        std::cout << "par, " << workers << " workers:   " << (parallel / rounds * 1e3) << " ms" << std::endl;
+    }
+
+    return sink == 42 ? 1 : 0;
+}
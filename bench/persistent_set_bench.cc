@@ -0,0 +1,77 @@
+#include <lib/notstd/set.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+using bst_set = notstd::set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                            bst_balance::red_black_tag>;
+using persistent_set = notstd::set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                                   bst_balance::none_tag, bst_augment::none_tag, bst_thread::none_tag,
+                                   set_backend::persistent_tag>;
+
+template<class Work>
+static double Seconds(Work work) {
+    auto start = std::chrono::steady_clock::now();
+    work();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+// The cost of one consistent snapshot per reader transaction: a full copy of a bst set against sharing a
+// persistent one, and what updates cost on the persistent set with and without a snapshot taken before each.
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+    int transactions = (argc > 2) ? std::atoi(argv[2]) : 100000;
+
+    bst_set linked;
+    persistent_set persistent;
+    for (int i = 0; i < count; ++i) {
+        int key = static_cast<int>((i * 2654435761u) % (2u * static_cast<unsigned>(count)));
+        linked.insert(key);
+        persistent.insert(key);
+    }
+
+    int copies = 10;
+    double copy = Seconds([&] {
+        for (int i = 0; i < copies; ++i) {
+            bst_set snapshot = linked;
+        }
+    });
+    std::cout << "bst copy:              " << (copy / copies * 1e3) << " ms" << std::endl;
+
+    double share = Seconds([&] {
+        for (int i = 0; i < transactions; ++i) {
+            persistent_set snapshot = persistent.snapshot();
+        }
+    });
+    std::cout << "persistent snapshot:   " << (share / transactions * 1e9) << " ns" << std::endl;
+
+    auto update = [&](int i) {
+        int key = static_cast<int>((i * 40503u) % (2u * static_cast<unsigned>(count)));
+        if (i % 2 == 0) {
+            persistent.insert(key);
+        } else {
+            persistent.erase(key);
+        }
+    };
+    double alone = Seconds([&] {
+        for (int i = 0; i < transactions; ++i) {
+            update(i);
+        }
+    });
+    std::cout << "update, no snapshot:   " << (alone / transactions * 1e9) << " ns" << std::endl;
+
+    double shared = Seconds([&] {
+        std::unique_ptr<persistent_set> snapshot;
+        for (int i = 0; i < transactions; ++i) {
+            snapshot = std::make_unique<persistent_set>(persistent.snapshot());
+            update(i);
+        }
+    });
+    std::cout << "update after snapshot: " << (shared / transactions * 1e9) << " ns" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <lib/notstd/pool_allocator.h>
+#include <lib/notstd/set.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+
+template<class Allocator>
+using bench_set = notstd::set<int, bst_order::in_order_tag, std::less<int>, Allocator, bst_balance::red_black_tag>;
+
+static double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<class Set>
+static void Run(const char* name, int count) {
+    std::optional<Set> my_set(std::in_place);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        my_set->insert(static_cast<int>((i * 2654435761u) % count));
+    }
+    double insert = Seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i += 2) {
+        my_set->erase(static_cast<int>((i * 2654435761u) % count));
+    }
+    double erase = Seconds(start);
+
+    for (int i = 0; i < count; i += 2) {
+        my_set->insert(static_cast<int>((i * 2654435761u) % count));
+    }
+
+    start = std::chrono::steady_clock::now();
+    my_set.reset();
+    double destroy = Seconds(start);
+
+    std::cout << name << ": insert " << insert << " s, erase half " << erase << " s, destroy " << destroy << " s"
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+
+    Run<bench_set<std::allocator<int>>>("std::allocator       ", count);
+    Run<bench_set<notstd::pool_allocator<int>>>("notstd::pool_allocator", count);
+
+    return 0;
+}
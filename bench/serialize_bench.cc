@@ -0,0 +1,56 @@
+#include <lib/notstd/set.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <span>
+#include <sstream>
+#include <vector>
+
+using rb_set = notstd::set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                           bst_balance::red_black_tag>;
+
+template<class Work>
+static double Seconds(Work work) {
+    auto start = std::chrono::steady_clock::now();
+    work();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count();
+}
+
+// A restart: re-inserting every key against reloading a snapshot from a stream and from memory.
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? std::atoi(argv[1]) : 10000000;
+
+    std::vector<int> keys;
+    keys.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        keys.push_back(static_cast<int>((i * 2654435761u) % static_cast<unsigned>(count)));
+    }
+    rb_set my_set;
+    double inserts = Seconds([&] {
+        for (int key : keys) {
+            my_set.insert(key);
+        }
+    });
+    std::cout << "inserts:            " << (inserts * 1e3) << " ms" << std::endl;
+
+    std::stringstream stream;
+    double write = Seconds([&] { my_set.serialize(stream); });
+    std::cout << "serialize, stream:  " << (write * 1e3) << " ms, " << my_set.serialized_size() << " bytes"
+              << std::endl;
+
+    std::vector<std::byte> buffer(my_set.serialized_size());
+    double write_span = Seconds([&] { my_set.serialize(std::span<std::byte>(buffer)); });
+    std::cout << "serialize, span:    " << (write_span * 1e3) << " ms" << std::endl;
+
+    rb_set loaded;
+    double read = Seconds([&] { loaded.deserialize(stream); });
+    std::cout << "deserialize, stream: " << (read * 1e3) << " ms" << std::endl;
+
+    double read_span = Seconds([&] { loaded.deserialize(std::span<const std::byte>(buffer)); });
+    std::cout << "deserialize, span:  " << (read_span * 1e3) << " ms" << std::endl;
+
+    return loaded == my_set ? 0 : 1;
+}
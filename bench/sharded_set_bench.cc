@@ -0,0 +1,92 @@
+#include <lib/notstd/concurrent/sharded_set.h>
+#include <lib/notstd/set.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using locked_set = notstd::set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                               bst_balance::red_black_tag>;
+
+// A notstd::set behind one mutex, what sharded_set replaces.
+struct mutex_set {
+    locked_set set;
+    mutable std::mutex mutex;
+
+    bool contains(int key) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return set.contains(key);
+    }
+
+    bool insert(int key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return set.insert(key).second;
+    }
+
+    size_t erase(int key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return set.erase(key);
+    }
+};
+
+// Operations per second across threads that each insert, erase and look up random keys, a third of each.
+template<class Set>
+static void Time(const char* name, Set& my_set, int count, int threads, double seconds) {
+    std::atomic<bool> stop = false;
+    std::atomic<long> operations = 0;
+
+    std::vector<std::thread> workers;
+    for (int thread = 0; thread < threads; ++thread) {
+        workers.emplace_back([&, thread] {
+            long done = 0;
+            for (unsigned i = thread * 40503u; !stop.load(std::memory_order_relaxed); ++i, ++done) {
+                int key = static_cast<int>((i * 2654435761u) % (2u * static_cast<unsigned>(count)));
+                switch (i % 3) {
+                    case 0:
+                        my_set.insert(key);
+                        break;
+                    case 1:
+                        my_set.erase(key);
+                        break;
+                    default:
+                        my_set.contains(key);
+                }
+            }
+            operations += done;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    std::cout << name << " threads=" << threads << ": " << (operations / seconds / 1e6) << " Mops/s" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int count = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+    int max_threads = (argc > 2) ? std::atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    double seconds = (argc > 3) ? std::atof(argv[3]) : 1.0;
+    size_t shard_capacity = (argc > 4) ? std::atoi(argv[4]) : notstd::sharded_set<int>::default_shard_capacity;
+
+    notstd::sharded_set<int> sharded(shard_capacity);
+    mutex_set locked;
+    for (int i = 0; i < count; ++i) {
+        int key = static_cast<int>((i * 2654435761u) % (2u * static_cast<unsigned>(count)));
+        sharded.insert(key);
+        locked.insert(key);
+    }
+
+    for (int threads = 1; threads <= std::max(max_threads, 1); threads *= 2) {
+        Time("sharded_set  ", sharded, count, threads, seconds);
+        Time("mutex + set  ", locked, count, threads, seconds);
+    }
+
+    return 0;
+}
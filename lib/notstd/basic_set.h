@@ -0,0 +1,277 @@
+#pragma once
+
+#include "lib/notstd/bst/bst.h"
+
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+namespace notstd {
+
+// The associative container interface every set backend shares, forwarded to Tree. notstd::set derives from it
+// for every backend; the bst one adds its own extras on top, the others get only this core. See set_backend.
+template<class Tree>
+class basic_set {
+  public:
+    using key_type = typename Tree::value_type;
+    using value_type = typename Tree::value_type;
+    using key_compare = typename Tree::value_compare;
+    using value_compare = typename Tree::value_compare;
+    using allocator_type = typename Tree::allocator_type;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+    using pointer = typename Tree::pointer;
+    using const_pointer = typename Tree::const_pointer;
+    using iterator = typename Tree::const_iterator;
+    using const_iterator = typename Tree::const_iterator;
+    using difference_type = typename Tree::difference_type;
+    using size_type = typename Tree::size_type;
+    using reverse_iterator = typename std::reverse_iterator<iterator>;
+    using const_reverse_iterator = typename std::reverse_iterator<const_iterator>;
+
+  protected:
+    Tree tree_;
+
+    // Takes over a tree built by one of the backend-specific operations, such as bst::split.
+    explicit basic_set(Tree&& tree) : tree_(std::move(tree)) {}
+
+  public:
+    explicit basic_set() = default;
+
+    explicit basic_set(const key_compare& compare) : tree_(compare) {}
+
+    explicit basic_set(const allocator_type& alloc) : tree_(alloc) {}
+
+    template<class InputIter>
+    explicit basic_set(InputIter i, InputIter j) {
+        tree_.assign(i, j);
+    }
+
+    template<class InputIter>
+    explicit basic_set(InputIter i, InputIter j, const key_compare& compare) : tree_(compare) {
+        tree_.assign(i, j);
+    }
+
+    basic_set(std::initializer_list<value_type> list, const key_compare& compare)
+            : basic_set(list.begin(), list.end(), compare) {}
+
+    basic_set(std::initializer_list<value_type> list) : basic_set(list.begin(), list.end()) {}
+
+    basic_set& operator=(std::initializer_list<value_type> list) {
+        tree_.assign(list.begin(), list.end());
+
+        return *this;
+    }
+
+    allocator_type get_allocator() const {
+        return tree_.get_allocator();
+    }
+
+    key_compare key_comp() const {
+        return key_compare();
+    }
+
+    value_compare value_comp() const {
+        return value_compare();
+    }
+
+    iterator begin() {
+        return tree_.cbegin();
+    }
+
+    iterator end() {
+        return tree_.cend();
+    }
+
+    const_iterator cbegin() const {
+        return tree_.cbegin();
+    }
+
+    const_iterator cend() const {
+        return tree_.cend();
+    }
+
+    reverse_iterator rbegin() {
+        return reverse_iterator(tree_.cend());
+    }
+
+    reverse_iterator rend() {
+        return reverse_iterator(tree_.cbegin());
+    }
+
+    const_reverse_iterator crbegin() const {
+        return const_reverse_iterator(tree_.cend());
+    }
+
+    const_reverse_iterator crend() const {
+        return const_reverse_iterator(tree_.cbegin());
+    }
+
+    bool operator==(const basic_set& other) const {
+        return std::equal(cbegin(), cend(), other.cbegin(), other.cend());
+    }
+
+    bool operator!=(const basic_set& other) const {
+        return !(*this == other);
+    }
+
+    size_type size() const {
+        return tree_.size();
+    }
+
+    size_type max_size() const {
+        return std::numeric_limits<size_type>::max();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return tree_.empty();
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) {
+        return tree_.insert(value);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value) {
+        return tree_.insert(std::move(value));
+    }
+
+    template<class... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        return tree_.emplace(std::forward<Args>(args)...);
+    }
+
+    iterator insert(const_iterator hint, const value_type& value) {
+        return tree_.insert(hint, value);
+    }
+
+    iterator insert(const_iterator hint, value_type&& value) {
+        return tree_.insert(hint, std::move(value));
+    }
+
+    template<class... Args>
+    iterator emplace_hint(const_iterator hint, Args&&... args) {
+        return tree_.emplace_hint(hint, std::forward<Args>(args)...);
+    }
+
+    template<class InputIter>
+    void insert(InputIter i, InputIter j) {
+        const_iterator hint = cend();
+        for (InputIter iter = i; iter != j; ++iter) {
+            hint = tree_.insert(hint, *iter);
+        }
+    }
+
+    void insert(std::initializer_list<value_type> list) {
+        insert(list.begin(), list.end());
+    }
+
+    size_type erase(const value_type& value) {
+        return tree_.erase(value);
+    }
+
+    iterator erase(iterator iter) {
+        return tree_.erase(iter);
+    }
+
+    iterator erase(const_iterator q1, const_iterator q2) {
+        return tree_.erase(q1, q2);
+    }
+
+    void clear() {
+        tree_.clear();
+    }
+
+    iterator find(const value_type& value) {
+        return tree_.find(value);
+    }
+
+    const_iterator find(const value_type& value) const {
+        return tree_.find(value);
+    }
+
+    template<class Key> requires transparent_comparator<key_compare>
+    iterator find(const Key& key) {
+        return tree_.find(key);
+    }
+
+    template<class Key> requires transparent_comparator<key_compare>
+    const_iterator find(const Key& key) const {
+        return tree_.find(key);
+    }
+
+    size_type count(const value_type& value) const {
+        return contains(value) ? 1 : 0;
+    }
+
+    template<class Key> requires transparent_comparator<key_compare>
+    size_type count(const Key& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    bool contains(const value_type& value) const {
+        return find(value) != cend();
+    }
+
+    template<class Key> requires transparent_comparator<key_compare>
+    bool contains(const Key& key) const {
+        return find(key) != cend();
+    }
+
+    iterator lower_bound(const value_type& value) {
+        return tree_.lower_bound(value);
+    }
+
+    const_iterator lower_bound(const value_type& value) const {
+        return tree_.lower_bound(value);
+    }
+
+    template<class Key> requires transparent_comparator<key_compare>
+    iterator lower_bound(const Key& key) {
+        return tree_.lower_bound(key);
+    }
+
+    template<class Key> requires transparent_comparator<key_compare>
+    const_iterator lower_bound(const Key& key) const {
+        return tree_.lower_bound(key);
+    }
+
+    iterator upper_bound(const value_type& value) {
+        return tree_.upper_bound(value);
+    }
+
+    const_iterator upper_bound(const value_type& value) const {
+        return tree_.upper_bound(value);
+    }
+
+    template<class Key> requires transparent_comparator<key_compare>
+    iterator upper_bound(const Key& key) {
+        return tree_.upper_bound(key);
+    }
+
+    template<class Key> requires transparent_comparator<key_compare>
+    const_iterator upper_bound(const Key& key) const {
+        return tree_.upper_bound(key);
+    }
+
+    std::pair<iterator, iterator> equal_range(const value_type& value) {
+        return std::make_pair(lower_bound(value), upper_bound(value));
+    }
+
+    std::pair<const_iterator, const_iterator> equal_range(const value_type& value) const {
+        return std::make_pair(lower_bound(value), upper_bound(value));
+    }
+
+    template<class Key> requires transparent_comparator<key_compare>
+    std::pair<iterator, iterator> equal_range(const Key& key) {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+
+    template<class Key> requires transparent_comparator<key_compare>
+    std::pair<const_iterator, const_iterator> equal_range(const Key& key) const {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+};
+
+} // notstd
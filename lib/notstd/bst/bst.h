@@ -1,17 +1,44 @@
 #pragma once
 
+#include "bst_augment.h"
+#include "bst_balance.h"
+#include "bst_buffer.h"
 #include "bst_const_iterator.h"
-
+#include "bst_format.h"
+#include "bst_node_handle.h"
+#include "bst_thread.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <new>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// Comparators tagged is_transparent can compare stored keys against any compatible type.
+template<class Compare>
+concept transparent_comparator = requires { typename Compare::is_transparent; };
 
 template<class Tp, class Order = bst_order::in_order_tag, class Compare = std::less<Tp>,
-        class Allocator = std::allocator<Tp>>
+        class Allocator = std::allocator<Tp>, class Balance = bst_balance::none_tag,
+        class Augment = bst_augment::none_tag, class Thread = bst_thread::none_tag>
 class bst {
   public:
     using value_type = Tp;
-    using node_type = bst_node<value_type>;
+    using node_type = bst_node<value_type, Balance, Augment, Thread>;
     using value_compare = Compare;
     using allocator_type = Allocator;
+    using balance_type = Balance;
+    using augment_type = Augment;
+    using thread_type = Thread;
 
   private:
     using alloc_traits = std::allocator_traits<allocator_type>;
@@ -19,20 +46,34 @@ class bst {
   public:
     using pointer = typename alloc_traits::pointer;
     using const_pointer =  typename alloc_traits::const_pointer;
-    using const_iterator = bst_const_iterator<Tp, Order>;
+    using const_iterator = bst_const_iterator<node_type, Order>;
+    using sorted_iterator = bst_const_iterator<node_type, bst_order::in_order_tag>;
     using difference_type = typename const_iterator::difference_type;
     using size_type = typename const_iterator::size_type;
 
     using node_allocator_type = typename alloc_traits::template rebind_alloc<node_type>;
+    using node_handle = bst_node_handle<node_type, node_allocator_type>;
+    using insert_return_type = bst_insert_return<const_iterator, node_handle>;
 
   private:
+    using node_alloc_traits = std::allocator_traits<node_allocator_type>;
+    using header_type = typename const_iterator::header_type;
+
+    template<class Elem>
+    using buffer = bst_buffer<Elem, node_allocator_type>;
+
     node_allocator_type allocator_;
     value_compare compare_;
 
-    node_type* root_;
+    header_type header_;
+
+    // An empty tree sharing our allocator, so nodes can move between the two.
+    bst(const node_allocator_type& allocator, const value_compare& compare)
+            : allocator_(allocator), compare_(compare) {}
 
-    node_type* find_node(const value_type& value) const {
-        node_type* current = root_;
+    template<class Key>
+    node_type* find_node(const Key& value) const {
+        node_type* current = header_.root;
 
         while (current != nullptr) {
             if (compare_(value, current->key)) {
@@ -48,308 +89,734 @@ class bst {
     }
 
     const_iterator cbegin(const bst_order::in_order_tag&) const {
-        const node_type* node = root_;
-        if (node != nullptr) {
-            while (node->left != nullptr) {
-                node = node->left;
-            }
-        }
-
-        return const_iterator(node, root_);
+        return make_iterator(header_.leftmost);
     }
 
     const_iterator cbegin(const bst_order::pre_order_tag&) const {
-        return const_iterator(root_, root_);
+        return make_iterator(header_.root);
     }
 
     const_iterator cbegin(const bst_order::post_order_tag&) const {
-        const node_type* node = root_;
+        const node_type* node = header_.root;
         if (node != nullptr) {
-            while (node->left != nullptr) {
-                node = node->left;
+            while (node->left != nullptr || node->right != nullptr) {
+                node = (node->left != nullptr) ? node->left : node->right;
             }
         }
 
-        return const_iterator(node, root_);
+        return make_iterator(node);
     }
 
   public:
-    explicit bst() : root_(nullptr) {};
+    explicit bst() = default;
 
-    explicit bst(const value_compare& compare) : root_(nullptr), compare_(compare) {};
+    explicit bst(const value_compare& compare) : compare_(compare) {};
 
-    explicit bst(const allocator_type& alloc) : root_(nullptr), allocator_(alloc) {};
+    explicit bst(const allocator_type& alloc) : allocator_(alloc) {};
 
-    bst(const bst& other) {
-        root_ = copyTree(other.root_);
+    bst(const bst& other)
+            : allocator_(node_alloc_traits::select_on_container_copy_construction(other.allocator_)),
+              compare_(other.compare_) {
+        assignTree(other);
     };
 
+    bst(bst&& other) noexcept
+            : allocator_(std::move(other.allocator_)), compare_(std::move(other.compare_)), header_(other.header_) {
+        other.header_ = header_type();
+    }
+
     bst& operator=(const bst& other) {
         if (this == &other) {
             return *this;
         }
 
-        deleteTree(root_);
-        root_ = copyTree(other.root_);
+        release();
+        compare_ = other.compare_;
+        assignTree(other);
 
         return *this;
     }
 
-    std::pair<const_iterator, bool> insert(const value_type& value) {
-        node_type* new_node = createNode(value);
-
-        if (root_ == nullptr) {
-            root_ = new_node;
-            return std::make_pair(const_iterator(new_node, root_), true);
+    bst& operator=(bst&& other) noexcept(node_alloc_traits::propagate_on_container_move_assignment::value ||
+                                         node_alloc_traits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
         }
 
-        node_type* current = root_;
-        node_type* parent = nullptr;
+        release();
+        compare_ = std::move(other.compare_);
 
-        while (current != nullptr) {
-            parent = current;
-            if (compare_(value, current->key)) {
-                current = current->left;
-            } else if (compare_(current->key, value)) {
-                current = current->right;
-            } else {
-                deleteNode(new_node);
-                return std::make_pair(const_iterator(current, root_), false);
+        if constexpr (node_alloc_traits::propagate_on_container_move_assignment::value) {
+            allocator_ = std::move(other.allocator_);
+        } else if (!node_alloc_traits::is_always_equal::value && allocator_ != other.allocator_) {
+            // Our allocator cannot free the other tree's nodes, so only the keys can move over.
+            for (node_type* node = other.header_.leftmost; node != nullptr; node = next_node(node)) {
+                insert(std::move(node->key));
             }
-        }
+            other.deleteTree(other.header_.root);
+            other.header_ = header_type();
 
-        new_node->parent = parent;
-        if (compare_(value, parent->key)) {
-            parent->left = new_node;
-        } else {
-            parent->right = new_node;
+            return *this;
         }
 
-        return std::make_pair(const_iterator(new_node, root_), true);
-    }
+        header_ = other.header_;
+        other.header_ = header_type();
 
-    node_type extract(const value_type& value) {
-        node_type* node_to_delete = find_node(value);
-        if (node_to_delete == nullptr) {
-            return *createNode(0);
-        }
+        return *this;
+    }
 
-        if (node_to_delete->left == nullptr && node_to_delete->right == nullptr) {
-            if (node_to_delete->parent == nullptr) {
-                root_ = nullptr;
-            } else if (node_to_delete == node_to_delete->parent->left) {
-                node_to_delete->parent->left = nullptr;
-            } else {
-                node_to_delete->parent->right = nullptr;
+    // Replaces the contents with [first, last). A sorted forward range is detected in one pass and built
+    // bottom-up into a perfectly balanced tree in O(N); anything else goes through hinted inserts.
+    template<class InputIter>
+    void assign(InputIter first, InputIter last) {
+        release();
+
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                                        typename std::iterator_traits<InputIter>::iterator_category>) {
+            size_type count = 0;
+            bool unique = true;
+
+            if (first != last) {
+                ++count;
+                for (InputIter prev = first, iter = std::next(first); iter != last; prev = iter, ++iter) {
+                    if (compare_(*prev, *iter)) {
+                        ++count;
+                    } else if (compare_(*iter, *prev)) {
+                        count = 0;
+                        break;
+                    } else {
+                        unique = false;
+                    }
+                }
             }
-            return *node_to_delete;
-        }
 
-        if (node_to_delete->left == nullptr || node_to_delete->right == nullptr) {
-            node_type* child = (node_to_delete->left != nullptr) ? node_to_delete->left : node_to_delete->right;
-            if (node_to_delete->parent == nullptr) {
-                root_ = child;
-            } else if (node_to_delete == node_to_delete->parent->left) {
-                node_to_delete->parent->left = child;
-            } else {
-                node_to_delete->parent->right = child;
+            if (count != 0 || first == last) {
+                build_sorted(first, last, count, !unique);
+                return;
             }
-            child->parent = node_to_delete->parent;
-            return *node_to_delete;
         }
 
-        node_type* successor = node_to_delete->right;
-        while (successor->left != nullptr) {
-            successor = successor->left;
-        }
-        node_to_delete->key = successor->key;
+        append(first, last);
+    }
 
-        if (successor->parent->left == successor) {
-            successor->parent->left = successor->right;
+    // Same as assign, but trusts the caller that [first, last) is strictly increasing: no comparator calls.
+    template<class InputIter>
+    void assign_sorted_unique(InputIter first, InputIter last) {
+        release();
+
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                                        typename std::iterator_traits<InputIter>::iterator_category>) {
+            build_sorted(first, last, static_cast<size_type>(std::distance(first, last)), false);
         } else {
-            successor->parent->right = successor->right;
+            append(first, last);
+        }
+    }
+
+    // Same as assign for unsorted input, in bulk on a pool (see unite): the keys are copied out, merge-sorted and
+    // deduplicated in parallel chunks, and the balanced tree is built from independent index ranges. Subtrees
+    // only allocate their nodes concurrently when the allocator is stateless; otherwise the build is serial.
+    template<class InputIter, class Pool>
+    void assign(InputIter first, InputIter last, Pool& pool) {
+        release();
+
+        buffer<value_type> keys(allocator_);
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                                        typename std::iterator_traits<InputIter>::iterator_category>) {
+            keys.reserve(static_cast<size_type>(std::distance(first, last)));
         }
-        if (successor->right != nullptr) {
-            successor->right->parent = successor->parent;
+        for (; first != last; ++first) {
+            keys.emplace_back(*first);
         }
+        sort_keys(keys.data(), keys.data() + keys.size(), pool, 0);
+
+        sorted_runs runs = dedup_keys(keys.data(), keys.size(), pool);
+        size_type count = runs.prefix.empty() ? 0 : runs.prefix.back();
+        size_type red_depth = std::bit_width(count) > 1 ? std::bit_width(count) : 0;
+
+        adopt(build_runs(runs, 0, count, 1, red_depth, pool), count);
+        rethread(Thread());
+    }
+
+    std::pair<const_iterator, bool> insert(const value_type& value) {
+        return insert_unique(value);
+    }
 
-        return *successor;
+    std::pair<const_iterator, bool> insert(value_type&& value) {
+        return insert_unique(std::move(value));
     }
 
-    node_type extract(const_iterator iter) {
-        if (iter == const_iterator(nullptr, root_)) {
-            return *createNode(0);
+    // The key is built once up front; a node is only allocated (and the key moved into it) when it is new.
+    template<class... Args>
+    std::pair<const_iterator, bool> emplace(Args&&... args) {
+        if constexpr (sizeof...(Args) == 1 && (std::is_same_v<std::remove_cvref_t<Args>, value_type> && ...)) {
+            return insert_unique(std::forward<Args>(args)...);
+        } else {
+            return insert_unique(value_type(std::forward<Args>(args)...));
         }
-        node_type* node_to_delete = find_node(*iter);
-        if (node_to_delete == nullptr) {
-            return *createNode(0);
+    }
+
+    // Inserts as close as possible to just before hint; O(1) amortized when hint is adjacent to the key.
+    const_iterator insert(const_iterator hint, const value_type& value) {
+        return insert_unique_hint(hint, value);
+    }
+
+    const_iterator insert(const_iterator hint, value_type&& value) {
+        return insert_unique_hint(hint, std::move(value));
+    }
+
+    template<class... Args>
+    const_iterator emplace_hint(const_iterator hint, Args&&... args) {
+        if constexpr (sizeof...(Args) == 1 && (std::is_same_v<std::remove_cvref_t<Args>, value_type> && ...)) {
+            return insert_unique_hint(hint, std::forward<Args>(args)...);
+        } else {
+            return insert_unique_hint(hint, value_type(std::forward<Args>(args)...));
         }
+    }
 
-        if (node_to_delete->left == nullptr && node_to_delete->right == nullptr) {
-            if (node_to_delete->parent == nullptr) {
-                root_ = nullptr;
-            } else if (node_to_delete == node_to_delete->parent->left) {
-                node_to_delete->parent->left = nullptr;
-            } else {
-                node_to_delete->parent->right = nullptr;
-            }
-            return *node_to_delete;
+    // Unlinks the node and hands over its ownership; an empty handle if there is no such key.
+    node_handle extract(const value_type& value) {
+        node_type* node = find_node(value);
+        if (node == nullptr) {
+            return node_handle();
         }
 
-        if (node_to_delete->left == nullptr || node_to_delete->right == nullptr) {
-            node_type* child = (node_to_delete->left != nullptr) ? node_to_delete->left : node_to_delete->right;
-            if (node_to_delete->parent == nullptr) {
-                root_ = child;
-            } else if (node_to_delete == node_to_delete->parent->left) {
-                node_to_delete->parent->left = child;
-            } else {
-                node_to_delete->parent->right = child;
-            }
-            child->parent = node_to_delete->parent;
-            return *node_to_delete;
+        unlink_node(node);
+
+        return node_handle(node, allocator_);
+    }
+
+    node_handle extract(const_iterator iter) {
+        if (iter == cend()) {
+            return node_handle();
         }
 
-        node_type* successor = node_to_delete->right;
-        while (successor->left != nullptr) {
-            successor = successor->left;
+        node_type* node = const_cast<node_type*>(iter.node());
+        unlink_node(node);
+
+        return node_handle(node, allocator_);
+    }
+
+    // Relinks the handle's node without allocating. Its allocator must compare equal to ours.
+    insert_return_type insert(node_handle&& handle) {
+        if (handle.empty()) {
+            return insert_return_type{cend(), false, node_handle()};
         }
-        node_to_delete->key = successor->key;
 
-        if (successor->parent->left == successor) {
-            successor->parent->left = successor->right;
-        } else {
-            successor->parent->right = successor->right;
+        auto [position, inserted] = place_unique(handle.value(), [&] { return reuse_node(handle.release()); });
+        if (!inserted) {
+            return insert_return_type{position, false, std::move(handle)};
         }
-        if (successor->right != nullptr) {
-            successor->right->parent = successor->parent;
+
+        return insert_return_type{position, true, node_handle()};
+    }
+
+    // On a duplicate key the handle keeps its node.
+    const_iterator insert(const_iterator hint, node_handle&& handle) {
+        if (handle.empty()) {
+            return cend();
         }
 
-        return *successor;
+        return place_unique_hint(hint, handle.value(), [&] { return reuse_node(handle.release()); });
     }
 
-    size_type erase(const value_type& value) {
-        node_type* node_to_delete = find_node(value);
-        if (node_to_delete == nullptr) {
-            return 0;
+    // Moves every node whose key is not here yet out of other and splices it in. With equal allocators this
+    // neither allocates nor touches the keys; otherwise the keys are moved into fresh nodes.
+    void merge(bst& other) {
+        if (this == &other) {
+            return;
         }
 
-        if (node_to_delete->left == nullptr && node_to_delete->right == nullptr) {
-            if (node_to_delete->parent == nullptr) {
-                root_ = nullptr;
-            } else if (node_to_delete == node_to_delete->parent->left) {
-                node_to_delete->parent->left = nullptr;
-            } else {
-                node_to_delete->parent->right = nullptr;
-            }
-            delete node_to_delete;
-            return 1;
+        bool splice = node_alloc_traits::is_always_equal::value || allocator_ == other.allocator_;
+        const_iterator hint = cend();
+
+        for (node_type* node = other.header_.leftmost; node != nullptr;) {
+            node_type* next = next_node(node);
+
+            const_iterator position = place_unique_hint(hint, node->key, [&] {
+                if (splice) {
+                    other.unlink_node(node);
+                    return reuse_node(node);
+                }
+
+                // Allocate before unlinking: if that throws, the key stays in other.
+                node_type* moved = createNode(std::move(node->key));
+                other.unlink_node(node);
+                other.deleteNode(node);
+
+                return moved;
+            });
+            // Keys arrive in increasing order, so the next one belongs just before the in-order successor.
+            hint = make_iterator(next_node(const_cast<node_type*>(position.node())));
+
+            node = next;
+        }
+    }
+
+    // Set algebra on red-black trees, in place: this becomes the union, intersection or difference with other
+    // and other is left empty. Nodes are relinked through split and join rather than copied, which costs
+    // O(m log(n / m + 1)) for sizes m <= n. The overloads taking a pool (anything with size() and
+    // fork_join(left, right), such as notstd::thread_pool) run the top levels of the recursion in parallel.
+    void unite(bst& other) {
+        serial_pool pool;
+        unite(other, pool);
+    }
+
+    template<class Pool>
+    void unite(bst& other, Pool& pool) {
+        if (this != &other) {
+            combine(other, [&](node_type* lhs, node_type* rhs, garbage& trash) {
+                return unite_trees(lhs, rhs, pool, 0, trash);
+            });
         }
+    }
 
-        if (node_to_delete->left == nullptr || node_to_delete->right == nullptr) {
-            node_type* child = (node_to_delete->left != nullptr) ? node_to_delete->left : node_to_delete->right;
-            if (node_to_delete->parent == nullptr) {
-                root_ = child;
-            } else if (node_to_delete == node_to_delete->parent->left) {
-                node_to_delete->parent->left = child;
-            } else {
-                node_to_delete->parent->right = child;
-            }
-            child->parent = node_to_delete->parent;
-            delete node_to_delete;
-            return 1;
+    void intersect(bst& other) {
+        serial_pool pool;
+        intersect(other, pool);
+    }
+
+    template<class Pool>
+    void intersect(bst& other, Pool& pool) {
+        if (this != &other) {
+            combine(other, [&](node_type* lhs, node_type* rhs, garbage& trash) {
+                return intersect_trees(lhs, rhs, pool, 0, trash);
+            });
         }
+    }
+
+    void subtract(bst& other) {
+        serial_pool pool;
+        subtract(other, pool);
+    }
 
-        node_type* successor = node_to_delete->right;
-        while (successor->left != nullptr) {
-            successor = successor->left;
+    template<class Pool>
+    void subtract(bst& other, Pool& pool) {
+        if (this == &other) {
+            clear();
+            return;
         }
-        node_to_delete->key = successor->key;
 
-        if (successor->parent->left == successor) {
-            successor->parent->left = successor->right;
-        } else {
-            successor->parent->right = successor->right;
+        combine(other, [&](node_type* lhs, node_type* rhs, garbage& trash) {
+            return subtract_trees(lhs, rhs, pool, 0, trash);
+        });
+    }
+
+    // Moves every key >= key into the returned tree and keeps the rest, relinking nodes in O(height). Without
+    // bst_augment::size_tag counting the smaller piece adds O(min(k, n - k)).
+    bst split(const value_type& key) {
+        return split_off(key);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    bst split(const Key& key) {
+        return split_off(key);
+    }
+
+    // Appends right, whose keys must all be greater than ours, and leaves it empty. O(height) when the
+    // allocators are equal; otherwise right's keys are moved into new nodes.
+    void concat(bst& right) {
+        if (this == &right || right.empty()) {
+            return;
         }
-        if (successor->right != nullptr) {
-            successor->right->parent = successor->parent;
+        if (!node_alloc_traits::is_always_equal::value && allocator_ != right.allocator_) {
+            merge(right);
+            return;
+        }
+
+        size_type count = header_.size + right.header_.size;
+        node_type* last = header_.rightmost;
+        node_type* first = right.header_.leftmost;
+        node_type* root = join(header_.root, right.header_.root);
+        right.header_ = header_type();
+
+        adopt(root, count);
+        thread_between(last, first, Thread());
+    }
+
+    size_type erase(const value_type& value) {
+        node_type* node_to_delete = find_node(value);
+        if (node_to_delete == nullptr) {
+            return 0;
         }
 
-        delete successor;
+        unlink_node(node_to_delete);
+        deleteNode(node_to_delete);
+
         return 1;
     }
 
     const_iterator erase(const_iterator iter) {
-        if (iter == const_iterator(nullptr, root_)) {
+        if (iter == cend()) {
             return iter;
         }
-        node_type* node_to_delete = find_node(*iter);
-        if (node_to_delete == nullptr) {
-            return cend();
+        node_type* node_to_delete = const_cast<node_type*>(iter.node());
+
+        const_iterator next = iter;
+        ++next;
+
+        unlink_node(node_to_delete);
+        deleteNode(node_to_delete);
+
+        return next;
+    }
+
+    // With in-order iteration [first, last) is a key range: it is cut out with two splits and one join and
+    // freed as a whole, O(height + k). Other orders unlink node by node.
+    const_iterator erase(const_iterator first, const_iterator last) {
+        if (first == last) {
+            return last;
         }
 
-        node_type* successor;
-        if (node_to_delete->left != nullptr && node_to_delete->right != nullptr) {
-            successor = node_to_delete->right;
-            while (successor->left != nullptr) {
-                successor = successor->left;
+        if constexpr (std::is_same_v<Order, bst_order::in_order_tag>) {
+            node_type* first_node = const_cast<node_type*>(first.node());
+            node_type* last_node = const_cast<node_type*>(last.node());
+
+            if (first_node == header_.leftmost && last_node == nullptr) {
+                clear();
+                return cend();
             }
 
-            node_to_delete->key = successor->key;
+            node_type* before = prev_node(first_node);
+            auto [left, rest] = split(header_.root, first_node->key);
+            auto [middle, right] = (last_node != nullptr) ? split(rest, last_node->key)
+                                                          : std::make_pair(rest, static_cast<node_type*>(nullptr));
 
-            if (successor->parent->left == successor) {
-                successor->parent->left = successor->right;
-            } else {
-                successor->parent->right = successor->right;
+            header_.size -= deleteTree(middle);
+            header_.root = join(left, right);
+            thread_between(before, last_node, Thread());
+            if (before == nullptr) {
+                header_.leftmost = last_node;
             }
-
-            if (successor->right != nullptr) {
-                successor->right->parent = successor->parent;
+            if (last_node == nullptr) {
+                header_.rightmost = before;
             }
         } else {
-            node_type* child = (node_to_delete->left != nullptr) ? node_to_delete->left : node_to_delete->right;
-            if (node_to_delete->parent == nullptr) {
-                root_ = child;
-            } else if (node_to_delete == node_to_delete->parent->left) {
-                node_to_delete->parent->left = child;
-            } else {
-                node_to_delete->parent->right = child;
-            }
-            if (child != nullptr) {
-                child->parent = node_to_delete->parent;
+            while (first != last) {
+                first = erase(first);
             }
-            successor = child;
         }
 
-        delete node_to_delete;
-        return const_iterator(successor, root_);
+        return last;
     }
 
     const_iterator find(const value_type& value) const {
-        node_type* current = root_;
+        return find_key(value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator find(const Key& key) const {
+        return find_key(key);
+    }
+
+    // results[i] = find(keys[i]); results must be at least as long as keys. Runs batch_width searches in
+    // lockstep, one level each per pass, prefetching every search's next node so that their cache misses
+    // overlap instead of each stalling the next.
+    template<class Key>
+    void find_batch(std::span<const Key> keys, std::span<const_iterator> results) const {
+        search_batch(keys, [&](size_type index, const node_type* node) {
+            results[index] = (node != nullptr) ? make_iterator(node) : cend();
+        });
+    }
+
+    template<class Key>
+    void contains_batch(std::span<const Key> keys, std::span<bool> results) const {
+        search_batch(keys, [&](size_type index, const node_type* node) {
+            results[index] = (node != nullptr);
+        });
+    }
+
+    void clear() {
+        release();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return header_.root == nullptr;
+    }
+
+    size_type size() const {
+        return header_.size;
+    }
+
+    // Calls visit on every key. When the pool does not fork (no workers, or execution::seq) the keys come in
+    // iteration order; otherwise the top levels of the tree are split between branches as in unite, each walking
+    // its subtree on its own, so visit must be safe to call concurrently and the order is unspecified.
+    template<class Visit, class Pool>
+    void for_each(Visit& visit, Pool& pool) const {
+        if (!forks_at(pool, 0)) {
+            for (const_iterator iter = cbegin(); iter != cend(); ++iter) {
+                visit(*iter);
+            }
+            return;
+        }
+
+        visit_subtree(header_.root, visit, pool, 0);
+    }
+
+    // Folds transform(key) into init with reduce, splitting the tree as for_each does. Without forking the fold
+    // runs in iteration order; otherwise partial results are combined in key order, so reduce has to be
+    // associative and commutative (when iteration order is not key order) as for std::transform_reduce.
+    template<class Result, class Reduce, class Transform, class Pool>
+    Result transform_reduce(Result init, Reduce& reduce, Transform& transform, Pool& pool) const {
+        if (!forks_at(pool, 0)) {
+            for (const_iterator iter = cbegin(); iter != cend(); ++iter) {
+                init = reduce(std::move(init), transform(*iter));
+            }
+            return init;
+        }
+
+        return reduce_subtree(header_.root, std::move(init), reduce, transform, pool, 0);
+    }
+
+    // Writes the tree in the bst_format layout, shape and colours included, so deserialize rebuilds this exact
+    // tree. Keys are copied as raw bytes, which takes a trivially copyable key type; any other key goes through
+    // write_key(key, write), which encodes key by calling write(data, size) on its bytes as often as it needs.
+    void serialize(std::ostream& out) const requires std::is_trivially_copyable_v<value_type> {
+        write_stream(out, make_header(sizeof(value_type), raw_payload_bytes()),
+                     [&](auto& sink) { write_payload(sink); });
+    }
+
+    template<class WriteKey>
+    void serialize(std::ostream& out, WriteKey write_key) const {
+        buffer<unsigned char> keys(allocator_);
+        auto write = [&](const void* data, size_t size) {
+            keys.append(static_cast<const unsigned char*>(data), size);
+        };
+        buffer<unsigned char> shape = walk_pre_order([&](const value_type& key) { write_key(key, write); });
+
+        write_stream(out, make_header(0, keys.size() + shape.size()), [&](auto& sink) {
+            sink(keys.data(), keys.size());
+            sink(shape.data(), shape.size());
+        });
+    }
+
+    size_type serialized_size() const requires std::is_trivially_copyable_v<value_type> {
+        return sizeof(bst_format::header) + raw_payload_bytes() + sizeof(uint64_t);
+    }
+
+    // Into out, which must hold at least serialized_size() bytes.
+    void serialize(std::span<std::byte> out) const requires std::is_trivially_copyable_v<value_type> {
+        std::byte* cursor = out.data();
+        bst_format::checksum sum;
+        auto sink = [&](const void* data, size_t size) {
+            sum.update(data, size);
+            std::memcpy(cursor, data, size);
+            cursor += size;
+        };
+
+        bst_format::header head = make_header(sizeof(value_type), raw_payload_bytes());
+        sink(&head, sizeof(head));
+        write_payload(sink);
+
+        uint64_t value = sum.value();
+        std::memcpy(cursor, &value, sizeof(value));
+    }
+
+    // Replaces the contents with a tree written by serialize, linked up exactly as stored: O(N) and no comparator
+    // calls, so the keys must already be in our comparator's order. A header, size, shape or checksum that does
+    // not check out is refused with std::invalid_argument before any node is allocated, as is a tree without
+    // colours when we balance. On any exception the tree is left as it was. The read_key form takes keys written
+    // with a key writer: read_key(bytes) decodes one from the front of the std::string_view bytes and drops it.
+    void deserialize(std::istream& in) requires std::is_trivially_copyable_v<value_type> {
+        bst_format::header head;
+        buffer<unsigned char> payload = read_stream(in, head, sizeof(value_type));
+        rebuild_raw(head, payload.data());
+    }
+
+    template<class ReadKey>
+    void deserialize(std::istream& in, ReadKey read_key) {
+        bst_format::header head;
+        buffer<unsigned char> payload = read_stream(in, head, 0);
+        size_t shape = payload.size() - static_cast<size_t>(bst_format::shape_bytes(head.count));
+        std::string_view keys(reinterpret_cast<const char*>(payload.data()), shape);
+
+        node_type* root = rebuild(head, payload.data() + shape, [&] { return createNode(read_key(keys)); });
+        if (!keys.empty()) {
+            deleteTree(root);
+            bst_format::reject("keys left over");
+        }
+        install(root, static_cast<size_type>(head.count));
+    }
+
+    void deserialize(std::span<const std::byte> in) requires std::is_trivially_copyable_v<value_type> {
+        bst_format::header head;
+        if (in.size() < sizeof(head)) {
+            bst_format::reject("truncated input");
+        }
+        std::memcpy(&head, in.data(), sizeof(head));
+        check_header(head, sizeof(value_type));
+        if (in.size() - sizeof(head) < sizeof(uint64_t) ||
+            in.size() - sizeof(head) - sizeof(uint64_t) != head.payload_bytes) {
+            bst_format::reject("size mismatch");
+        }
+
+        const unsigned char* payload = reinterpret_cast<const unsigned char*>(in.data()) + sizeof(head);
+        bst_format::checksum sum;
+        sum.update(&head, sizeof(head));
+        sum.update(payload, static_cast<size_t>(head.payload_bytes));
+        uint64_t stored;
+        std::memcpy(&stored, payload + head.payload_bytes, sizeof(stored));
+        if (stored != sum.value()) {
+            bst_format::reject("checksum mismatch");
+        }
+
+        rebuild_raw(head, payload);
+    }
+
+    // Both pop_* require a non-empty tree.
+    value_type pop_min() {
+        return pop_node(header_.leftmost);
+    }
+
+    value_type pop_max() {
+        return pop_node(header_.rightmost);
+    }
+
+    const_iterator lower_bound(const value_type& value) const {
+        return lower_bound_key(value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator lower_bound(const Key& key) const {
+        return lower_bound_key(key);
+    }
+
+    const_iterator upper_bound(const value_type& value) const {
+        return upper_bound_key(value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator upper_bound(const Key& key) const {
+        return upper_bound_key(key);
+    }
+
+    // The k-th smallest key (0-based), or cend() if k is out of range.
+    const_iterator nth(size_type k) const {
+        static_assert(std::is_same_v<Augment, bst_augment::size_tag>, "nth requires bst_augment::size_tag");
+
+        node_type* current = header_.root;
 
         while (current != nullptr) {
-            if (compare_(value, current->key)) {
+            size_type left_size = subtree_size(current->left);
+            if (k < left_size) {
                 current = current->left;
-            } else if (compare_(current->key, value)) {
+            } else if (k > left_size) {
+                k -= left_size + 1;
                 current = current->right;
             } else {
-                return const_iterator(current, root_);
+                break;
             }
         }
 
-        return cend();
+        return make_iterator(current);
     }
 
-    [[nodiscard]] bool empty() const {
-        return root_ == nullptr;
+    // Number of keys strictly less than value.
+    size_type rank(const value_type& value) const {
+        return rank_key(value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    size_type rank(const Key& key) const {
+        return rank_key(key);
+    }
+
+    allocator_type get_allocator() const {
+        return allocator_type(allocator_);
+    }
+
+    const_iterator cbegin() const {
+        return cbegin(Order());
+    }
+
+    const_iterator cend() const {
+        return make_iterator(nullptr);
+    }
+
+    // The keys in key order whatever Order is, for handing them on sorted.
+    sorted_iterator sorted_begin() const {
+        return sorted_iterator(header_.leftmost, &header_);
+    }
+
+    sorted_iterator sorted_end() const {
+        return sorted_iterator(nullptr, &header_);
+    }
+
+    ~bst() {
+        deleteTree(header_.root);
+    }
+
+  private:
+    const_iterator make_iterator(const node_type* node) const {
+        return const_iterator(node, &header_);
+    }
+
+    template<class Key>
+    const_iterator find_key(const Key& key) const {
+        node_type* node = find_node(key);
+
+        return node != nullptr ? make_iterator(node) : cend();
+    }
+
+    // Enough searches in flight to cover a memory stall, few enough for the cursors to stay in registers.
+    static constexpr size_type batch_width = 16;
+
+    template<class Key, class Report>
+    void search_batch(std::span<const Key> keys, Report report) const {
+        const node_type* current[batch_width];
+        const node_type* found[batch_width];
+
+        for (size_type first = 0; first < keys.size(); first += batch_width) {
+            size_type width = std::min(batch_width, keys.size() - first);
+            for (size_type lane = 0; lane < width; ++lane) {
+                current[lane] = header_.root;
+                found[lane] = nullptr;
+            }
+
+            for (bool active = header_.root != nullptr; active;) {
+                active = false;
+                for (size_type lane = 0; lane < width; ++lane) {
+                    const node_type* node = current[lane];
+                    if (node == nullptr) {
+                        continue;
+                    }
+
+                    const Key& key = keys[first + lane];
+                    if (compare_(key, node->key)) {
+                        node = node->left;
+                    } else if (compare_(node->key, key)) {
+                        node = node->right;
+                    } else {
+                        found[lane] = node;
+                        node = nullptr;
+                    }
+
+                    current[lane] = node;
+                    if (node != nullptr) {
+                        prefetch(node);
+                        active = true;
+                    }
+                }
+            }
+
+            for (size_type lane = 0; lane < width; ++lane) {
+                report(first + lane, found[lane]);
+            }
+        }
+    }
+
+    static void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#endif
     }
 
-    const_iterator lower_bound(const value_type& value) {
-        node_type* current = root_;
+    template<class Key>
+    const_iterator lower_bound_key(const Key& key) const {
+        node_type* current = header_.root;
         node_type* lower_bound = nullptr;
 
         while (current != nullptr) {
-            if (!compare_(value, current->key)) {
+            if (!compare_(key, current->key)) {
                 lower_bound = current;
                 current = current->right;
             } else {
@@ -357,15 +824,16 @@ class bst {
             }
         }
 
-        return const_iterator(lower_bound, root_);
+        return make_iterator(lower_bound);
     }
 
-    const_iterator upper_bound(const value_type& value) {
-        node_type* current = root_;
+    template<class Key>
+    const_iterator upper_bound_key(const Key& key) const {
+        node_type* current = header_.root;
         node_type* upper_bound = nullptr;
 
         while (current != nullptr) {
-            if (!compare_(current->key, value)) {
+            if (!compare_(current->key, key)) {
                 upper_bound = current;
                 current = current->left;
             } else {
@@ -373,52 +841,1590 @@ class bst {
             }
         }
 
-        return const_iterator(upper_bound, root_);
+        return make_iterator(upper_bound);
     }
 
-    const_iterator cbegin() const {
-        return cbegin(Order());
+    template<class Key>
+    size_type rank_key(const Key& key) const {
+        static_assert(std::is_same_v<Augment, bst_augment::size_tag>, "rank requires bst_augment::size_tag");
+
+        node_type* current = header_.root;
+        size_type result = 0;
+
+        while (current != nullptr) {
+            if (compare_(current->key, key)) {
+                result += subtree_size(current->left) + 1;
+                current = current->right;
+            } else {
+                current = current->left;
+            }
+        }
+
+        return result;
     }
 
-    const_iterator cend() const {
-        return const_iterator(nullptr, root_);
+    template<class Key>
+    std::pair<const_iterator, bool> insert_unique(Key&& value) {
+        return place_unique(value, [&] { return createNode(std::forward<Key>(value)); });
     }
 
-    ~bst() {
-        deleteTree(root_);
+    template<class Key>
+    const_iterator insert_unique_hint(const_iterator hint, Key&& value) {
+        return place_unique_hint(hint, value, [&] { return createNode(std::forward<Key>(value)); });
     }
 
-  private:
-    node_type* createNode(const value_type& key) {
-        node_type* new_node = allocator_.allocate(1);
+    // The place_* functions search for key's slot and only call make_node once the key is known to be new,
+    // so a fresh node and a relinked one take the same path.
+    template<class Key, class MakeNode>
+    std::pair<const_iterator, bool> place_unique(const Key& key, MakeNode make_node) {
+        node_type* current = header_.root;
+        node_type* parent = nullptr;
+        bool to_left = false;
 
-        new(new_node) node_type(key);
+        while (current != nullptr) {
+            parent = current;
+            if (compare_(key, current->key)) {
+                current = current->left;
+                to_left = true;
+            } else if (compare_(current->key, key)) {
+                current = current->right;
+                to_left = false;
+            } else {
+                return std::make_pair(make_iterator(current), false);
+            }
+        }
 
-        return new_node;
+        return std::make_pair(link_new(parent, to_left, make_node), true);
     }
 
-    void deleteNode(node_type* node) {
-        allocator_.deallocate(node, 1);
-    }
+    template<class Key, class MakeNode>
+    const_iterator place_unique_hint(const_iterator hint, const Key& key, MakeNode make_node) {
+        node_type* position = const_cast<node_type*>(hint.node());
 
-    node_type* copyTree(const node_type* other_node, node_type* parent = nullptr) {
-        if (other_node == nullptr) {
-            return nullptr;
-        }
+        if (position == nullptr) {
+            if (header_.rightmost != nullptr && compare_(header_.rightmost->key, key)) {
+                return link_new(header_.rightmost, false, make_node);
+            }
+        } else if (compare_(key, position->key)) {
+            if (position == header_.leftmost) {
+                return link_new(position, true, make_node);
+            }
+
+            node_type* before = prev_node(position);
+            if (compare_(before->key, key)) {
+                if (before->right == nullptr) {
+                    return link_new(before, false, make_node);
+                }
+                return link_new(position, true, make_node);
+            }
+        } else if (compare_(position->key, key)) {
+            if (position == header_.rightmost) {
+                return link_new(position, false, make_node);
+            }
+
+            node_type* after = next_node(position);
+            if (compare_(key, after->key)) {
+                if (position->right == nullptr) {
+                    return link_new(position, false, make_node);
+                }
+                return link_new(after, true, make_node);
+            }
+        } else {
+            return hint;
+        }
+
+        return place_unique(key, make_node).first;
+    }
+
+    template<class MakeNode>
+    const_iterator link_new(node_type* parent, bool to_left, MakeNode& make_node) {
+        node_type* new_node = make_node();
+        link_node(new_node, parent, to_left);
+
+        return make_iterator(new_node);
+    }
+
+    // A node coming back from a handle keeps its old metadata; reset it to that of a fresh leaf.
+    static node_type* reuse_node(node_type* node) {
+        paint(node, true, Balance());
+        update_node(node, Augment());
+
+        return node;
+    }
+
+    template<class InputIter>
+    void append(InputIter first, InputIter last) {
+        const_iterator hint = cend();
+        for (; first != last; ++first) {
+            hint = insert(hint, *first);
+        }
+    }
+
+    template<class ForwardIter>
+    void build_sorted(ForwardIter first, ForwardIter last, size_type count, bool skip_equal) {
+        // Median splits leave every empty link on the last two levels, so painting the deepest level red
+        // (never the root) gives all paths the same black height.
+        size_type red_depth = std::bit_width(count) > 1 ? std::bit_width(count) : 0;
+
+        adopt(build_subtree(first, last, count, 1, red_depth, skip_equal), count);
+        rethread(Thread());
+    }
+
+    template<class ForwardIter>
+    node_type* build_subtree(ForwardIter& iter, ForwardIter last, size_type count, size_type depth,
+                             size_type red_depth, bool skip_equal) {
+        if (count == 0) {
+            return nullptr;
+        }
+
+        size_type left_count = (count - 1) / 2;
+        node_type* left = build_subtree(iter, last, left_count, depth + 1, red_depth, skip_equal);
+
+        node_type* node = nullptr;
+        try {
+            node = createNode(*iter);
+            for (++iter; skip_equal && iter != last && !compare_(node->key, *iter); ++iter) {}
+        } catch (...) {
+            if (node != nullptr) {
+                deleteNode(node);
+            }
+            deleteTree(left);
+            throw;
+        }
+
+        node->left = left;
+        if (left != nullptr) {
+            left->parent = node;
+        }
+        // A throw below frees the finished left half along with node; the unfinished right one cleans itself.
+        try {
+            node->right = build_subtree(iter, last, count - left_count - 1, depth + 1, red_depth, skip_equal);
+        } catch (...) {
+            deleteTree(node);
+            throw;
+        }
+        if (node->right != nullptr) {
+            node->right->parent = node;
+        }
+
+        paint(node, depth == red_depth, Balance());
+        update_node(node, Augment());
+
+        return node;
+    }
+
+    // Sorted keys split into chunks that each start a new key and hold their unique keys at the front.
+    struct sorted_runs {
+        value_type* keys;
+        buffer<size_type> starts;
+        buffer<size_type> prefix;
+
+        value_type& operator[](size_type index) const {
+            size_type run = std::upper_bound(prefix.begin(), prefix.end(), index) - prefix.begin();
+
+            return keys[starts[run] + index - (run != 0 ? prefix[run - 1] : 0)];
+        }
+    };
+
+    template<class Pool>
+    void sort_keys(value_type* first, value_type* last, Pool& pool, size_type depth) {
+        if (!forks_at(pool, depth) || last - first < 4096) {
+            std::sort(first, last, compare_);
+            return;
+        }
+
+        value_type* middle = first + (last - first) / 2;
+        run_branches(pool, depth, [&] { sort_keys(first, middle, pool, depth + 1); },
+                     [&] { sort_keys(middle, last, pool, depth + 1); });
+        std::inplace_merge(first, middle, last, compare_);
+    }
+
+    // Chunk boundaries are moved past runs of equal keys before anything is touched, so the chunks can then
+    // be deduplicated in place independently of each other.
+    template<class Pool>
+    sorted_runs dedup_keys(value_type* keys, size_type count, Pool& pool) {
+        size_type chunks = std::min(count, std::max<size_type>(1, 4 * pool.size()));
+        sorted_runs runs{keys, buffer<size_type>(chunks + 1, count, allocator_),
+                         buffer<size_type>(chunks, 0, allocator_)};
+
+        if (chunks == 0) {
+            return runs;
+        }
+
+        runs.starts[0] = 0;
+        for (size_type chunk = 1; chunk < chunks; ++chunk) {
+            size_type start = std::max(runs.starts[chunk - 1], count / chunks * chunk);
+            if (start != 0 && start < count && !compare_(keys[start - 1], keys[start])) {
+                start = std::upper_bound(keys + start, keys + count, keys[start - 1], compare_) - keys;
+            }
+            runs.starts[chunk] = start;
+        }
+
+        dedup_chunks(runs, 0, chunks, pool, 0);
+        for (size_type chunk = 1; chunk < chunks; ++chunk) {
+            runs.prefix[chunk] += runs.prefix[chunk - 1];
+        }
+
+        return runs;
+    }
+
+    template<class Pool>
+    void dedup_chunks(sorted_runs& runs, size_type first, size_type last, Pool& pool, size_type depth) {
+        if (last - first == 1) {
+            value_type* begin = runs.keys + runs.starts[first];
+            value_type* end = std::unique(begin, runs.keys + runs.starts[first + 1],
+                                          [&](const value_type& lhs, const value_type& rhs) {
+                                              return !compare_(lhs, rhs);
+                                          });
+            runs.prefix[first] = end - begin;
+            return;
+        }
+
+        size_type middle = first + (last - first) / 2;
+        run_branches(pool, depth, [&] { dedup_chunks(runs, first, middle, pool, depth + 1); },
+                     [&] { dedup_chunks(runs, middle, last, pool, depth + 1); });
+    }
+
+    // build_subtree over runs[first, first + count), with the two halves built in parallel.
+    template<class Pool>
+    node_type* build_runs(const sorted_runs& runs, size_type first, size_type count, size_type depth,
+                          size_type red_depth, Pool& pool) {
+        if (count == 0) {
+            return nullptr;
+        }
+
+        size_type left_count = (count - 1) / 2;
+        node_type* node = createNode(std::move(runs[first + left_count]));
+        node_type* left = nullptr;
+        node_type* right = nullptr;
+
+        auto build_left = [&] { left = build_runs(runs, first, left_count, depth + 1, red_depth, pool); };
+        auto build_right = [&] {
+            right = build_runs(runs, first + left_count + 1, count - left_count - 1, depth + 1, red_depth, pool);
+        };
+
+        // A branch that throws cleans itself up; whatever the other one finished is freed here.
+        try {
+            if constexpr (node_alloc_traits::is_always_equal::value) {
+                run_branches(pool, depth - 1, build_left, build_right);
+            } else {
+                build_left();
+                build_right();
+            }
+        } catch (...) {
+            deleteTree(left);
+            deleteTree(right);
+            deleteNode(node);
+            throw;
+        }
+
+        node->left = left;
+        node->right = right;
+        if (left != nullptr) {
+            left->parent = node;
+        }
+        if (right != nullptr) {
+            right->parent = node;
+        }
+
+        paint(node, depth == red_depth, Balance());
+        update_node(node, Augment());
+
+        return node;
+    }
+
+    static const node_type* next_pre_order(const node_type* node) {
+        if (node->left != nullptr) {
+            return node->left;
+        }
+        if (node->right != nullptr) {
+            return node->right;
+        }
+        for (; node->parent != nullptr; node = node->parent) {
+            if (node == node->parent->left && node->parent->right != nullptr) {
+                return node->parent->right;
+            }
+        }
+
+        return nullptr;
+    }
+
+    static bool painted_red(const node_type* node) {
+        if constexpr (std::is_same_v<Balance, bst_balance::red_black_tag>) {
+            return node->red;
+        } else {
+            return false;
+        }
+    }
+
+    uint64_t raw_payload_bytes() const {
+        return bst_format::shape_bytes(size()) + static_cast<uint64_t>(size()) * sizeof(value_type);
+    }
+
+    bst_format::header make_header(uint32_t key_size, uint64_t payload_bytes) const {
+        bst_format::header head{};
+        std::memcpy(head.magic, bst_format::magic, sizeof(head.magic));
+        head.version = bst_format::version;
+        head.flags = std::is_same_v<Balance, bst_balance::red_black_tag> ? bst_format::red_black_flag : 0;
+        head.key_size = key_size;
+        head.byte_order = bst_format::byte_order;
+        head.count = size();
+        head.payload_bytes = payload_bytes;
+
+        return head;
+    }
+
+    template<class WritePayload>
+    void write_stream(std::ostream& out, const bst_format::header& head, WritePayload write) const {
+        bst_format::checksum sum;
+        auto sink = [&](const void* data, size_t size) {
+            sum.update(data, size);
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        };
+
+        sink(&head, sizeof(head));
+        write(sink);
+
+        uint64_t value = sum.value();
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    // Hands every key to visit in pre-order and returns the shape, so the tree is only walked once.
+    template<class Visit>
+    buffer<unsigned char> walk_pre_order(Visit visit) const {
+        buffer<unsigned char> shape(static_cast<size_t>(bst_format::shape_bytes(size())), 0, allocator_);
+        size_t index = 0;
+
+        for (const node_type* node = header_.root; node != nullptr; node = next_pre_order(node), ++index) {
+            unsigned char nibble = (node->left != nullptr ? bst_format::left_bit : 0) |
+                                   (node->right != nullptr ? bst_format::right_bit : 0) |
+                                   (painted_red(node) ? bst_format::red_bit : 0);
+            shape[index / 2] |= static_cast<unsigned char>(nibble << (index % 2 * 4));
+            visit(node->key);
+        }
+
+        return shape;
+    }
+
+    // Raw keys are batched on the stack on their way to sink.
+    template<class Sink>
+    void write_payload(Sink& sink) const {
+        unsigned char batch[16384];
+        size_t used = 0;
+
+        buffer<unsigned char> shape = walk_pre_order([&](const value_type& key) {
+            if constexpr (sizeof(value_type) > sizeof(batch)) {
+                sink(std::addressof(key), sizeof(value_type));
+            } else {
+                if (used + sizeof(value_type) > sizeof(batch)) {
+                    sink(batch, used);
+                    used = 0;
+                }
+                std::memcpy(batch + used, std::addressof(key), sizeof(value_type));
+                used += sizeof(value_type);
+            }
+        });
+
+        sink(batch, used);
+        sink(shape.data(), shape.size());
+    }
+
+    void check_header(const bst_format::header& head, uint32_t key_size) const {
+        if (std::memcmp(head.magic, bst_format::magic, sizeof(head.magic)) != 0) {
+            bst_format::reject("not a serialized tree");
+        }
+        if (head.byte_order != bst_format::byte_order) {
+            bst_format::reject("written with another byte order");
+        }
+        if (head.version != bst_format::version) {
+            bst_format::reject("unsupported version");
+        }
+        if ((head.flags & ~bst_format::red_black_flag) != 0 || head.key_size != key_size) {
+            bst_format::reject("header mismatch");
+        }
+        if (std::is_same_v<Balance, bst_balance::red_black_tag> && head.count != 0 &&
+            (head.flags & bst_format::red_black_flag) == 0) {
+            bst_format::reject("tree has no colours");
+        }
+
+        uint64_t limit = std::numeric_limits<uint64_t>::max();
+        if (head.count > std::numeric_limits<size_type>::max() ||
+            head.payload_bytes < bst_format::shape_bytes(head.count) ||
+            head.payload_bytes > std::numeric_limits<size_t>::max() - sizeof(uint64_t)) {
+            bst_format::reject("size mismatch");
+        }
+        if (key_size != 0 && (head.count > (limit - bst_format::shape_bytes(head.count)) / key_size ||
+                              head.payload_bytes != bst_format::shape_bytes(head.count) + head.count * key_size)) {
+            bst_format::reject("size mismatch");
+        }
+    }
+
+    // The payload grows as it arrives, so a damaged size field fails at the end of the input, not in allocate.
+    buffer<unsigned char> read_stream(std::istream& in, bst_format::header& head, uint32_t key_size) const {
+        if (!in.read(reinterpret_cast<char*>(&head), sizeof(head))) {
+            bst_format::reject("truncated input");
+        }
+        check_header(head, key_size);
+
+        buffer<unsigned char> payload(allocator_);
+        while (payload.size() < head.payload_bytes) {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(head.payload_bytes - payload.size(), 1 << 20));
+            payload.resize(payload.size() + chunk);
+            if (!in.read(reinterpret_cast<char*>(payload.data() + payload.size() - chunk),
+                         static_cast<std::streamsize>(chunk))) {
+                bst_format::reject("truncated input");
+            }
+        }
+
+        uint64_t stored;
+        if (!in.read(reinterpret_cast<char*>(&stored), sizeof(stored))) {
+            bst_format::reject("truncated input");
+        }
+
+        bst_format::checksum sum;
+        sum.update(&head, sizeof(head));
+        sum.update(payload.data(), payload.size());
+        if (stored != sum.value()) {
+            bst_format::reject("checksum mismatch");
+        }
+
+        return payload;
+    }
+
+    void rebuild_raw(const bst_format::header& head, const unsigned char* payload) {
+        const unsigned char* cursor = payload;
+
+        install(rebuild(head, payload + head.count * sizeof(value_type), [&] {
+            alignas(value_type) unsigned char raw[sizeof(value_type)];
+            std::memcpy(raw, cursor, sizeof(value_type));
+            cursor += sizeof(value_type);
+
+            return createNode(*std::launder(reinterpret_cast<value_type*>(raw)));
+        }), static_cast<size_type>(head.count));
+    }
+
+    // Links count nodes from make_node() into the pre-order shape. Once the left subtree of a node is done the
+    // next one is its right child, and it is the latest node still waiting for one. Checking the shape also
+    // finds how many wait at once, never more than the height of the tree, so their stack is allocated once.
+    template<class MakeNode>
+    node_type* rebuild(const bst_format::header& head, const unsigned char* shape, MakeNode make_node) {
+        auto nibble = [&](uint64_t index) {
+            return static_cast<unsigned char>((shape[index / 2] >> (index % 2 * 4)) & 0xf);
+        };
+
+        uint64_t open = (head.count != 0) ? 1 : 0;
+        uint64_t most_open = open;
+        for (uint64_t index = 0; index < head.count; ++index) {
+            unsigned char bits = nibble(index);
+            if (open == 0 || (bits & ~(bst_format::left_bit | bst_format::right_bit | bst_format::red_bit)) != 0) {
+                bst_format::reject("bad shape");
+            }
+            open += ((bits & bst_format::left_bit) != 0) + ((bits & bst_format::right_bit) != 0) - 1;
+            most_open = std::max(most_open, open);
+        }
+        if (open != 0 || (head.count % 2 != 0 && (shape[head.count / 2] >> 4) != 0)) {
+            bst_format::reject("bad shape");
+        }
+
+        // Every waiting node is one open link counted above.
+        buffer<node_type*> waiting(allocator_);
+        waiting.reserve(static_cast<size_t>(most_open));
+
+        node_type* root = nullptr;
+        try {
+            node_type* prev = nullptr;
+            bool prev_has_left = false;
+            for (uint64_t index = 0; index < head.count; ++index) {
+                unsigned char bits = nibble(index);
+                node_type* node = make_node();
+                paint(node, (bits & bst_format::red_bit) != 0, Balance());
+
+                if (prev == nullptr) {
+                    root = node;
+                } else if (prev_has_left) {
+                    prev->left = node;
+                    node->parent = prev;
+                } else {
+                    node->parent = waiting.back();
+                    waiting.back()->right = node;
+                    waiting.pop_back();
+                }
+
+                if ((bits & bst_format::right_bit) != 0) {
+                    waiting.emplace_back(node);
+                }
+                prev = node;
+                prev_has_left = (bits & bst_format::left_bit) != 0;
+            }
+        } catch (...) {
+            deleteTree(root);
+            throw;
+        }
+
+        if constexpr (!std::is_same_v<Augment, bst_augment::none_tag>) {
+            update_subtree(root);
+        }
+
+        return root;
+    }
+
+    // Recomputes the augment bottom-up in post-order.
+    static void update_subtree(node_type* root) {
+        auto first_leaf = [](node_type* node) {
+            while (node->left != nullptr || node->right != nullptr) {
+                node = (node->left != nullptr) ? node->left : node->right;
+            }
+            return node;
+        };
+
+        if (root == nullptr) {
+            return;
+        }
+
+        for (node_type* node = first_leaf(root);; ) {
+            update_node(node, Augment());
+            if (node == root) {
+                break;
+            }
+
+            node_type* parent = node->parent;
+            node = (node == parent->left && parent->right != nullptr) ? first_leaf(parent->right) : parent;
+        }
+    }
+
+    void install(node_type* root, size_type count) {
+        release();
+        adopt(root, count);
+        rethread(Thread());
+    }
+
+    void release() {
+        deleteTree(header_.root);
+        header_ = header_type();
+    }
+
+    // Takes over a detached tree built or relinked elsewhere, finding its ends by walking the two spines.
+    void adopt(node_type* root, size_type count) {
+        header_ = header_type();
+        header_.root = root;
+        header_.size = count;
+
+        if (root != nullptr) {
+            paint(root, false, Balance());
+            header_.leftmost = header_.rightmost = root;
+            while (header_.leftmost->left != nullptr) {
+                header_.leftmost = header_.leftmost->left;
+            }
+            while (header_.rightmost->right != nullptr) {
+                header_.rightmost = header_.rightmost->right;
+            }
+        }
+    }
+
+    // The size of the piece of a split rooted at root. Without bst_augment::size_tag both pieces are walked in
+    // lockstep until the smaller one ends, which costs O(min(k, n - k)) on top of the split itself.
+    static size_type piece_size(node_type* root, node_type* other, size_type whole) {
+        if constexpr (std::is_same_v<Augment, bst_augment::size_tag>) {
+            return root != nullptr ? root->size : 0;
+        } else {
+            node_type* node = leftmost_of(root);
+            node_type* other_node = leftmost_of(other);
+            size_type count = 0;
+
+            for (; node != nullptr && other_node != nullptr; ++count) {
+                node = climb_next(node);
+                other_node = climb_next(other_node);
+            }
+
+            return node == nullptr ? count : whole - count;
+        }
+    }
+
+    static node_type* leftmost_of(node_type* node) {
+        while (node != nullptr && node->left != nullptr) {
+            node = node->left;
+        }
+
+        return node;
+    }
+
+    value_type pop_node(node_type* node) {
+        unlink_node(node);
+        value_type result(std::move(node->key));
+        deleteNode(node);
+
+        return result;
+    }
 
+    template<class... Args>
+    node_type* createNode(Args&&... args) {
+        node_type* new_node = node_alloc_traits::allocate(allocator_, 1);
+
+        try {
+            node_alloc_traits::construct(allocator_, new_node, std::in_place, std::forward<Args>(args)...);
+        } catch (...) {
+            node_alloc_traits::deallocate(allocator_, new_node, 1);
+            throw;
+        }
+
+        return new_node;
+    }
+
+    void deleteNode(node_type* node) {
+        node_alloc_traits::destroy(allocator_, node);
+        node_alloc_traits::deallocate(allocator_, node, 1);
+    }
+
+    // Clones other's shape in one pre-order pass, climbing back through parent links instead of recursing.
+    void assignTree(const bst& other) {
+        const node_type* source = other.header_.root;
+        if (source == nullptr) {
+            return;
+        }
+
+        node_type* node = cloneNode(source, nullptr);
+        header_.root = node;
+
+        try {
+            while (true) {
+                if (source == other.header_.leftmost) {
+                    header_.leftmost = node;
+                }
+                if (source == other.header_.rightmost) {
+                    header_.rightmost = node;
+                }
+
+                if (source->left != nullptr && node->left == nullptr) {
+                    node->left = cloneNode(source->left, node);
+                    source = source->left;
+                    node = node->left;
+                } else if (source->right != nullptr && node->right == nullptr) {
+                    node->right = cloneNode(source->right, node);
+                    source = source->right;
+                    node = node->right;
+                } else if (source != other.header_.root) {
+                    source = source->parent;
+                    node = node->parent;
+                } else {
+                    break;
+                }
+            }
+        } catch (...) {
+            release();
+            throw;
+        }
+
+        header_.size = other.header_.size;
+        rethread(Thread());
+    }
+
+    node_type* cloneNode(const node_type* other_node, node_type* parent) {
         node_type* node = createNode(other_node->key);
+        copy_metadata(node, other_node);
         node->parent = parent;
-        node->left = copyTree(other_node->left, node);
-        node->right = copyTree(other_node->right, node);
 
         return node;
     }
 
-    void deleteTree(node_type* node) {
-        if (node != nullptr) {
-            deleteTree(node->left);
-            deleteTree(node->right);
-            deleteNode(node);
+    // Post-order teardown through parent links: O(n) time, O(1) stack. Returns the number of nodes freed.
+    size_type deleteTree(node_type* node) {
+        node_type* stop = (node != nullptr) ? node->parent : nullptr;
+        size_type count = 0;
+
+        while (node != stop) {
+            if (node->left != nullptr) {
+                node = node->left;
+            } else if (node->right != nullptr) {
+                node = node->right;
+            } else {
+                node_type* parent = node->parent;
+                if (parent != stop) {
+                    (parent->left == node ? parent->left : parent->right) = nullptr;
+                }
+                deleteNode(node);
+                ++count;
+                node = parent;
+            }
+        }
+
+        return count;
+    }
+
+    // Hangs a fresh node under parent (or makes it the root) and restores the balancing invariant.
+    void link_node(node_type* node, node_type* parent, bool to_left) {
+        if (parent == nullptr) {
+            header_.leftmost = header_.rightmost = node;
+        } else if (to_left && parent == header_.leftmost) {
+            header_.leftmost = node;
+        } else if (!to_left && parent == header_.rightmost) {
+            header_.rightmost = node;
+        }
+        ++header_.size;
+
+        thread_in(node, parent, to_left, Thread());
+        attach(header_.root, node, parent, to_left);
+    }
+
+    // Detaches node from the tree by relinking, so iterators to every other node stay valid.
+    void unlink_node(node_type* node) {
+        if (node == header_.leftmost) {
+            header_.leftmost = next_node(node);
+        }
+        if (node == header_.rightmost) {
+            header_.rightmost = prev_node(node);
+        }
+        --header_.size;
+
+        thread_out(node, Thread());
+        detach(header_.root, node);
+    }
+
+    // The structural halves of link_node/unlink_node. They take the root explicitly so that split and join can
+    // run them on detached subtrees. attach reports whether the tree's black height grew.
+    static bool attach(node_type*& root, node_type* node, node_type* parent, bool to_left) {
+        node->parent = parent;
+        if (parent == nullptr) {
+            root = node;
+        } else if (to_left) {
+            parent->left = node;
+        } else {
+            parent->right = node;
+        }
+
+        update_path(parent, Augment());
+        return rebalance_after_insert(root, node, Balance());
+    }
+
+    static void detach(node_type*& root, node_type* node) {
+        node_type* child;
+        node_type* child_parent;
+
+        if (node->left == nullptr || node->right == nullptr) {
+            child = (node->left != nullptr) ? node->left : node->right;
+            child_parent = node->parent;
+            transplant(root, node, child);
+        } else {
+            node_type* successor = node->right;
+            while (successor->left != nullptr) {
+                successor = successor->left;
+            }
+
+            child = successor->right;
+            if (successor->parent == node) {
+                child_parent = successor;
+            } else {
+                child_parent = successor->parent;
+                transplant(root, successor, child);
+                successor->right = node->right;
+                successor->right->parent = successor;
+            }
+
+            transplant(root, node, successor);
+            successor->left = node->left;
+            successor->left->parent = successor;
+            swap_color(node, successor, Balance());
+        }
+
+        update_path(child_parent, Augment());
+        rebalance_after_erase(root, node, child, child_parent, Balance());
+
+        node->parent = node->left = node->right = nullptr;
+    }
+
+    template<class Key>
+    bst split_off(const Key& key) {
+        bst upper(allocator_, compare_);
+        if (empty()) {
+            return upper;
+        }
+
+        size_type whole = header_.size;
+        auto [left, right] = split(header_.root, key);
+        size_type count = piece_size(left, right, whole);
+
+        adopt(left, count);
+        upper.adopt(right, whole - count);
+        thread_between(header_.rightmost, nullptr, Thread());
+        thread_between(nullptr, upper.header_.leftmost, Thread());
+
+        return upper;
+    }
+
+    // Splits the tree rooted at root into keys < key and keys >= key. The search path is walked down once and
+    // then back up through parent links, joining the pieces bottom-up: O(height) time, O(1) stack. If equal is
+    // given, a node equal to key is cut out of both pieces and handed back there instead (nullptr if none).
+    template<class Key>
+    std::pair<node_type*, node_type*> split(node_type* root, const Key& key, node_type** equal = nullptr) const {
+        node_type* node = root;
+        node_type* bottom = nullptr;
+        bool to_right = false;
+
+        node_type* left = nullptr;
+        node_type* right = nullptr;
+        // Black heights are tracked along the path, so that no join has to measure its inputs: height belongs
+        // to the node being passed, child_height to the children of bottom.
+        size_type height = black_height(root);
+        size_type child_height = 0;
+        size_type left_height = 0;
+        size_type right_height = 0;
+
+        if (equal != nullptr) {
+            *equal = nullptr;
+        }
+
+        while (node != nullptr) {
+            bottom = node;
+            to_right = compare_(node->key, key);
+            child_height = height - black_count(node);
+
+            if (!to_right && equal != nullptr && !compare_(key, node->key)) {
+                *equal = node;
+                left = node->left;
+                right = node->right;
+                if (left != nullptr) {
+                    left->parent = nullptr;
+                }
+                if (right != nullptr) {
+                    right->parent = nullptr;
+                }
+                left_height = right_height = child_height;
+
+                bottom = node->parent;
+                to_right = bottom != nullptr && bottom->right == node;
+                child_height = height;
+                node->parent = node->left = node->right = nullptr;
+                break;
+            }
+
+            height = child_height;
+            node = to_right ? node->right : node->left;
+        }
+
+        for (node = bottom; node != nullptr;) {
+            node_type* parent = node->parent;
+            bool parent_to_right = parent != nullptr && parent->right == node;
+            // Only the child off the search path is still intact; the other one was consumed by the pieces.
+            node_type* rest = to_right ? node->left : node->right;
+            size_type node_height = child_height + black_count(node);
+
+            node->parent = node->left = node->right = nullptr;
+            if (rest != nullptr) {
+                rest->parent = nullptr;
+            }
+
+            if (to_right) {
+                left = join(rest, child_height, node, left, left_height, left_height);
+            } else {
+                right = join(right, right_height, node, rest, child_height, right_height);
+            }
+
+            node = parent;
+            to_right = parent_to_right;
+            child_height = node_height;
+        }
+
+        return std::make_pair(left, right);
+    }
+
+    // Joins two detached trees with every key of left below middle and middle below every key of right.
+    static node_type* join(node_type* left, node_type* middle, node_type* right) {
+        size_type height;
+        return join(left, black_height(left), middle, right, black_height(right), height);
+    }
+
+    // The same with the black heights of left and right already known; height receives that of the result.
+    static node_type* join(node_type* left, size_type left_height, node_type* middle, node_type* right,
+                           size_type right_height, size_type& height) {
+        return join(left, left_height, middle, right, right_height, height, Balance());
+    }
+
+    static node_type* join(node_type* left, size_type, node_type* middle, node_type* right, size_type,
+                           size_type& height, const bst_balance::none_tag&) {
+        height = 0;
+        return link_children(left, middle, right);
+    }
+
+    // Descends the taller tree's inner spine to the black node whose black height matches the shorter tree,
+    // splices middle in there as a red node and lets the insert fix-up repair the red-red edge above it.
+    static node_type* join(node_type* left, size_type left_height, node_type* middle, node_type* right,
+                           size_type right_height, size_type& height, const bst_balance::red_black_tag&) {
+        if (is_red(left)) {
+            left->red = false;
+            ++left_height;
+        }
+        if (is_red(right)) {
+            right->red = false;
+            ++right_height;
+        }
+
+        if (left_height == right_height) {
+            link_children(left, middle, right);
+            middle->red = false;
+            height = left_height + 1;
+            return middle;
+        }
+
+        bool into_left = left_height > right_height;
+        node_type* root = into_left ? left : right;
+        node_type* parent = nullptr;
+        node_type* current = root;
+        size_type current_height = into_left ? left_height : right_height;
+        size_type target = into_left ? right_height : left_height;
+
+        while (is_red(current) || current_height > target) {
+            if (!is_red(current)) {
+                --current_height;
+            }
+            parent = current;
+            current = into_left ? current->right : current->left;
+        }
+
+        link_children(into_left ? current : left, middle, into_left ? right : current);
+        bool grew = attach(root, middle, parent, !into_left);
+        height = (into_left ? left_height : right_height) + (grew ? 1 : 0);
+
+        return root;
+    }
+
+    // Makes left and right the children of middle, which becomes the root of a detached tree.
+    static node_type* link_children(node_type* left, node_type* middle, node_type* right) {
+        middle->parent = nullptr;
+        middle->left = left;
+        middle->right = right;
+        if (left != nullptr) {
+            left->parent = middle;
+        }
+        if (right != nullptr) {
+            right->parent = middle;
+        }
+        update_node(middle, Augment());
+
+        return middle;
+    }
+
+    // Concatenates two detached trees whose key ranges do not overlap, borrowing right's minimum as the middle.
+    static node_type* join(node_type* left, node_type* right) {
+        if (left == nullptr) {
+            return right;
+        }
+        if (right == nullptr) {
+            return left;
+        }
+
+        node_type* middle = right;
+        while (middle->left != nullptr) {
+            middle = middle->left;
+        }
+        detach(right, middle);
+
+        return join(left, middle, right);
+    }
+
+    // Runs the recursion without forking.
+    struct serial_pool {
+        size_t size() const {
+            return 0;
+        }
+
+        template<class Left, class Right>
+        void fork_join(Left&& left, Right&& right) {
+            left();
+            right();
+        }
+    };
+
+    // Subtrees dropped by the set algebra, chained through their roots' parent links. Branches running in
+    // parallel collect their own and hand them to the forking thread, which frees everything at the end,
+    // so the allocator is never used concurrently.
+    struct garbage {
+        node_type* head = nullptr;
+        node_type* tail = nullptr;
+
+        void push(node_type* subtree) {
+            if (subtree == nullptr) {
+                return;
+            }
+
+            subtree->parent = nullptr;
+            if (tail == nullptr) {
+                head = subtree;
+            } else {
+                tail->parent = subtree;
+            }
+            tail = subtree;
+        }
+
+        void append(garbage& other) {
+            if (other.head == nullptr) {
+                return;
+            }
+
+            if (tail == nullptr) {
+                head = other.head;
+            } else {
+                tail->parent = other.head;
+            }
+            tail = other.tail;
+        }
+    };
+
+    template<class Operation>
+    void combine(bst& other, Operation operation) {
+        static_assert(std::is_same_v<Balance, bst_balance::red_black_tag>,
+                      "set algebra requires bst_balance::red_black_tag");
+
+        if (!node_alloc_traits::is_always_equal::value && allocator_ != other.allocator_) {
+            // Our allocator cannot free other's nodes: move its keys into nodes of ours first.
+            bst moved(allocator_, compare_);
+            moved.merge(other);
+            other.release();
+
+            combine(moved, operation);
+            return;
+        }
+
+        size_type total = size() + other.size();
+        garbage trash;
+
+        node_type* root = operation(header_.root, other.header_.root, trash);
+        other.header_ = header_type();
+
+        for (node_type* subtree = trash.head; subtree != nullptr;) {
+            node_type* next = subtree->parent;
+            subtree->parent = nullptr;
+            total -= deleteTree(subtree);
+            subtree = next;
+        }
+
+        adopt(root, total);
+        thread_between(nullptr, header_.leftmost, Thread());
+        thread_between(header_.rightmost, nullptr, Thread());
+    }
+
+    // Forks only the top levels: a few branches per worker keep everyone busy without drowning in tiny tasks.
+    template<class Pool>
+    static bool forks_at(Pool& pool, size_type depth) {
+        size_type workers = pool.size();
+
+        return workers != 0 && depth < static_cast<size_type>(std::bit_width(workers)) + 2;
+    }
+
+    template<class Visit, class Pool>
+    static void visit_subtree(const node_type* root, Visit& visit, Pool& pool, size_type depth) {
+        if (root == nullptr) {
+            return;
+        }
+        if (!forks_at(pool, depth)) {
+            walk_subtree(root, visit);
+            return;
+        }
+
+        visit(root->key);
+        run_branches(pool, depth, [&] { visit_subtree(root->left, visit, pool, depth + 1); },
+                     [&] { visit_subtree(root->right, visit, pool, depth + 1); });
+    }
+
+    // The left branch carries on from init and the right one starts from root's key, so no identity is needed.
+    template<class Result, class Reduce, class Transform, class Pool>
+    static Result reduce_subtree(const node_type* root, Result init, Reduce& reduce, Transform& transform,
+                                 Pool& pool, size_type depth) {
+        if (root == nullptr) {
+            return init;
+        }
+        if (!forks_at(pool, depth)) {
+            walk_subtree(root, [&](const value_type& key) { init = reduce(std::move(init), transform(key)); });
+            return init;
+        }
+
+        std::optional<Result> left;
+        std::optional<Result> right;
+        auto reduce_left = [&] {
+            left.emplace(reduce_subtree(root->left, std::move(init), reduce, transform, pool, depth + 1));
+        };
+        auto reduce_right = [&] {
+            right.emplace(reduce_subtree(root->right, Result(transform(root->key)), reduce, transform, pool,
+                                         depth + 1));
+        };
+        run_branches(pool, depth, reduce_left, reduce_right);
+
+        return reduce(std::move(*left), std::move(*right));
+    }
+
+    // Visits the subtree under root in key order, climbing through parent links instead of keeping a stack.
+    template<class Function>
+    static void walk_subtree(const node_type* root, Function&& function) {
+        const node_type* stop = root->parent;
+        const node_type* node = root;
+        while (node->left != nullptr) {
+            node = node->left;
+        }
+
+        while (node != stop) {
+            function(node->key);
+
+            if (node->right != nullptr) {
+                node = node->right;
+                while (node->left != nullptr) {
+                    node = node->left;
+                }
+            } else {
+                const node_type* parent = node->parent;
+                while (parent != stop && parent->right == node) {
+                    node = parent;
+                    parent = parent->parent;
+                }
+                node = parent;
+            }
+        }
+    }
+
+    template<class Pool, class Left, class Right>
+    static void run_branches(Pool& pool, size_type depth, Left&& left, Right&& right) {
+        if (forks_at(pool, depth)) {
+            pool.fork_join(left, right);
+        } else {
+            left();
+            right();
+        }
+    }
+
+    // Detaches root from its two subtrees and returns them.
+    static std::pair<node_type*, node_type*> open_root(node_type* root) {
+        node_type* left = root->left;
+        node_type* right = root->right;
+        if (left != nullptr) {
+            left->parent = nullptr;
+        }
+        if (right != nullptr) {
+            right->parent = nullptr;
+        }
+        root->left = root->right = nullptr;
+
+        return std::make_pair(left, right);
+    }
+
+    // The three operations split one tree by the other's root and recurse on the matching halves.
+    template<class Pool>
+    node_type* unite_trees(node_type* lhs, node_type* rhs, Pool& pool, size_type depth, garbage& trash) const {
+        if (lhs == nullptr) {
+            return rhs;
+        }
+        if (rhs == nullptr) {
+            return lhs;
+        }
+
+        auto [lhs_left, lhs_right] = open_root(lhs);
+        node_type* equal;
+        auto [rhs_left, rhs_right] = split(rhs, lhs->key, &equal);
+        trash.push(equal);
+
+        node_type* left;
+        node_type* right;
+        garbage right_trash;
+        run_branches(pool, depth,
+                     [&] { left = unite_trees(lhs_left, rhs_left, pool, depth + 1, trash); },
+                     [&] { right = unite_trees(lhs_right, rhs_right, pool, depth + 1, right_trash); });
+        trash.append(right_trash);
+
+        thread_seam(left, lhs, Thread());
+        thread_seam(lhs, right, Thread());
+        return join(left, lhs, right);
+    }
+
+    template<class Pool>
+    node_type* intersect_trees(node_type* lhs, node_type* rhs, Pool& pool, size_type depth, garbage& trash) const {
+        if (lhs == nullptr || rhs == nullptr) {
+            trash.push(lhs);
+            trash.push(rhs);
+            return nullptr;
+        }
+
+        auto [lhs_left, lhs_right] = open_root(lhs);
+        node_type* equal;
+        auto [rhs_left, rhs_right] = split(rhs, lhs->key, &equal);
+
+        node_type* left;
+        node_type* right;
+        garbage right_trash;
+        run_branches(pool, depth,
+                     [&] { left = intersect_trees(lhs_left, rhs_left, pool, depth + 1, trash); },
+                     [&] { right = intersect_trees(lhs_right, rhs_right, pool, depth + 1, right_trash); });
+        trash.append(right_trash);
+
+        if (equal != nullptr) {
+            trash.push(equal);
+            thread_seam(left, lhs, Thread());
+            thread_seam(lhs, right, Thread());
+            return join(left, lhs, right);
         }
+
+        trash.push(lhs);
+        thread_seam(left, right, Thread());
+        return join(left, right);
+    }
+
+    template<class Pool>
+    node_type* subtract_trees(node_type* lhs, node_type* rhs, Pool& pool, size_type depth, garbage& trash) const {
+        if (lhs == nullptr || rhs == nullptr) {
+            trash.push(rhs);
+            return lhs;
+        }
+
+        auto [rhs_left, rhs_right] = open_root(rhs);
+        node_type* equal;
+        auto [lhs_left, lhs_right] = split(lhs, rhs->key, &equal);
+        trash.push(rhs);
+        trash.push(equal);
+
+        node_type* left;
+        node_type* right;
+        garbage right_trash;
+        run_branches(pool, depth,
+                     [&] { left = subtract_trees(lhs_left, rhs_left, pool, depth + 1, trash); },
+                     [&] { right = subtract_trees(lhs_right, rhs_right, pool, depth + 1, right_trash); });
+        trash.append(right_trash);
+
+        thread_seam(left, right, Thread());
+        return join(left, right);
+    }
+
+    // Number of black nodes on any path from node down to an empty link; always 0 without red-black balancing.
+    static size_type black_height(const node_type* node) {
+        size_type height = 0;
+        for (; node != nullptr; node = node->left) {
+            height += black_count(node);
+        }
+
+        return height;
+    }
+
+    static size_type black_count(const node_type* node) {
+        if constexpr (std::is_same_v<Balance, bst_balance::red_black_tag>) {
+            return (node != nullptr && !node->red) ? 1 : 0;
+        } else {
+            return 0;
+        }
+    }
+
+    // In-order neighbours, independent of the iteration Order.
+    static node_type* next_node(node_type* node) {
+        if constexpr (std::is_same_v<Thread, bst_thread::threaded_tag>) {
+            return node->next;
+        } else {
+            return climb_next(node);
+        }
+    }
+
+    static node_type* prev_node(node_type* node) {
+        if constexpr (std::is_same_v<Thread, bst_thread::threaded_tag>) {
+            return node->prev;
+        } else {
+            return climb_prev(node);
+        }
+    }
+
+    // The same neighbours found from the tree's shape alone, for when the threads are being rebuilt.
+    static node_type* climb_next(node_type* node) {
+        if (node->right != nullptr) {
+            node = node->right;
+            while (node->left != nullptr) {
+                node = node->left;
+            }
+            return node;
+        }
+
+        while (node->parent != nullptr && node->parent->right == node) {
+            node = node->parent;
+        }
+
+        return node->parent;
+    }
+
+    static node_type* climb_prev(node_type* node) {
+        if (node->left != nullptr) {
+            node = node->left;
+            while (node->right != nullptr) {
+                node = node->right;
+            }
+            return node;
+        }
+
+        while (node->parent != nullptr && node->parent->left == node) {
+            node = node->parent;
+        }
+
+        return node->parent;
+    }
+
+    static void thread_between(node_type*, node_type*, const bst_thread::none_tag&) {}
+
+    static void thread_between(node_type* prev, node_type* next, const bst_thread::threaded_tag&) {
+        if (prev != nullptr) {
+            prev->next = next;
+        }
+        if (next != nullptr) {
+            next->prev = prev;
+        }
+    }
+
+    static void thread_in(node_type*, node_type*, bool, const bst_thread::none_tag&) {}
+
+    // Threads a node just hung under parent, before the rebalancing rotations (which keep the in-order).
+    static void thread_in(node_type* node, node_type* parent, bool to_left, const bst_thread::threaded_tag& tag) {
+        if (parent == nullptr) {
+            thread_between(nullptr, node, tag);
+            thread_between(node, nullptr, tag);
+        } else if (to_left) {
+            thread_between(parent->prev, node, tag);
+            thread_between(node, parent, tag);
+        } else {
+            thread_between(node, parent->next, tag);
+            thread_between(parent, node, tag);
+        }
+    }
+
+    static void thread_out(node_type*, const bst_thread::none_tag&) {}
+
+    static void thread_out(node_type* node, const bst_thread::threaded_tag& tag) {
+        thread_between(node->prev, node->next, tag);
+    }
+
+    static void thread_seam(node_type*, node_type*, const bst_thread::none_tag&) {}
+
+    // Split and join move whole subtrees around without looking at the threads. Pieces cut from one tree stay
+    // threaded inside, so the set algebra only relinks the seam between the two trees it is about to join.
+    static void thread_seam(node_type* left, node_type* right, const bst_thread::threaded_tag& tag) {
+        if (left == nullptr || right == nullptr) {
+            return;
+        }
+
+        while (left->right != nullptr) {
+            left = left->right;
+        }
+        while (right->left != nullptr) {
+            right = right->left;
+        }
+        thread_between(left, right, tag);
+    }
+
+    void rethread(const bst_thread::none_tag&) {}
+
+    // Bulk builds and copies create nodes in tree order rather than key order, so they thread them all
+    // afterwards in one O(n) pass.
+    void rethread(const bst_thread::threaded_tag&) {
+        node_type* prev = nullptr;
+        for (node_type* node = header_.leftmost; node != nullptr; node = climb_next(node)) {
+            thread_between(prev, node, Thread());
+            prev = node;
+        }
+        thread_between(prev, nullptr, Thread());
+    }
+
+    static void transplant(node_type*& root, node_type* node, node_type* replacement) {
+        if (node->parent == nullptr) {
+            root = replacement;
+        } else if (node == node->parent->left) {
+            node->parent->left = replacement;
+        } else {
+            node->parent->right = replacement;
+        }
+
+        if (replacement != nullptr) {
+            replacement->parent = node->parent;
+        }
+    }
+
+    static void rotate_left(node_type*& root, node_type* node) {
+        node_type* pivot = node->right;
+
+        node->right = pivot->left;
+        if (pivot->left != nullptr) {
+            pivot->left->parent = node;
+        }
+
+        transplant(root, node, pivot);
+        pivot->left = node;
+        node->parent = pivot;
+
+        update_node(node, Augment());
+        update_node(pivot, Augment());
+    }
+
+    static void rotate_right(node_type*& root, node_type* node) {
+        node_type* pivot = node->left;
+
+        node->left = pivot->right;
+        if (pivot->right != nullptr) {
+            pivot->right->parent = node;
+        }
+
+        transplant(root, node, pivot);
+        pivot->right = node;
+        node->parent = pivot;
+
+        update_node(node, Augment());
+        update_node(pivot, Augment());
+    }
+
+    static void paint(node_type*, bool, const bst_balance::none_tag&) {}
+
+    static void paint(node_type* node, bool red, const bst_balance::red_black_tag&) {
+        node->red = red;
+    }
+
+    static void copy_metadata(node_type* node, const node_type* other) {
+        static_cast<bst_node_balance<Balance>&>(*node) = *other;
+        static_cast<bst_node_augment<Augment>&>(*node) = *other;
+    }
+
+    static size_type subtree_size(const node_type* node) {
+        return node != nullptr ? node->size : 0;
+    }
+
+    static void update_node(node_type*, const bst_augment::none_tag&) {}
+
+    static void update_node(node_type* node, const bst_augment::size_tag&) {
+        node->size = subtree_size(node->left) + subtree_size(node->right) + 1;
+    }
+
+    static void update_path(node_type*, const bst_augment::none_tag&) {}
+
+    static void update_path(node_type* node, const bst_augment::size_tag& tag) {
+        for (; node != nullptr; node = node->parent) {
+            update_node(node, tag);
+        }
+    }
+
+    static void swap_color(node_type*, node_type*, const bst_balance::none_tag&) {}
+
+    static void swap_color(node_type* lhs, node_type* rhs, const bst_balance::red_black_tag&) {
+        std::swap(lhs->red, rhs->red);
+    }
+
+    static bool rebalance_after_insert(node_type*&, node_type*, const bst_balance::none_tag&) {
+        return false;
+    }
+
+    // Returns whether the root had to be repainted black, the only way an insert adds to the black height.
+    static bool rebalance_after_insert(node_type*& root, node_type* node, const bst_balance::red_black_tag&) {
+        node->red = true;
+
+        while (node->parent != nullptr && node->parent->red) {
+            node_type* parent = node->parent;
+            node_type* grandparent = parent->parent;
+
+            if (parent == grandparent->left) {
+                node_type* uncle = grandparent->right;
+                if (is_red(uncle)) {
+                    parent->red = false;
+                    uncle->red = false;
+                    grandparent->red = true;
+                    node = grandparent;
+                    continue;
+                }
+                if (node == parent->right) {
+                    rotate_left(root, parent);
+                    node = parent;
+                    parent = node->parent;
+                }
+                parent->red = false;
+                grandparent->red = true;
+                rotate_right(root, grandparent);
+            } else {
+                node_type* uncle = grandparent->left;
+                if (is_red(uncle)) {
+                    parent->red = false;
+                    uncle->red = false;
+                    grandparent->red = true;
+                    node = grandparent;
+                    continue;
+                }
+                if (node == parent->left) {
+                    rotate_right(root, parent);
+                    node = parent;
+                    parent = node->parent;
+                }
+                parent->red = false;
+                grandparent->red = true;
+                rotate_left(root, grandparent);
+            }
+        }
+
+        bool grew = root->red;
+        root->red = false;
+
+        return grew;
+    }
+
+    static void rebalance_after_erase(node_type*&, node_type*, node_type*, node_type*, const bst_balance::none_tag&) {}
+
+    // removed carries the colour that left the tree; child took its place under parent (child may be null).
+    static void rebalance_after_erase(node_type*& root, node_type* removed, node_type* child, node_type* parent,
+                                      const bst_balance::red_black_tag&) {
+        if (removed->red) {
+            return;
+        }
+
+        while (child != root && !is_red(child)) {
+            if (child == parent->left) {
+                node_type* sibling = parent->right;
+                if (is_red(sibling)) {
+                    sibling->red = false;
+                    parent->red = true;
+                    rotate_left(root, parent);
+                    sibling = parent->right;
+                }
+                if (!is_red(sibling->left) && !is_red(sibling->right)) {
+                    sibling->red = true;
+                    child = parent;
+                    parent = child->parent;
+                    continue;
+                }
+                if (!is_red(sibling->right)) {
+                    sibling->left->red = false;
+                    sibling->red = true;
+                    rotate_right(root, sibling);
+                    sibling = parent->right;
+                }
+                sibling->red = parent->red;
+                parent->red = false;
+                sibling->right->red = false;
+                rotate_left(root, parent);
+                child = root;
+            } else {
+                node_type* sibling = parent->left;
+                if (is_red(sibling)) {
+                    sibling->red = false;
+                    parent->red = true;
+                    rotate_right(root, parent);
+                    sibling = parent->left;
+                }
+                if (!is_red(sibling->left) && !is_red(sibling->right)) {
+                    sibling->red = true;
+                    child = parent;
+                    parent = child->parent;
+                    continue;
+                }
+                if (!is_red(sibling->left)) {
+                    sibling->right->red = false;
+                    sibling->red = true;
+                    rotate_left(root, sibling);
+                    sibling = parent->left;
+                }
+                sibling->red = parent->red;
+                parent->red = false;
+                sibling->left->red = false;
+                rotate_right(root, parent);
+                child = root;
+            }
+        }
+
+        if (child != nullptr) {
+            child->red = false;
+        }
+    }
+
+    static bool is_red(const node_type* node) {
+        return node != nullptr && node->red;
     }
 };
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace bst_augment {
+
+struct none_tag {};
+struct size_tag {};
+
+} // bst_augment
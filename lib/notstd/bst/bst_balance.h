@@ -0,0 +1,8 @@
+#pragma once
+
+namespace bst_balance {
+
+struct none_tag {};
+struct red_black_tag {};
+
+} // bst_balance
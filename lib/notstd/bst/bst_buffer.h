@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+// Scratch space for bst's bulk operations, taken from the tree's allocator rebound to Elem: an array that
+// doubles as it grows and gives its elements and memory back when it goes away.
+template<class Elem, class Allocator>
+class bst_buffer {
+  public:
+    using allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<Elem>;
+    using size_type = size_t;
+
+  private:
+    using alloc_traits = std::allocator_traits<allocator_type>;
+
+    allocator_type allocator_;
+    Elem* data_ = nullptr;
+    size_type size_ = 0;
+    size_type capacity_ = 0;
+
+  public:
+    explicit bst_buffer(const Allocator& alloc) : allocator_(alloc) {}
+
+    // count copies of value.
+    bst_buffer(size_type count, const Elem& value, const Allocator& alloc) : allocator_(alloc) {
+        try {
+            reserve(count);
+            for (; size_ < count; ++size_) {
+                alloc_traits::construct(allocator_, data_ + size_, value);
+            }
+        } catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    bst_buffer(bst_buffer&& other) noexcept
+            : allocator_(std::move(other.allocator_)), data_(std::exchange(other.data_, nullptr)),
+              size_(std::exchange(other.size_, 0)), capacity_(std::exchange(other.capacity_, 0)) {}
+
+    bst_buffer& operator=(bst_buffer&&) = delete;
+
+    ~bst_buffer() {
+        release();
+    }
+
+    Elem* data() {
+        return data_;
+    }
+
+    const Elem* data() const {
+        return data_;
+    }
+
+    Elem* begin() {
+        return data_;
+    }
+
+    const Elem* begin() const {
+        return data_;
+    }
+
+    Elem* end() {
+        return data_ + size_;
+    }
+
+    const Elem* end() const {
+        return data_ + size_;
+    }
+
+    size_type size() const {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size_ == 0;
+    }
+
+    Elem& operator[](size_type index) {
+        return data_[index];
+    }
+
+    const Elem& operator[](size_type index) const {
+        return data_[index];
+    }
+
+    Elem& back() {
+        return data_[size_ - 1];
+    }
+
+    const Elem& back() const {
+        return data_[size_ - 1];
+    }
+
+    // Moves the elements to an array with room for capacity of them, if they do not fit already.
+    void reserve(size_type capacity) {
+        if (capacity <= capacity_) {
+            return;
+        }
+        if (capacity > alloc_traits::max_size(allocator_)) {
+            throw std::length_error("bst_buffer::reserve");
+        }
+
+        Elem* data = alloc_traits::allocate(allocator_, capacity);
+        size_type moved = 0;
+        try {
+            for (; moved < size_; ++moved) {
+                alloc_traits::construct(allocator_, data + moved, std::move_if_noexcept(data_[moved]));
+            }
+        } catch (...) {
+            while (moved > 0) {
+                alloc_traits::destroy(allocator_, data + --moved);
+            }
+            alloc_traits::deallocate(allocator_, data, capacity);
+            throw;
+        }
+
+        size_type size = size_;
+        release();
+        data_ = data;
+        size_ = size;
+        capacity_ = capacity;
+    }
+
+    template<class... Args>
+    Elem& emplace_back(Args&&... args) {
+        if (size_ == capacity_) {
+            reserve((capacity_ < 16) ? 16 : 2 * capacity_);
+        }
+        alloc_traits::construct(allocator_, data_ + size_, std::forward<Args>(args)...);
+
+        return data_[size_++];
+    }
+
+    void pop_back() {
+        alloc_traits::destroy(allocator_, data_ + --size_);
+    }
+
+    // Copies count elements from first onto the end.
+    void append(const Elem* first, size_type count) {
+        if (count > capacity_ - size_) {
+            reserve(std::max(size_ + count, 2 * capacity_));
+        }
+        for (const Elem* last = first + count; first != last; ++first) {
+            alloc_traits::construct(allocator_, data_ + size_, *first);
+            ++size_;
+        }
+    }
+
+    // Value-initializes new elements or destroys surplus ones.
+    void resize(size_type count) {
+        if (count > capacity_) {
+            reserve(std::max(count, 2 * capacity_));
+        }
+        for (; size_ < count; ++size_) {
+            alloc_traits::construct(allocator_, data_ + size_);
+        }
+        while (size_ > count) {
+            pop_back();
+        }
+    }
+
+  private:
+    void release() {
+        if (data_ == nullptr) {
+            return;
+        }
+
+        while (size_ > 0) {
+            pop_back();
+        }
+        alloc_traits::deallocate(allocator_, data_, capacity_);
+        data_ = nullptr;
+        capacity_ = 0;
+    }
+};
@@ -1,29 +1,35 @@
 #pragma once
 
+#include "bst_header.h"
 #include "bst_node.h"
 #include "bst_order.h"
 
 #include <cstddef>
+#include <iterator>
+#include <type_traits>
 
-template<class Tp, class Order>
+template<class Node, class Order>
 class bst_const_iterator {
   public:
     using difference_type = ptrdiff_t;
     using size_type = size_t;
-    using value_type = Tp;
-    using node_type = const bst_node<value_type>;
+    using value_type = typename Node::value_type;
+    using node_type = const Node;
     using pointer = node_type*;
     using reference = node_type&;
     using iterator_category = std::bidirectional_iterator_tag;
+    using header_type = bst_header<Node>;
 
   protected:
     pointer ptr_;
-    pointer root_;
+    const header_type* header_;
 
   public:
-    explicit bst_const_iterator(pointer ptr, pointer root) : ptr_(ptr), root_(root) {}
+    explicit bst_const_iterator(pointer ptr, const header_type* header) : ptr_(ptr), header_(header) {}
 
-    bst_const_iterator(const bst_const_iterator& other) : ptr_(other.ptr_), root_(other.root_) {}
+    bst_const_iterator(const bst_const_iterator& other) : ptr_(other.ptr_), header_(other.header_) {}
+
+    bst_const_iterator& operator=(const bst_const_iterator& other) = default;
 
     bool operator==(const bst_const_iterator& other) const {
         return ptr_ == other.ptr_;
@@ -37,6 +43,15 @@ class bst_const_iterator {
         return ptr_->key;
     }
 
+    const value_type* operator->() const {
+        return &ptr_->key;
+    }
+
+    // The node the iterator stands on, nullptr for end().
+    pointer node() const {
+        return ptr_;
+    }
+
     bst_const_iterator& operator++() {
         increment(Order());
 
@@ -64,35 +79,61 @@ class bst_const_iterator {
     }
 
   protected:
+    static pointer leftmost(pointer node) {
+        while (node->left != nullptr) {
+            node = node->left;
+        }
+
+        return node;
+    }
+
+    static pointer rightmost(pointer node) {
+        while (node->right != nullptr) {
+            node = node->right;
+        }
+
+        return node;
+    }
+
+    static pointer first_leaf(pointer node) {
+        while (node->left != nullptr || node->right != nullptr) {
+            node = (node->left != nullptr) ? node->left : node->right;
+        }
+
+        return node;
+    }
+
+    static pointer last_leaf(pointer node) {
+        while (node->left != nullptr || node->right != nullptr) {
+            node = (node->right != nullptr) ? node->right : node->left;
+        }
+
+        return node;
+    }
+
+    static constexpr bool threaded = std::is_same_v<typename Node::thread_type, bst_thread::threaded_tag>;
+
     void increment(const bst_order::in_order_tag&) {
         if (ptr_ == nullptr) {
-            ptr_ = root_;
-            while (ptr_->left != nullptr) {
-                ptr_ = ptr_->left;
-            }
+            ptr_ = header_->leftmost;
             return;
         }
 
-        if (ptr_->right != nullptr) {
-            ptr_ = ptr_->right;
-            while (ptr_->left != nullptr) {
-                ptr_ = ptr_->left;
-            }
+        if constexpr (threaded) {
+            ptr_ = ptr_->next;
+        } else if (ptr_->right != nullptr) {
+            ptr_ = leftmost(ptr_->right);
         } else {
             while (ptr_->parent != nullptr && ptr_->parent->right == ptr_) {
                 ptr_ = ptr_->parent;
             }
-            if (ptr_->parent != nullptr) {
-                ptr_ = ptr_->parent;
-            } else {
-                ptr_ = nullptr;
-            }
+            ptr_ = ptr_->parent;
         }
     }
 
     void increment(const bst_order::pre_order_tag&) {
         if (ptr_ == nullptr) {
-            ptr_ = root_;
+            ptr_ = header_->root;
             return;
         }
 
@@ -114,10 +155,7 @@ class bst_const_iterator {
 
     void increment(const bst_order::post_order_tag&) {
         if (ptr_ == nullptr) {
-            ptr_ = root_;
-            while (ptr_->left != nullptr) {
-                ptr_ = ptr_->left;
-            }
+            ptr_ = first_leaf(header_->root);
             return;
         }
 
@@ -126,32 +164,20 @@ class bst_const_iterator {
         } else if (ptr_->parent->right == ptr_ || ptr_->parent->right == nullptr) {
             ptr_ = ptr_->parent;
         } else {
-            pointer next = ptr_->parent->right;
-            while (next->left != nullptr || next->right != nullptr) {
-                if (next->left != nullptr) {
-                    next = next->left;
-                } else {
-                    next = next->right;
-                }
-            }
-            ptr_ = next;
+            ptr_ = first_leaf(ptr_->parent->right);
         }
     }
 
     void decrement(const bst_order::in_order_tag&) {
         if (ptr_ == nullptr) {
-            ptr_ = root_;
-            while (ptr_->right != nullptr) {
-                ptr_ = ptr_->right;
-            }
+            ptr_ = header_->rightmost;
             return;
         }
 
-        if (ptr_->left != nullptr) {
-            ptr_ = ptr_->left;
-            while (ptr_->right != nullptr) {
-                ptr_ = ptr_->right;
-            }
+        if constexpr (threaded) {
+            ptr_ = ptr_->prev;
+        } else if (ptr_->left != nullptr) {
+            ptr_ = rightmost(ptr_->left);
         } else {
             while (ptr_->parent != nullptr && ptr_->parent->left == ptr_) {
                 ptr_ = ptr_->parent;
@@ -162,26 +188,22 @@ class bst_const_iterator {
 
     void decrement(const bst_order::pre_order_tag&) {
         if (ptr_ == nullptr) {
-            ptr_ = root_;
-            while (ptr_->right != nullptr) {
-                ptr_ = ptr_->right;
-            }
+            ptr_ = last_leaf(header_->root);
             return;
         }
 
-        if (ptr_->parent->left != ptr_ && ptr_->parent->left != nullptr) {
-            ptr_ = ptr_->parent->left;
-            while (ptr_->right != nullptr) {
-                ptr_ = ptr_->right;
-            }
-        } else {
+        if (ptr_->parent == nullptr) {
+            ptr_ = nullptr;
+        } else if (ptr_->parent->left == ptr_ || ptr_->parent->left == nullptr) {
             ptr_ = ptr_->parent;
+        } else {
+            ptr_ = last_leaf(ptr_->parent->left);
         }
     }
 
     void decrement(const bst_order::post_order_tag&) {
         if (ptr_ == nullptr) {
-            ptr_ = root_;
+            ptr_ = header_->root;
             return;
         }
 
@@ -190,13 +212,14 @@ class bst_const_iterator {
         } else if (ptr_->left != nullptr) {
             ptr_ = ptr_->left;
         } else {
-            if (ptr_->parent->left == ptr_) {
-                ptr_ = ptr_->parent->parent;
-            }
-            while (ptr_->left == nullptr) {
+            while (ptr_->parent != nullptr && (ptr_->parent->left == nullptr || ptr_->parent->left == ptr_)) {
                 ptr_ = ptr_->parent;
             }
-            ptr_ = ptr_->left;
+            if (ptr_->parent != nullptr) {
+                ptr_ = ptr_->parent->left;
+            } else {
+                ptr_ = nullptr;
+            }
         }
     }
 };
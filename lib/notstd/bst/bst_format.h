@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// The layout written by bst::serialize, in the writer's native byte order:
+//
+//   header | keys | shape | checksum
+//
+// The keys come in pre-order, as raw bytes or as encoded by the caller's key writer. The shape holds one nibble
+// per node in the same order (left child, right child, red), two nodes to a byte; it goes last so the writer
+// walks the tree once. The checksum covers everything before it.
+namespace bst_format {
+
+struct header {
+    char magic[4];
+    uint16_t version;
+    uint16_t flags;
+    uint32_t key_size;       // 0 when the keys went through a key writer and vary in length
+    uint32_t byte_order;
+    uint64_t count;
+    uint64_t payload_bytes;  // shape and keys
+};
+
+static_assert(sizeof(header) == 32, "bst_format::header must have no padding");
+
+inline constexpr char magic[4] = {'n', 's', 'b', 't'};
+inline constexpr uint16_t version = 1;
+inline constexpr uint32_t byte_order = 0x01020304;
+
+inline constexpr uint16_t red_black_flag = 1;
+
+inline constexpr unsigned char left_bit = 1;
+inline constexpr unsigned char right_bit = 2;
+inline constexpr unsigned char red_bit = 4;
+
+inline uint64_t shape_bytes(uint64_t count) {
+    return count / 2 + count % 2;
+}
+
+// what is a string literal; the message is put together on the stack.
+template<size_t Size>
+[[noreturn]] void reject(const char (&what)[Size]) {
+    constexpr char prefix[] = "bst::deserialize: ";
+    char message[sizeof(prefix) - 1 + Size];
+    std::memcpy(message, prefix, sizeof(prefix) - 1);
+    std::memcpy(message + sizeof(prefix) - 1, what, Size);
+    throw std::invalid_argument(message);
+}
+
+// A running 64-bit multiply-xor hash fed eight bytes at a time. It is meant to catch truncated or damaged
+// files, not tampering.
+class checksum {
+    uint64_t hash_ = 0x9e3779b97f4a7c15ull;
+    unsigned char pending_[8] = {};
+    size_t pending_size_ = 0;
+
+    void mix(uint64_t word) {
+        hash_ = (hash_ ^ word) * 0xff51afd7ed558ccdull;
+        hash_ ^= hash_ >> 32;
+    }
+
+  public:
+    void update(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+        if (pending_size_ != 0) {
+            size_t taken = std::min(size, sizeof(pending_) - pending_size_);
+            std::memcpy(pending_ + pending_size_, bytes, taken);
+            pending_size_ += taken;
+            bytes += taken;
+            size -= taken;
+            if (pending_size_ < sizeof(pending_)) {
+                return;
+            }
+
+            uint64_t word;
+            std::memcpy(&word, pending_, sizeof(word));
+            mix(word);
+        }
+
+        for (; size >= sizeof(uint64_t); bytes += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, bytes, sizeof(word));
+            mix(word);
+        }
+
+        std::memcpy(pending_, bytes, size);
+        pending_size_ = size;
+    }
+
+    uint64_t value() const {
+        checksum tail = *this;
+        uint64_t word = 0;
+        std::memcpy(&word, pending_, pending_size_);
+        tail.mix(word ^ (static_cast<uint64_t>(pending_size_) << 56));
+
+        return tail.hash_;
+    }
+};
+
+} // bst_format
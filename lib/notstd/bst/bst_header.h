@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+// Per-tree bookkeeping shared with iterators, so stepping from cend() never has to search.
+template<class Node>
+struct bst_header {
+    Node* root = nullptr;
+    Node* leftmost = nullptr;
+    Node* rightmost = nullptr;
+    size_t size = 0;
+};
@@ -1,8 +1,46 @@
 #pragma once
 
-template<class Tp>
-struct bst_node {
+#include "bst_augment.h"
+#include "bst_balance.h"
+#include "bst_thread.h"
+
+#include <cstddef>
+#include <utility>
+
+template<class Balance>
+struct bst_node_balance {};
+
+template<>
+struct bst_node_balance<bst_balance::red_black_tag> {
+    bool red = true;
+};
+
+template<class Augment>
+struct bst_node_augment {};
+
+template<>
+struct bst_node_augment<bst_augment::size_tag> {
+    size_t size = 1;
+};
+
+// Threaded nodes also link their in-order neighbours, so iterators step in O(1) instead of climbing the tree.
+// The threads get links of their own rather than reusing empty left/right ones behind a tag bit: every
+// structural routine keeps testing children against nullptr, at the price of two pointers per node.
+template<class Thread, class Node>
+struct bst_node_thread {};
+
+template<class Node>
+struct bst_node_thread<bst_thread::threaded_tag, Node> {
+    Node* prev = nullptr;
+    Node* next = nullptr;
+};
+
+template<class Tp, class Balance = bst_balance::none_tag, class Augment = bst_augment::none_tag,
+        class Thread = bst_thread::none_tag>
+struct bst_node : bst_node_balance<Balance>, bst_node_augment<Augment>,
+                  bst_node_thread<Thread, bst_node<Tp, Balance, Augment, Thread>> {
     using value_type = Tp;
+    using thread_type = Thread;
 
     value_type key;
     bst_node* parent = nullptr;
@@ -10,4 +48,9 @@ struct bst_node {
     bst_node* right = nullptr;
 
     explicit bst_node(const value_type& key) : key(key) {};
+
+    explicit bst_node(value_type&& key) : key(std::move(key)) {};
+
+    template<class... Args>
+    explicit bst_node(std::in_place_t, Args&&... args) : key(std::forward<Args>(args)...) {};
 };
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <utility>
+
+// Move-only owner of a node unlinked from a bst. The node keeps its allocation, so it can be relinked into
+// a tree with an equal allocator without allocating or copying the key; otherwise it is freed on destruction.
+template<class Node, class NodeAllocator>
+class bst_node_handle {
+  public:
+    using value_type = typename Node::value_type;
+    using allocator_type = typename std::allocator_traits<NodeAllocator>::template rebind_alloc<value_type>;
+
+  private:
+    using node_alloc_traits = std::allocator_traits<NodeAllocator>;
+
+    template<class Tp, class Order, class Compare, class Allocator, class Balance, class Augment, class Thread>
+    friend class bst;
+
+    Node* node_ = nullptr;
+    std::optional<NodeAllocator> allocator_;
+
+    bst_node_handle(Node* node, const NodeAllocator& allocator) : node_(node), allocator_(allocator) {}
+
+    Node* release() {
+        Node* node = node_;
+        node_ = nullptr;
+        allocator_.reset();
+
+        return node;
+    }
+
+    void reset() {
+        if (node_ != nullptr) {
+            node_alloc_traits::destroy(*allocator_, node_);
+            node_alloc_traits::deallocate(*allocator_, node_, 1);
+        }
+        node_ = nullptr;
+        allocator_.reset();
+    }
+
+  public:
+    constexpr bst_node_handle() noexcept = default;
+
+    bst_node_handle(const bst_node_handle&) = delete;
+
+    bst_node_handle(bst_node_handle&& other) noexcept
+            : node_(std::exchange(other.node_, nullptr)), allocator_(std::move(other.allocator_)) {
+        other.allocator_.reset();
+    }
+
+    bst_node_handle& operator=(const bst_node_handle&) = delete;
+
+    bst_node_handle& operator=(bst_node_handle&& other) noexcept {
+        if (this != &other) {
+            reset();
+            node_ = std::exchange(other.node_, nullptr);
+            allocator_ = std::move(other.allocator_);
+            other.allocator_.reset();
+        }
+
+        return *this;
+    }
+
+    ~bst_node_handle() {
+        reset();
+    }
+
+    [[nodiscard]] bool empty() const noexcept {
+        return node_ == nullptr;
+    }
+
+    explicit operator bool() const noexcept {
+        return node_ != nullptr;
+    }
+
+    // The handle must not be empty. The key may be changed before the node is inserted again.
+    value_type& value() const {
+        return node_->key;
+    }
+
+    allocator_type get_allocator() const {
+        return allocator_type(*allocator_);
+    }
+
+    void swap(bst_node_handle& other) noexcept {
+        std::swap(node_, other.node_);
+        std::swap(allocator_, other.allocator_);
+    }
+
+    friend void swap(bst_node_handle& lhs, bst_node_handle& rhs) noexcept {
+        lhs.swap(rhs);
+    }
+};
+
+// Result of inserting a node handle: on failure the handle comes back untouched together with the blocking key.
+template<class Iterator, class NodeHandle>
+struct bst_insert_return {
+    Iterator position;
+    bool inserted;
+    NodeHandle node;
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace bst_thread {
+
+struct none_tag {};
+struct threaded_tag {};
+
+} // bst_thread
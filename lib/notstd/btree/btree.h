@@ -0,0 +1,667 @@
+#pragma once
+
+#include "btree_const_iterator.h"
+#include "btree_header.h"
+#include "btree_node.h"
+#include "lib/notstd/bst/bst.h"
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// A B-tree holding up to btree_node_keys<Tp, NodeBytes> sorted keys per node, so a lookup touches a handful of
+// NodeBytes-sized nodes instead of one cache line per binary level. Every leaf is at the same depth and every
+// node but the root is at least half full. Keys move between nodes as the tree splits and merges, so an insert
+// or erase invalidates all iterators and references; keys must therefore be nothrow movable.
+template<class Tp, class Compare = std::less<Tp>, class Allocator = std::allocator<Tp>, size_t NodeBytes = 256>
+class btree {
+    static_assert(std::is_nothrow_move_constructible_v<Tp> && std::is_nothrow_move_assignable_v<Tp>,
+                  "btree moves keys between nodes and cannot recover from a throwing move");
+    static_assert(NodeBytes >= 32, "btree nodes need room for their bookkeeping and some keys");
+
+  public:
+    using value_type = Tp;
+    using node_type = btree_node<value_type, btree_node_keys<Tp, NodeBytes>>;
+    using inner_node_type = btree_inner_node<value_type, btree_node_keys<Tp, NodeBytes>>;
+    using slot_type = typename node_type::slot_type;
+    using value_compare = Compare;
+    using allocator_type = Allocator;
+
+  private:
+    using alloc_traits = std::allocator_traits<allocator_type>;
+
+  public:
+    using pointer = typename alloc_traits::pointer;
+    using const_pointer = typename alloc_traits::const_pointer;
+    using const_iterator = btree_const_iterator<node_type>;
+    using difference_type = typename const_iterator::difference_type;
+    using size_type = typename const_iterator::size_type;
+
+  private:
+    using leaf_allocator_type = typename alloc_traits::template rebind_alloc<node_type>;
+    using leaf_alloc_traits = std::allocator_traits<leaf_allocator_type>;
+    using inner_allocator_type = typename alloc_traits::template rebind_alloc<inner_node_type>;
+    using inner_alloc_traits = std::allocator_traits<inner_allocator_type>;
+    using header_type = btree_header<node_type>;
+
+    static constexpr slot_type max_keys = node_type::max_keys;
+    // A split leaves max_keys / 2 and (max_keys - 1) / 2 keys; fewer than the latter makes a node underfull.
+    static constexpr slot_type min_keys = (max_keys - 1) / 2;
+
+    allocator_type allocator_;
+    value_compare compare_;
+
+    header_type header_;
+
+  public:
+    explicit btree() = default;
+
+    explicit btree(const value_compare& compare) : compare_(compare) {};
+
+    explicit btree(const allocator_type& alloc) : allocator_(alloc) {};
+
+    // Copies node for node: no comparisons, and the copy has the original's shape.
+    btree(const btree& other)
+            : allocator_(alloc_traits::select_on_container_copy_construction(other.allocator_)),
+              compare_(other.compare_) {
+        copy_from(other);
+    }
+
+    btree(btree&& other) noexcept : allocator_(std::move(other.allocator_)), compare_(std::move(other.compare_)) {
+        steal(other);
+    }
+
+    btree& operator=(const btree& other) {
+        if (this == &other) {
+            return *this;
+        }
+
+        clear();
+        compare_ = other.compare_;
+        copy_from(other);
+
+        return *this;
+    }
+
+    btree& operator=(btree&& other) noexcept(alloc_traits::propagate_on_container_move_assignment::value ||
+                                             alloc_traits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+
+        clear();
+        compare_ = std::move(other.compare_);
+
+        if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+            allocator_ = std::move(other.allocator_);
+        } else if (!alloc_traits::is_always_equal::value && allocator_ != other.allocator_) {
+            // Our allocator cannot free the other nodes, so only the keys can move over.
+            for (const_iterator iter = other.cbegin(); iter != other.cend(); ++iter) {
+                insert(std::move(const_cast<value_type&>(*iter)));
+            }
+            other.clear();
+
+            return *this;
+        }
+
+        steal(other);
+
+        return *this;
+    }
+
+    template<class InputIter>
+    void assign(InputIter first, InputIter last) {
+        clear();
+        for (; first != last; ++first) {
+            insert(*first);
+        }
+    }
+
+    std::pair<const_iterator, bool> insert(const value_type& value) {
+        return place_unique(value, value);
+    }
+
+    std::pair<const_iterator, bool> insert(value_type&& value) {
+        return place_unique(value, std::move(value));
+    }
+
+    template<class... Args>
+    std::pair<const_iterator, bool> emplace(Args&&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    // The hint is not used: a descent costs a few nodes, about what checking the hint's neighbours would.
+    const_iterator insert(const_iterator, const value_type& value) {
+        return insert(value).first;
+    }
+
+    const_iterator insert(const_iterator, value_type&& value) {
+        return insert(std::move(value)).first;
+    }
+
+    template<class... Args>
+    const_iterator emplace_hint(const_iterator hint, Args&&... args) {
+        return insert(hint, value_type(std::forward<Args>(args)...));
+    }
+
+    size_type erase(const value_type& value) {
+        const_iterator iter = find(value);
+        if (iter == cend()) {
+            return 0;
+        }
+
+        erase(iter);
+
+        return 1;
+    }
+
+    const_iterator erase(const_iterator iter) {
+        if (iter == cend()) {
+            return iter;
+        }
+
+        return erase_at(const_cast<node_type*>(iter.node()), iter.slot());
+    }
+
+    // Erasing moves keys between nodes and so invalidates last; count the keys up front instead.
+    const_iterator erase(const_iterator first, const_iterator last) {
+        for (difference_type count = std::distance(first, last); count > 0; --count) {
+            first = erase(first);
+        }
+
+        return first;
+    }
+
+    const_iterator find(const value_type& value) const {
+        return find_key(value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator find(const Key& key) const {
+        return find_key(key);
+    }
+
+    // Same convention as bst: the greatest key not above value.
+    const_iterator lower_bound(const value_type& value) const {
+        return lower_bound_key(value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator lower_bound(const Key& key) const {
+        return lower_bound_key(key);
+    }
+
+    // The least key not below value.
+    const_iterator upper_bound(const value_type& value) const {
+        return upper_bound_key(value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator upper_bound(const Key& key) const {
+        return upper_bound_key(key);
+    }
+
+    void clear() {
+        if (header_.root != nullptr) {
+            destroy_subtree(header_.root);
+        }
+        header_ = header_type();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return header_.root == nullptr;
+    }
+
+    size_type size() const {
+        return header_.size;
+    }
+
+    allocator_type get_allocator() const {
+        return allocator_;
+    }
+
+    const_iterator cbegin() const {
+        return ++cend();
+    }
+
+    const_iterator cend() const {
+        return make_iterator(nullptr, 0);
+    }
+
+    ~btree() {
+        clear();
+    }
+
+  private:
+    const_iterator make_iterator(const node_type* node, slot_type slot) const {
+        return const_iterator(node, slot, &header_);
+    }
+
+    static node_type** children(node_type* node) {
+        return btree_children(node);
+    }
+
+    // The first slot of node whose key is not below key, node->count if there is none.
+    template<class Key>
+    slot_type search_slot(const node_type* node, const Key& key) const {
+        return static_cast<slot_type>(std::lower_bound(node->keys, node->keys + node->count, key, compare_) -
+                                      node->keys);
+    }
+
+    template<class Key>
+    bool found_at(const node_type* node, slot_type slot, const Key& key) const {
+        return slot < node->count && !compare_(key, node->keys[slot]);
+    }
+
+    template<class Key>
+    const_iterator find_key(const Key& key) const {
+        const node_type* node = header_.root;
+
+        while (node != nullptr) {
+            slot_type slot = search_slot(node, key);
+            if (found_at(node, slot, key)) {
+                return make_iterator(node, slot);
+            }
+            node = node->leaf ? nullptr : btree_children(node)[slot];
+        }
+
+        return cend();
+    }
+
+    // A candidate met lower in the tree lies between the ones above it and the key, so the last one wins.
+    template<class Key>
+    const_iterator lower_bound_key(const Key& key) const {
+        const node_type* node = header_.root;
+        const_iterator lower_bound = cend();
+
+        while (node != nullptr) {
+            slot_type slot = static_cast<slot_type>(
+                    std::upper_bound(node->keys, node->keys + node->count, key, compare_) - node->keys);
+            if (slot > 0) {
+                lower_bound = make_iterator(node, slot - 1);
+                if (!compare_(node->keys[slot - 1], key)) {
+                    break;
+                }
+            }
+            node = node->leaf ? nullptr : btree_children(node)[slot];
+        }
+
+        return lower_bound;
+    }
+
+    template<class Key>
+    const_iterator upper_bound_key(const Key& key) const {
+        const node_type* node = header_.root;
+        const_iterator upper_bound = cend();
+
+        while (node != nullptr) {
+            slot_type slot = search_slot(node, key);
+            if (slot < node->count) {
+                upper_bound = make_iterator(node, slot);
+                if (!compare_(key, node->keys[slot])) {
+                    break;
+                }
+            }
+            node = node->leaf ? nullptr : btree_children(node)[slot];
+        }
+
+        return upper_bound;
+    }
+
+    // Only constructs the key from args once it is known to be new.
+    template<class... Args>
+    std::pair<const_iterator, bool> place_unique(const value_type& key, Args&&... args) {
+        if (header_.root == nullptr) {
+            node_type* leaf = create_node(true);
+            try {
+                construct_key(leaf, 0, std::forward<Args>(args)...);
+            } catch (...) {
+                destroy_node(leaf);
+                throw;
+            }
+            leaf->count = 1;
+            header_.root = leaf;
+            header_.size = 1;
+
+            return std::make_pair(make_iterator(leaf, 0), true);
+        }
+
+        node_type* node = header_.root;
+        slot_type slot = search_slot(node, key);
+        while (!found_at(node, slot, key) && !node->leaf) {
+            node = children(node)[slot];
+            slot = search_slot(node, key);
+        }
+        if (found_at(node, slot, key)) {
+            return std::make_pair(make_iterator(node, slot), false);
+        }
+
+        if (node->count == max_keys) {
+            node_type* right = split(node);
+            if (slot > node->count) {
+                slot -= node->count + 1;
+                node = right;
+            }
+        }
+
+        if (slot == node->count) {
+            construct_key(node, slot, std::forward<Args>(args)...);
+            ++node->count;
+        } else {
+            open_slot(node, slot, value_type(std::forward<Args>(args)...));
+        }
+        ++header_.size;
+
+        return std::make_pair(make_iterator(node, slot), true);
+    }
+
+    // Splits a full node around its middle key, which moves up into the parent; returns the new right half.
+    // A full parent is split first, so the tree only ever grows at the root.
+    node_type* split(node_type* node) {
+        if (node->parent != nullptr && node->parent->count == max_keys) {
+            split(node->parent);
+        }
+
+        node_type* right = create_node(node->leaf);
+        node_type* root = nullptr;
+        if (node->parent == nullptr) {
+            try {
+                root = create_node(false);
+            } catch (...) {
+                destroy_node(right);
+                throw;
+            }
+        }
+
+        // No allocation below, so nothing can throw.
+        slot_type half = max_keys / 2;
+        for (slot_type slot = half + 1; slot < node->count; ++slot) {
+            construct_key(right, slot - half - 1, std::move(node->keys[slot]));
+            destroy_key(node, slot);
+        }
+        right->count = node->count - half - 1;
+        if (!node->leaf) {
+            for (slot_type slot = 0; slot <= right->count; ++slot) {
+                set_child(right, slot, children(node)[half + 1 + slot]);
+            }
+        }
+
+        value_type middle(std::move(node->keys[half]));
+        destroy_key(node, half);
+        node->count = half;
+
+        if (root != nullptr) {
+            set_child(root, 0, node);
+            header_.root = root;
+        }
+        node_type* parent = node->parent;
+        open_slot(parent, node->position, std::move(middle));
+        for (slot_type slot = parent->count; slot > node->position + 1; --slot) {
+            set_child(parent, slot, children(parent)[slot - 1]);
+        }
+        set_child(parent, node->position + 1, right);
+
+        return right;
+    }
+
+    // Erases the key at slot of node and returns the position after it. A key in an inner node is first
+    // replaced by its predecessor, which always sits at the end of a leaf, so only leaves ever lose a key.
+    const_iterator erase_at(node_type* node, slot_type slot) {
+        bool inner = !node->leaf;
+        if (inner) {
+            node_type* leaf = children(node)[slot];
+            while (!leaf->leaf) {
+                leaf = children(leaf)[leaf->count];
+            }
+            node->keys[slot] = std::move(leaf->keys[leaf->count - 1]);
+            node = leaf;
+            slot = leaf->count - 1;
+        }
+
+        close_slot(node, slot);
+        --header_.size;
+        rebalance(node, slot);
+
+        // The cursor now marks the gap the key left: the next key is the first one after it.
+        while (node != nullptr && slot == node->count) {
+            slot = node->position;
+            node = node->parent;
+        }
+        const_iterator result = make_iterator(node, (node != nullptr) ? slot : 0);
+        if (inner) {
+            // The gap was the predecessor's, and the predecessor itself now stands in for the erased key.
+            ++result;
+        }
+
+        return result;
+    }
+
+    // Restores the minimum fill from leaf upwards, moving the cursor (node, slot) along with the keys of its leaf.
+    void rebalance(node_type*& cursor, slot_type& slot) {
+        node_type* node = cursor;
+
+        while (node != header_.root) {
+            if (node->count >= min_keys) {
+                return;
+            }
+
+            node_type* parent = node->parent;
+            slot_type position = node->position;
+            node_type* left = (position > 0) ? children(parent)[position - 1] : nullptr;
+            node_type* right = (position < parent->count) ? children(parent)[position + 1] : nullptr;
+
+            if (left != nullptr && left->count > min_keys) {
+                rotate_right(parent, position - 1);
+                if (node == cursor) {
+                    ++slot;
+                }
+                return;
+            }
+            if (right != nullptr && right->count > min_keys) {
+                rotate_left(parent, position);
+                return;
+            }
+
+            if (left != nullptr) {
+                if (node == cursor) {
+                    cursor = left;
+                    slot += left->count + 1;
+                }
+                merge(parent, position - 1);
+            } else {
+                merge(parent, position);
+            }
+            node = parent;
+        }
+
+        if (node->count == 0) {
+            if (node->leaf) {
+                header_.root = nullptr;
+                cursor = nullptr;
+                slot = 0;
+            } else {
+                header_.root = children(node)[0];
+                header_.root->parent = nullptr;
+                header_.root->position = 0;
+            }
+            destroy_node(node);
+        }
+    }
+
+    // Moves the last key of child position into the parent and the separator down into the next child.
+    void rotate_right(node_type* parent, slot_type position) {
+        node_type* left = children(parent)[position];
+        node_type* right = children(parent)[position + 1];
+
+        open_slot(right, 0, std::move(parent->keys[position]));
+        parent->keys[position] = std::move(left->keys[left->count - 1]);
+        if (!right->leaf) {
+            for (slot_type slot = right->count; slot > 0; --slot) {
+                set_child(right, slot, children(right)[slot - 1]);
+            }
+            set_child(right, 0, children(left)[left->count]);
+        }
+        close_slot(left, left->count - 1);
+    }
+
+    // The mirror of rotate_right: the first key of child position + 1 replaces the separator, which moves left.
+    void rotate_left(node_type* parent, slot_type position) {
+        node_type* left = children(parent)[position];
+        node_type* right = children(parent)[position + 1];
+
+        construct_key(left, left->count, std::move(parent->keys[position]));
+        ++left->count;
+        parent->keys[position] = std::move(right->keys[0]);
+        if (!right->leaf) {
+            set_child(left, left->count, children(right)[0]);
+            for (slot_type slot = 0; slot < right->count; ++slot) {
+                set_child(right, slot, children(right)[slot + 1]);
+            }
+        }
+        close_slot(right, 0);
+    }
+
+    // Folds child position + 1 and the separator between them into child position.
+    void merge(node_type* parent, slot_type position) {
+        node_type* left = children(parent)[position];
+        node_type* right = children(parent)[position + 1];
+
+        construct_key(left, left->count, std::move(parent->keys[position]));
+        for (slot_type slot = 0; slot < right->count; ++slot) {
+            construct_key(left, left->count + 1 + slot, std::move(right->keys[slot]));
+        }
+        if (!left->leaf) {
+            for (slot_type slot = 0; slot <= right->count; ++slot) {
+                set_child(left, left->count + 1 + slot, children(right)[slot]);
+            }
+        }
+        left->count += 1 + right->count;
+
+        close_slot(parent, position);
+        for (slot_type slot = position + 1; slot <= parent->count; ++slot) {
+            set_child(parent, slot, children(parent)[slot + 1]);
+        }
+        destroy_keys(right);
+        destroy_node(right);
+    }
+
+    // Shifts the keys from slot on one place right and moves value into the gap; node must not be full.
+    void open_slot(node_type* node, slot_type slot, value_type&& value) {
+        if (slot == node->count) {
+            construct_key(node, slot, std::move(value));
+        } else {
+            construct_key(node, node->count, std::move(node->keys[node->count - 1]));
+            std::move_backward(node->keys + slot, node->keys + node->count - 1, node->keys + node->count);
+            node->keys[slot] = std::move(value);
+        }
+        ++node->count;
+    }
+
+    // Removes the key at slot, shifting the ones after it left.
+    void close_slot(node_type* node, slot_type slot) {
+        std::move(node->keys + slot + 1, node->keys + node->count, node->keys + slot);
+        --node->count;
+        destroy_key(node, node->count);
+    }
+
+    void set_child(node_type* node, slot_type slot, node_type* child) {
+        children(node)[slot] = child;
+        child->parent = node;
+        child->position = slot;
+    }
+
+    template<class... Args>
+    void construct_key(node_type* node, slot_type slot, Args&&... args) {
+        alloc_traits::construct(allocator_, std::addressof(node->keys[slot]), std::forward<Args>(args)...);
+    }
+
+    void destroy_key(node_type* node, slot_type slot) {
+        alloc_traits::destroy(allocator_, std::addressof(node->keys[slot]));
+    }
+
+    void destroy_keys(node_type* node) {
+        for (slot_type slot = 0; slot < node->count; ++slot) {
+            destroy_key(node, slot);
+        }
+        node->count = 0;
+    }
+
+    node_type* create_node(bool leaf) {
+        if (leaf) {
+            leaf_allocator_type leaf_allocator(allocator_);
+            node_type* node = leaf_alloc_traits::allocate(leaf_allocator, 1);
+            leaf_alloc_traits::construct(leaf_allocator, node);
+
+            return node;
+        }
+
+        inner_allocator_type inner_allocator(allocator_);
+        inner_node_type* node = inner_alloc_traits::allocate(inner_allocator, 1);
+        inner_alloc_traits::construct(inner_allocator, node);
+
+        return node;
+    }
+
+    // Frees a node whose keys are already gone.
+    void destroy_node(node_type* node) {
+        if (node->leaf) {
+            leaf_allocator_type leaf_allocator(allocator_);
+            leaf_alloc_traits::destroy(leaf_allocator, node);
+            leaf_alloc_traits::deallocate(leaf_allocator, node, 1);
+        } else {
+            inner_allocator_type inner_allocator(allocator_);
+            inner_node_type* inner = static_cast<inner_node_type*>(node);
+            inner_alloc_traits::destroy(inner_allocator, inner);
+            inner_alloc_traits::deallocate(inner_allocator, inner, 1);
+        }
+    }
+
+    void destroy_subtree(node_type* node) {
+        if (!node->leaf) {
+            for (slot_type slot = 0; slot <= node->count; ++slot) {
+                destroy_subtree(children(node)[slot]);
+            }
+        }
+        destroy_keys(node);
+        destroy_node(node);
+    }
+
+    node_type* copy_subtree(const node_type* other) {
+        node_type* node = create_node(other->leaf);
+        slot_type copied_children = 0;
+
+        try {
+            for (; node->count < other->count; ++node->count) {
+                construct_key(node, node->count, other->keys[node->count]);
+            }
+            if (!other->leaf) {
+                for (; copied_children <= other->count; ++copied_children) {
+                    set_child(node, copied_children, copy_subtree(btree_children(other)[copied_children]));
+                }
+            }
+        } catch (...) {
+            for (slot_type slot = 0; slot < copied_children; ++slot) {
+                destroy_subtree(children(node)[slot]);
+            }
+            destroy_keys(node);
+            destroy_node(node);
+            throw;
+        }
+
+        return node;
+    }
+
+    void copy_from(const btree& other) {
+        if (other.header_.root != nullptr) {
+            header_.root = copy_subtree(other.header_.root);
+            header_.size = other.header_.size;
+        }
+    }
+
+    void steal(btree& other) {
+        header_ = other.header_;
+        other.header_ = header_type();
+    }
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "btree_header.h"
+#include "btree_node.h"
+
+#include <cstddef>
+#include <iterator>
+
+// Walks btree in key order. It stands on a node and a slot in it; end() has no node.
+template<class Node>
+class btree_const_iterator {
+  public:
+    using difference_type = ptrdiff_t;
+    using size_type = size_t;
+    using value_type = typename Node::value_type;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using header_type = btree_header<Node>;
+    using slot_type = typename Node::slot_type;
+
+  private:
+    const Node* node_;
+    slot_type slot_;
+    const header_type* header_;
+
+  public:
+    explicit btree_const_iterator(const Node* node, slot_type slot, const header_type* header)
+            : node_(node), slot_(slot), header_(header) {}
+
+    bool operator==(const btree_const_iterator& other) const {
+        return node_ == other.node_ && slot_ == other.slot_;
+    }
+
+    bool operator!=(const btree_const_iterator& other) const {
+        return !(*this == other);
+    }
+
+    reference operator*() const {
+        return node_->keys[slot_];
+    }
+
+    pointer operator->() const {
+        return &node_->keys[slot_];
+    }
+
+    // The node the iterator stands on, nullptr for end().
+    const Node* node() const {
+        return node_;
+    }
+
+    slot_type slot() const {
+        return slot_;
+    }
+
+    btree_const_iterator& operator++() {
+        if (node_ == nullptr) {
+            if (header_->root != nullptr) {
+                node_ = header_->root;
+                descend_left();
+            }
+        } else if (!node_->leaf) {
+            node_ = btree_children(node_)[slot_ + 1];
+            descend_left();
+        } else {
+            ++slot_;
+            climb_while_past_end();
+        }
+
+        return *this;
+    }
+
+    btree_const_iterator operator++(int) {
+        btree_const_iterator result = *this;
+        ++*this;
+
+        return result;
+    }
+
+    btree_const_iterator& operator--() {
+        if (node_ == nullptr) {
+            if (header_->root != nullptr) {
+                node_ = header_->root;
+                descend_right();
+            }
+        } else if (!node_->leaf) {
+            node_ = btree_children(node_)[slot_];
+            descend_right();
+        } else if (slot_ > 0) {
+            --slot_;
+        } else {
+            while (node_ != nullptr && node_->position == 0) {
+                node_ = node_->parent;
+            }
+            slot_ = (node_ != nullptr) ? node_->position - 1 : 0;
+            node_ = (node_ != nullptr) ? node_->parent : nullptr;
+        }
+
+        return *this;
+    }
+
+    btree_const_iterator operator--(int) {
+        btree_const_iterator result = *this;
+        --*this;
+
+        return result;
+    }
+
+  private:
+    void descend_left() {
+        while (!node_->leaf) {
+            node_ = btree_children(node_)[0];
+        }
+        slot_ = 0;
+    }
+
+    void descend_right() {
+        while (!node_->leaf) {
+            node_ = btree_children(node_)[node_->count];
+        }
+        slot_ = node_->count - 1;
+    }
+
+    // Past the last key of a node, the next key is the separator above it in the first ancestor not yet done.
+    void climb_while_past_end() {
+        while (node_ != nullptr && slot_ == node_->count) {
+            slot_ = node_->position;
+            node_ = node_->parent;
+        }
+        if (node_ == nullptr) {
+            slot_ = 0;
+        }
+    }
+};
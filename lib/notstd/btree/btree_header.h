@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+// Per-tree bookkeeping shared with iterators, which step back from end() through the root.
+template<class Node>
+struct btree_header {
+    Node* root = nullptr;
+    size_t size = 0;
+};
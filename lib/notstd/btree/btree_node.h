@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// How many keys a btree node holds when its leaf form should fit in NodeBytes: at least three, so that a split
+// always leaves both halves non-empty, and few enough to count in 16 bits.
+template<class Tp, size_t NodeBytes>
+inline constexpr size_t btree_node_keys = std::clamp<size_t>((NodeBytes - 16) / sizeof(Tp), 3, 0xffff);
+
+// A leaf of btree: up to Keys sorted keys in a union, so that only the first count of them are ever constructed.
+// Inner nodes extend it with child links; leaves do not pay for them.
+template<class Tp, size_t Keys>
+struct btree_node {
+    using value_type = Tp;
+    using slot_type = uint16_t;
+
+    static constexpr size_t max_keys = Keys;
+
+    btree_node* parent = nullptr;
+    // The index of this node among parent's children.
+    slot_type position = 0;
+    slot_type count = 0;
+    bool leaf = true;
+
+    union {
+        value_type keys[Keys];
+    };
+
+    btree_node() {}
+
+    btree_node(const btree_node&) = delete;
+
+    btree_node& operator=(const btree_node&) = delete;
+
+    ~btree_node() {}
+};
+
+template<class Tp, size_t Keys>
+struct btree_inner_node : btree_node<Tp, Keys> {
+    btree_node<Tp, Keys>* children[Keys + 1];
+
+    btree_inner_node() {
+        this->leaf = false;
+    }
+};
+
+// Children of node, which must be an inner node.
+template<class Tp, size_t Keys>
+btree_node<Tp, Keys>** btree_children(btree_node<Tp, Keys>* node) {
+    return static_cast<btree_inner_node<Tp, Keys>*>(node)->children;
+}
+
+template<class Tp, size_t Keys>
+btree_node<Tp, Keys>* const* btree_children(const btree_node<Tp, Keys>* node) {
+    return static_cast<const btree_inner_node<Tp, Keys>*>(node)->children;
+}
@@ -0,0 +1,802 @@
+#pragma once
+
+#include "compact_const_iterator.h"
+#include "compact_header.h"
+#include "compact_node.h"
+#include "lib/notstd/bst/bst.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// A binary search tree whose nodes live in one contiguous array and link to each other by 32-bit index. There is
+// no per-node allocation: the array doubles when full and erased slots are recycled through a free list, so the
+// tree costs 12 bytes of links per key plus padding, and neighbouring inserts tend to share cache lines.
+// Iterators survive reallocation; references and pointers to keys do not, unlike with bst.
+template<class Tp, class Order = bst_order::in_order_tag, class Compare = std::less<Tp>,
+        class Allocator = std::allocator<Tp>, class Balance = bst_balance::none_tag>
+class compact_bst {
+  public:
+    using value_type = Tp;
+    using node_type = compact_node<value_type>;
+    using index_type = typename node_type::index_type;
+    using value_compare = Compare;
+    using allocator_type = Allocator;
+    using balance_type = Balance;
+
+  private:
+    using alloc_traits = std::allocator_traits<allocator_type>;
+
+  public:
+    using pointer = typename alloc_traits::pointer;
+    using const_pointer = typename alloc_traits::const_pointer;
+    using const_iterator = compact_const_iterator<node_type, Order>;
+    using difference_type = typename const_iterator::difference_type;
+    using size_type = typename const_iterator::size_type;
+
+    using node_allocator_type = typename alloc_traits::template rebind_alloc<node_type>;
+
+  private:
+    using node_alloc_traits = std::allocator_traits<node_allocator_type>;
+    using header_type = compact_header<node_type>;
+
+    static constexpr index_type nil = node_type::nil;
+
+    node_allocator_type allocator_;
+    value_compare compare_;
+
+    header_type header_;
+    // Slots [0, used_) have been handed out at least once; free_ heads the list of those erased since.
+    index_type capacity_ = 0;
+    index_type used_ = 0;
+    index_type free_ = nil;
+
+  public:
+    explicit compact_bst() = default;
+
+    explicit compact_bst(const value_compare& compare) : compare_(compare) {};
+
+    explicit compact_bst(const allocator_type& alloc) : allocator_(alloc) {};
+
+    // Copies the array slot for slot: no comparisons, and the copy keeps the original's shape and layout.
+    compact_bst(const compact_bst& other)
+            : allocator_(node_alloc_traits::select_on_container_copy_construction(other.allocator_)),
+              compare_(other.compare_) {
+        copy_from(other);
+    }
+
+    compact_bst(compact_bst&& other) noexcept
+            : allocator_(std::move(other.allocator_)), compare_(std::move(other.compare_)) {
+        steal(other);
+    }
+
+    compact_bst& operator=(const compact_bst& other) {
+        if (this == &other) {
+            return *this;
+        }
+
+        release();
+        compare_ = other.compare_;
+        copy_from(other);
+
+        return *this;
+    }
+
+    compact_bst& operator=(compact_bst&& other) noexcept(node_alloc_traits::propagate_on_container_move_assignment::value ||
+                                                         node_alloc_traits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+
+        release();
+        compare_ = std::move(other.compare_);
+
+        if constexpr (node_alloc_traits::propagate_on_container_move_assignment::value) {
+            allocator_ = std::move(other.allocator_);
+        } else if (!node_alloc_traits::is_always_equal::value && allocator_ != other.allocator_) {
+            // Our allocator cannot free the other array, so only the keys can move over.
+            for (index_type index = other.header_.leftmost; index != nil; index = other.next_index(index)) {
+                insert(cend(), std::move(other.node(index).key));
+            }
+            other.release();
+
+            return *this;
+        }
+
+        steal(other);
+
+        return *this;
+    }
+
+    template<class InputIter>
+    void assign(InputIter first, InputIter last) {
+        clear();
+        for (const_iterator hint = cend(); first != last; ++first) {
+            hint = insert(hint, *first);
+        }
+    }
+
+    // Grows the array to hold at least count keys without reallocating.
+    void reserve(size_type count) {
+        if (count > node_type::max_size) {
+            throw std::length_error("compact_bst::reserve");
+        }
+        if (count > capacity_) {
+            reallocate(static_cast<index_type>(count));
+        }
+    }
+
+    std::pair<const_iterator, bool> insert(const value_type& value) {
+        return place_unique(value, [&] { return create_node(value); });
+    }
+
+    std::pair<const_iterator, bool> insert(value_type&& value) {
+        return place_unique(value, [&] { return create_node(std::move(value)); });
+    }
+
+    template<class... Args>
+    std::pair<const_iterator, bool> emplace(Args&&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    // Inserts as close as possible to just before hint; O(1) amortized when hint is adjacent to the key.
+    const_iterator insert(const_iterator hint, const value_type& value) {
+        return place_unique_hint(hint, value, [&] { return create_node(value); });
+    }
+
+    const_iterator insert(const_iterator hint, value_type&& value) {
+        return place_unique_hint(hint, value, [&] { return create_node(std::move(value)); });
+    }
+
+    template<class... Args>
+    const_iterator emplace_hint(const_iterator hint, Args&&... args) {
+        return insert(hint, value_type(std::forward<Args>(args)...));
+    }
+
+    size_type erase(const value_type& value) {
+        index_type index = find_index(value);
+        if (index == nil) {
+            return 0;
+        }
+
+        unlink_node(index);
+        delete_node(index);
+
+        return 1;
+    }
+
+    const_iterator erase(const_iterator iter) {
+        if (iter == cend()) {
+            return iter;
+        }
+        index_type index = iter.index();
+
+        ++iter;
+        unlink_node(index);
+        delete_node(index);
+
+        return iter;
+    }
+
+    const_iterator erase(const_iterator first, const_iterator last) {
+        while (first != last) {
+            first = erase(first);
+        }
+
+        return last;
+    }
+
+    const_iterator find(const value_type& value) const {
+        return make_iterator(find_index(value));
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator find(const Key& key) const {
+        return make_iterator(find_index(key));
+    }
+
+    // Same convention as bst: the greatest key not above value.
+    const_iterator lower_bound(const value_type& value) const {
+        return lower_bound_key(value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator lower_bound(const Key& key) const {
+        return lower_bound_key(key);
+    }
+
+    // The least key not below value.
+    const_iterator upper_bound(const value_type& value) const {
+        return upper_bound_key(value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator upper_bound(const Key& key) const {
+        return upper_bound_key(key);
+    }
+
+    // Destroys the keys but keeps the array for reuse.
+    void clear() {
+        destroy_keys();
+        header_ = header_type{header_.nodes};
+        used_ = 0;
+        free_ = nil;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return header_.root == nil;
+    }
+
+    size_type size() const {
+        return header_.size;
+    }
+
+    size_type capacity() const {
+        return capacity_;
+    }
+
+    allocator_type get_allocator() const {
+        return allocator_type(allocator_);
+    }
+
+    const_iterator cbegin() const {
+        if (header_.root == nil) {
+            return cend();
+        }
+        if constexpr (std::is_same_v<Order, bst_order::in_order_tag>) {
+            return make_iterator(header_.leftmost);
+        } else if constexpr (std::is_same_v<Order, bst_order::pre_order_tag>) {
+            return make_iterator(header_.root);
+        } else {
+            return ++cend();
+        }
+    }
+
+    const_iterator cend() const {
+        return make_iterator(nil);
+    }
+
+    ~compact_bst() {
+        release();
+    }
+
+  private:
+    node_type& node(index_type index) const {
+        return header_.nodes[index];
+    }
+
+    const_iterator make_iterator(index_type index) const {
+        return const_iterator(index, &header_);
+    }
+
+    template<class Key>
+    index_type find_index(const Key& key) const {
+        index_type current = header_.root;
+
+        while (current != nil) {
+            if (compare_(key, node(current).key)) {
+                current = node(current).left;
+            } else if (compare_(node(current).key, key)) {
+                current = node(current).right;
+            } else {
+                return current;
+            }
+        }
+
+        return nil;
+    }
+
+    template<class Key>
+    const_iterator lower_bound_key(const Key& key) const {
+        index_type current = header_.root;
+        index_type lower_bound = nil;
+
+        while (current != nil) {
+            if (!compare_(key, node(current).key)) {
+                lower_bound = current;
+                current = node(current).right;
+            } else {
+                current = node(current).left;
+            }
+        }
+
+        return make_iterator(lower_bound);
+    }
+
+    template<class Key>
+    const_iterator upper_bound_key(const Key& key) const {
+        index_type current = header_.root;
+        index_type upper_bound = nil;
+
+        while (current != nil) {
+            if (!compare_(node(current).key, key)) {
+                upper_bound = current;
+                current = node(current).left;
+            } else {
+                current = node(current).right;
+            }
+        }
+
+        return make_iterator(upper_bound);
+    }
+
+    // As in bst, make_node is only called once the key is known to be new.
+    template<class Key, class MakeNode>
+    std::pair<const_iterator, bool> place_unique(const Key& key, MakeNode make_node) {
+        index_type current = header_.root;
+        index_type parent = nil;
+        bool to_left = false;
+
+        while (current != nil) {
+            parent = current;
+            if (compare_(key, node(current).key)) {
+                current = node(current).left;
+                to_left = true;
+            } else if (compare_(node(current).key, key)) {
+                current = node(current).right;
+                to_left = false;
+            } else {
+                return std::make_pair(make_iterator(current), false);
+            }
+        }
+
+        return std::make_pair(link_new(parent, to_left, make_node), true);
+    }
+
+    template<class Key, class MakeNode>
+    const_iterator place_unique_hint(const_iterator hint, const Key& key, MakeNode make_node) {
+        index_type position = hint.index();
+
+        if (position == nil) {
+            if (header_.rightmost != nil && compare_(node(header_.rightmost).key, key)) {
+                return link_new(header_.rightmost, false, make_node);
+            }
+        } else if (compare_(key, node(position).key)) {
+            if (position == header_.leftmost) {
+                return link_new(position, true, make_node);
+            }
+
+            index_type before = prev_index(position);
+            if (compare_(node(before).key, key)) {
+                if (node(before).right == nil) {
+                    return link_new(before, false, make_node);
+                }
+                return link_new(position, true, make_node);
+            }
+        } else if (compare_(node(position).key, key)) {
+            if (position == header_.rightmost) {
+                return link_new(position, false, make_node);
+            }
+
+            index_type after = next_index(position);
+            if (compare_(key, node(after).key)) {
+                if (node(position).right == nil) {
+                    return link_new(position, false, make_node);
+                }
+                return link_new(after, true, make_node);
+            }
+        } else {
+            return hint;
+        }
+
+        return place_unique(key, make_node).first;
+    }
+
+    template<class MakeNode>
+    const_iterator link_new(index_type parent, bool to_left, MakeNode& make_node) {
+        index_type index = make_node();
+        link_node(index, parent, to_left);
+
+        return make_iterator(index);
+    }
+
+    // Takes a slot from the free list or the untouched tail, growing the array if neither has one. The slot is
+    // only claimed once the key has been constructed in it.
+    template<class... Args>
+    index_type create_node(Args&&... args) {
+        if (free_ == nil && used_ == capacity_) {
+            if (capacity_ == node_type::max_size) {
+                throw std::length_error("compact_bst: too many keys");
+            }
+            reallocate(capacity_ < node_type::max_size / 2 ? std::max<index_type>(2 * capacity_, 16)
+                                                           : node_type::max_size);
+        }
+
+        index_type index = (free_ != nil) ? free_ : used_;
+        if (index == used_) {
+            node_alloc_traits::construct(allocator_, header_.nodes + index);
+        }
+
+        allocator_type key_allocator(allocator_);
+        alloc_traits::construct(key_allocator, std::addressof(node(index).key), std::forward<Args>(args)...);
+
+        if (index == free_) {
+            free_ = node(index).left;
+        } else {
+            ++used_;
+        }
+        node(index).parent_link = nil;
+        node(index).left = node(index).right = nil;
+
+        return index;
+    }
+
+    void delete_node(index_type index) {
+        allocator_type key_allocator(allocator_);
+        alloc_traits::destroy(key_allocator, std::addressof(node(index).key));
+
+        node(index).parent_link = node_type::vacant;
+        node(index).left = free_;
+        free_ = index;
+    }
+
+    // Moves every slot into a new array of the given capacity. Indices do not change, so neither do the links.
+    void reallocate(index_type capacity) {
+        node_type* nodes = node_alloc_traits::allocate(allocator_, capacity);
+        allocator_type key_allocator(allocator_);
+        index_type moved = 0;
+
+        try {
+            for (; moved < used_; ++moved) {
+                node_type& source = node(moved);
+                node_alloc_traits::construct(allocator_, nodes + moved);
+                if (source.parent_link != node_type::vacant) {
+                    alloc_traits::construct(key_allocator, std::addressof(nodes[moved].key),
+                                            std::move_if_noexcept(source.key));
+                }
+                nodes[moved].parent_link = source.parent_link;
+                nodes[moved].left = source.left;
+                nodes[moved].right = source.right;
+            }
+        } catch (...) {
+            for (index_type index = 0; index < moved; ++index) {
+                if (nodes[index].parent_link != node_type::vacant) {
+                    alloc_traits::destroy(key_allocator, std::addressof(nodes[index].key));
+                }
+                node_alloc_traits::destroy(allocator_, nodes + index);
+            }
+            node_alloc_traits::deallocate(allocator_, nodes, capacity);
+            throw;
+        }
+
+        destroy_keys();
+        free_array();
+        header_.nodes = nodes;
+        capacity_ = capacity;
+    }
+
+    void copy_from(const compact_bst& other) {
+        if (other.used_ == 0) {
+            return;
+        }
+
+        reallocate(other.used_);
+        allocator_type key_allocator(allocator_);
+
+        for (index_type index = 0; index < other.used_; ++index) {
+            const node_type& source = other.node(index);
+            node_alloc_traits::construct(allocator_, header_.nodes + index);
+            node(index).parent_link = node_type::vacant;
+
+            if (source.parent_link != node_type::vacant) {
+                try {
+                    alloc_traits::construct(key_allocator, std::addressof(node(index).key), source.key);
+                } catch (...) {
+                    used_ = index;
+                    release();
+                    throw;
+                }
+            }
+            node(index).parent_link = source.parent_link;
+            node(index).left = source.left;
+            node(index).right = source.right;
+        }
+
+        used_ = other.used_;
+        free_ = other.free_;
+        header_ = header_type{header_.nodes, other.header_.root, other.header_.leftmost, other.header_.rightmost,
+                              other.header_.size};
+    }
+
+    void steal(compact_bst& other) {
+        header_ = other.header_;
+        capacity_ = other.capacity_;
+        used_ = other.used_;
+        free_ = other.free_;
+
+        other.header_ = header_type();
+        other.capacity_ = other.used_ = 0;
+        other.free_ = nil;
+    }
+
+    void destroy_keys() {
+        allocator_type key_allocator(allocator_);
+        for (index_type index = 0; index < used_; ++index) {
+            if (node(index).parent_link != node_type::vacant) {
+                alloc_traits::destroy(key_allocator, std::addressof(node(index).key));
+                node(index).parent_link = node_type::vacant;
+            }
+        }
+    }
+
+    // Frees the array; the keys must already be gone or moved out.
+    void free_array() {
+        if (header_.nodes == nullptr) {
+            return;
+        }
+
+        for (index_type index = 0; index < used_; ++index) {
+            node_alloc_traits::destroy(allocator_, header_.nodes + index);
+        }
+        node_alloc_traits::deallocate(allocator_, header_.nodes, capacity_);
+        header_.nodes = nullptr;
+    }
+
+    void release() {
+        destroy_keys();
+        free_array();
+        header_ = header_type();
+        capacity_ = used_ = 0;
+        free_ = nil;
+    }
+
+    index_type next_index(index_type index) const {
+        if (node(index).right != nil) {
+            index = node(index).right;
+            while (node(index).left != nil) {
+                index = node(index).left;
+            }
+            return index;
+        }
+
+        while (node(index).parent() != nil && node(node(index).parent()).right == index) {
+            index = node(index).parent();
+        }
+
+        return node(index).parent();
+    }
+
+    index_type prev_index(index_type index) const {
+        if (node(index).left != nil) {
+            index = node(index).left;
+            while (node(index).right != nil) {
+                index = node(index).right;
+            }
+            return index;
+        }
+
+        while (node(index).parent() != nil && node(node(index).parent()).left == index) {
+            index = node(index).parent();
+        }
+
+        return node(index).parent();
+    }
+
+    void link_node(index_type index, index_type parent, bool to_left) {
+        if (parent == nil) {
+            header_.leftmost = header_.rightmost = index;
+        } else if (to_left && parent == header_.leftmost) {
+            header_.leftmost = index;
+        } else if (!to_left && parent == header_.rightmost) {
+            header_.rightmost = index;
+        }
+        ++header_.size;
+
+        node(index).set_parent(parent);
+        if (parent == nil) {
+            header_.root = index;
+        } else if (to_left) {
+            node(parent).left = index;
+        } else {
+            node(parent).right = index;
+        }
+
+        rebalance_after_insert(index, Balance());
+    }
+
+    void unlink_node(index_type index) {
+        if (index == header_.leftmost) {
+            header_.leftmost = next_index(index);
+        }
+        if (index == header_.rightmost) {
+            header_.rightmost = prev_index(index);
+        }
+        --header_.size;
+
+        index_type child;
+        index_type child_parent;
+        bool removed_red = node(index).red();
+
+        if (node(index).left == nil || node(index).right == nil) {
+            child = (node(index).left != nil) ? node(index).left : node(index).right;
+            child_parent = node(index).parent();
+            transplant(index, child);
+        } else {
+            index_type successor = node(index).right;
+            while (node(successor).left != nil) {
+                successor = node(successor).left;
+            }
+
+            child = node(successor).right;
+            if (node(successor).parent() == index) {
+                child_parent = successor;
+            } else {
+                child_parent = node(successor).parent();
+                transplant(successor, child);
+                node(successor).right = node(index).right;
+                node(node(successor).right).set_parent(successor);
+            }
+
+            transplant(index, successor);
+            node(successor).left = node(index).left;
+            node(node(successor).left).set_parent(successor);
+
+            bool successor_red = node(successor).red();
+            node(successor).set_red(removed_red);
+            removed_red = successor_red;
+        }
+
+        if (!removed_red) {
+            rebalance_after_erase(child, child_parent, Balance());
+        }
+    }
+
+    void transplant(index_type index, index_type replacement) {
+        index_type parent = node(index).parent();
+        if (parent == nil) {
+            header_.root = replacement;
+        } else if (node(parent).left == index) {
+            node(parent).left = replacement;
+        } else {
+            node(parent).right = replacement;
+        }
+
+        if (replacement != nil) {
+            node(replacement).set_parent(parent);
+        }
+    }
+
+    void rotate_left(index_type index) {
+        index_type pivot = node(index).right;
+
+        node(index).right = node(pivot).left;
+        if (node(pivot).left != nil) {
+            node(node(pivot).left).set_parent(index);
+        }
+
+        transplant(index, pivot);
+        node(pivot).left = index;
+        node(index).set_parent(pivot);
+    }
+
+    void rotate_right(index_type index) {
+        index_type pivot = node(index).left;
+
+        node(index).left = node(pivot).right;
+        if (node(pivot).right != nil) {
+            node(node(pivot).right).set_parent(index);
+        }
+
+        transplant(index, pivot);
+        node(pivot).right = index;
+        node(index).set_parent(pivot);
+    }
+
+    bool is_red(index_type index) const {
+        return index != nil && node(index).red();
+    }
+
+    void rebalance_after_insert(index_type, const bst_balance::none_tag&) {}
+
+    void rebalance_after_insert(index_type index, const bst_balance::red_black_tag&) {
+        node(index).set_red(true);
+
+        while (is_red(node(index).parent())) {
+            index_type parent = node(index).parent();
+            index_type grandparent = node(parent).parent();
+
+            if (parent == node(grandparent).left) {
+                index_type uncle = node(grandparent).right;
+                if (is_red(uncle)) {
+                    node(parent).set_red(false);
+                    node(uncle).set_red(false);
+                    node(grandparent).set_red(true);
+                    index = grandparent;
+                    continue;
+                }
+                if (index == node(parent).right) {
+                    rotate_left(parent);
+                    index = parent;
+                    parent = node(index).parent();
+                }
+                node(parent).set_red(false);
+                node(grandparent).set_red(true);
+                rotate_right(grandparent);
+            } else {
+                index_type uncle = node(grandparent).left;
+                if (is_red(uncle)) {
+                    node(parent).set_red(false);
+                    node(uncle).set_red(false);
+                    node(grandparent).set_red(true);
+                    index = grandparent;
+                    continue;
+                }
+                if (index == node(parent).left) {
+                    rotate_right(parent);
+                    index = parent;
+                    parent = node(index).parent();
+                }
+                node(parent).set_red(false);
+                node(grandparent).set_red(true);
+                rotate_left(grandparent);
+            }
+        }
+
+        node(header_.root).set_red(false);
+    }
+
+    void rebalance_after_erase(index_type, index_type, const bst_balance::none_tag&) {}
+
+    // child took the place of a black node under parent (child may be nil).
+    void rebalance_after_erase(index_type child, index_type parent, const bst_balance::red_black_tag&) {
+        while (child != header_.root && !is_red(child)) {
+            if (child == node(parent).left) {
+                index_type sibling = node(parent).right;
+                if (is_red(sibling)) {
+                    node(sibling).set_red(false);
+                    node(parent).set_red(true);
+                    rotate_left(parent);
+                    sibling = node(parent).right;
+                }
+                if (!is_red(node(sibling).left) && !is_red(node(sibling).right)) {
+                    node(sibling).set_red(true);
+                    child = parent;
+                    parent = node(child).parent();
+                    continue;
+                }
+                if (!is_red(node(sibling).right)) {
+                    node(node(sibling).left).set_red(false);
+                    node(sibling).set_red(true);
+                    rotate_right(sibling);
+                    sibling = node(parent).right;
+                }
+                node(sibling).set_red(node(parent).red());
+                node(parent).set_red(false);
+                node(node(sibling).right).set_red(false);
+                rotate_left(parent);
+                child = header_.root;
+            } else {
+                index_type sibling = node(parent).left;
+                if (is_red(sibling)) {
+                    node(sibling).set_red(false);
+                    node(parent).set_red(true);
+                    rotate_right(parent);
+                    sibling = node(parent).left;
+                }
+                if (!is_red(node(sibling).left) && !is_red(node(sibling).right)) {
+                    node(sibling).set_red(true);
+                    child = parent;
+                    parent = node(child).parent();
+                    continue;
+                }
+                if (!is_red(node(sibling).left)) {
+                    node(node(sibling).right).set_red(false);
+                    node(sibling).set_red(true);
+                    rotate_left(sibling);
+                    sibling = node(parent).left;
+                }
+                node(sibling).set_red(node(parent).red());
+                node(parent).set_red(false);
+                node(node(sibling).left).set_red(false);
+                rotate_right(parent);
+                child = header_.root;
+            }
+        }
+
+        if (child != nil) {
+            node(child).set_red(false);
+        }
+    }
+};
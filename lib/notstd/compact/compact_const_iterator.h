@@ -0,0 +1,227 @@
+#pragma once
+
+#include "compact_header.h"
+#include "compact_node.h"
+#include "lib/notstd/bst/bst_order.h"
+
+#include <cstddef>
+#include <iterator>
+
+// The index-linked counterpart of bst_const_iterator, with the same three traversal orders.
+template<class Node, class Order>
+class compact_const_iterator {
+  public:
+    using difference_type = ptrdiff_t;
+    using size_type = size_t;
+    using value_type = typename Node::value_type;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using header_type = compact_header<Node>;
+    using index_type = typename Node::index_type;
+
+  private:
+    static constexpr index_type nil = Node::nil;
+
+    index_type index_;
+    const header_type* header_;
+
+  public:
+    explicit compact_const_iterator(index_type index, const header_type* header) : index_(index), header_(header) {}
+
+    bool operator==(const compact_const_iterator& other) const {
+        return index_ == other.index_;
+    }
+
+    bool operator!=(const compact_const_iterator& other) const {
+        return !(*this == other);
+    }
+
+    reference operator*() const {
+        return node(index_).key;
+    }
+
+    pointer operator->() const {
+        return &node(index_).key;
+    }
+
+    // The slot the iterator stands on, Node::nil for end().
+    index_type index() const {
+        return index_;
+    }
+
+    compact_const_iterator& operator++() {
+        increment(Order());
+
+        return *this;
+    }
+
+    compact_const_iterator operator++(int) {
+        compact_const_iterator result = *this;
+        ++*this;
+
+        return result;
+    }
+
+    compact_const_iterator& operator--() {
+        decrement(Order());
+
+        return *this;
+    }
+
+    compact_const_iterator operator--(int) {
+        compact_const_iterator result = *this;
+        --*this;
+
+        return result;
+    }
+
+  private:
+    const Node& node(index_type index) const {
+        return header_->nodes[index];
+    }
+
+    index_type parent(index_type index) const {
+        return node(index).parent();
+    }
+
+    index_type left(index_type index) const {
+        return node(index).left;
+    }
+
+    index_type right(index_type index) const {
+        return node(index).right;
+    }
+
+    index_type leftmost(index_type index) const {
+        while (left(index) != nil) {
+            index = left(index);
+        }
+
+        return index;
+    }
+
+    index_type rightmost(index_type index) const {
+        while (right(index) != nil) {
+            index = right(index);
+        }
+
+        return index;
+    }
+
+    index_type first_leaf(index_type index) const {
+        while (left(index) != nil || right(index) != nil) {
+            index = (left(index) != nil) ? left(index) : right(index);
+        }
+
+        return index;
+    }
+
+    index_type last_leaf(index_type index) const {
+        while (left(index) != nil || right(index) != nil) {
+            index = (right(index) != nil) ? right(index) : left(index);
+        }
+
+        return index;
+    }
+
+    void increment(const bst_order::in_order_tag&) {
+        if (index_ == nil) {
+            index_ = header_->leftmost;
+            return;
+        }
+
+        if (right(index_) != nil) {
+            index_ = leftmost(right(index_));
+        } else {
+            while (parent(index_) != nil && right(parent(index_)) == index_) {
+                index_ = parent(index_);
+            }
+            index_ = parent(index_);
+        }
+    }
+
+    void increment(const bst_order::pre_order_tag&) {
+        if (index_ == nil) {
+            index_ = header_->root;
+            return;
+        }
+
+        if (left(index_) != nil) {
+            index_ = left(index_);
+        } else if (right(index_) != nil) {
+            index_ = right(index_);
+        } else {
+            while (parent(index_) != nil && (right(parent(index_)) == nil || right(parent(index_)) == index_)) {
+                index_ = parent(index_);
+            }
+            index_ = (parent(index_) != nil) ? right(parent(index_)) : nil;
+        }
+    }
+
+    void increment(const bst_order::post_order_tag&) {
+        if (index_ == nil) {
+            index_ = (header_->root != nil) ? first_leaf(header_->root) : nil;
+            return;
+        }
+
+        index_type up = parent(index_);
+        if (up == nil) {
+            index_ = nil;
+        } else if (right(up) == index_ || right(up) == nil) {
+            index_ = up;
+        } else {
+            index_ = first_leaf(right(up));
+        }
+    }
+
+    void decrement(const bst_order::in_order_tag&) {
+        if (index_ == nil) {
+            index_ = header_->rightmost;
+            return;
+        }
+
+        if (left(index_) != nil) {
+            index_ = rightmost(left(index_));
+        } else {
+            while (parent(index_) != nil && left(parent(index_)) == index_) {
+                index_ = parent(index_);
+            }
+            index_ = parent(index_);
+        }
+    }
+
+    void decrement(const bst_order::pre_order_tag&) {
+        if (index_ == nil) {
+            index_ = (header_->root != nil) ? last_leaf(header_->root) : nil;
+            return;
+        }
+
+        index_type up = parent(index_);
+        if (up == nil) {
+            index_ = nil;
+        } else if (left(up) == index_ || left(up) == nil) {
+            index_ = up;
+        } else {
+            index_ = last_leaf(left(up));
+        }
+    }
+
+    void decrement(const bst_order::post_order_tag&) {
+        if (index_ == nil) {
+            index_ = header_->root;
+            return;
+        }
+
+        if (right(index_) != nil) {
+            index_ = right(index_);
+        } else if (left(index_) != nil) {
+            index_ = left(index_);
+        } else {
+            while (parent(index_) != nil && (left(parent(index_)) == nil || left(parent(index_)) == index_)) {
+                index_ = parent(index_);
+            }
+            index_ = (parent(index_) != nil) ? left(parent(index_)) : nil;
+        }
+    }
+};
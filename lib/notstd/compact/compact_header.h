@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+// Per-tree bookkeeping shared with iterators. Iterators hold indices and reach the array through here, so they
+// stay valid when the array is reallocated; references to keys do not.
+template<class Node>
+struct compact_header {
+    using index_type = typename Node::index_type;
+
+    Node* nodes = nullptr;
+    index_type root = Node::nil;
+    index_type leftmost = Node::nil;
+    index_type rightmost = Node::nil;
+    size_t size = 0;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+// A slot of compact_bst's node array. Links are 32-bit indices into the array and the red-black colour lives in
+// the top bit of the parent link, so for a 4-byte key the whole node takes 16 bytes. The key sits in a union:
+// the tree constructs and destroys it, while the slot itself outlives it and is reused through a free list.
+template<class Tp>
+struct compact_node {
+    using value_type = Tp;
+    using index_type = uint32_t;
+
+    static constexpr index_type nil = 0x7fffffff;
+    // Stands in for the parent link of a slot on the free list.
+    static constexpr index_type vacant = 0x7ffffffe;
+    static constexpr index_type max_size = 0x7ffffffe;
+
+    union {
+        value_type key;
+    };
+    index_type parent_link = nil;
+    index_type left = nil;
+    index_type right = nil;
+
+    compact_node() {}
+
+    compact_node(const compact_node&) = delete;
+
+    compact_node& operator=(const compact_node&) = delete;
+
+    ~compact_node() {}
+
+    index_type parent() const {
+        return parent_link & index_mask;
+    }
+
+    void set_parent(index_type parent) {
+        parent_link = (parent_link & red_bit) | parent;
+    }
+
+    bool red() const {
+        return (parent_link & red_bit) != 0;
+    }
+
+    void set_red(bool red) {
+        parent_link = red ? (parent_link | red_bit) : (parent_link & index_mask);
+    }
+
+  private:
+    static constexpr index_type red_bit = 0x80000000;
+    static constexpr index_type index_mask = 0x7fffffff;
+};
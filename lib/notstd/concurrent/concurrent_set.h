@@ -0,0 +1,435 @@
+#pragma once
+
+#include "epoch_domain.h"
+#include "lib/notstd/bst/bst.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace notstd {
+
+// A set that readers search and iterate without locks while a writer updates it. Nodes never change once
+// published: a write copies the path from the root down to its change, rebalances the copy as an AVL tree and
+// publishes it with one atomic store of the root, then retires the nodes it replaced to an epoch_domain. A
+// reader pins the domain, loads the root and sees one consistent version for as long as it keeps the pin.
+// Writers take a mutex among themselves; readers never wait for them.
+template<class Tp, class Compare = std::less<Tp>, class Allocator = std::allocator<Tp>>
+class concurrent_set {
+  private:
+    struct node : epoch_domain::retired {
+        Tp key;
+        const node* left;
+        const node* right;
+        int height;
+    };
+
+    // An AVL tree of n nodes is under 1.45 log2(n + 2) high, so no path from the root is longer than this.
+    static constexpr size_t max_height = 2 * std::numeric_limits<size_t>::digits;
+
+    using alloc_traits = typename std::allocator_traits<Allocator>::template rebind_traits<node>;
+    using node_allocator_type = typename alloc_traits::allocator_type;
+
+  public:
+    using key_type = Tp;
+    using value_type = Tp;
+    using key_compare = Compare;
+    using value_compare = Compare;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+
+    // Walks one version in key order, holding the path to its position.
+    class const_iterator {
+      public:
+        using difference_type = ptrdiff_t;
+        using value_type = Tp;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+        using iterator_category = std::forward_iterator_tag;
+
+      private:
+        // Ancestors still to visit, the current node on top at path_[depth_ - 1].
+        const node* path_[max_height];
+        size_t depth_ = 0;
+
+        friend class concurrent_set;
+
+        void push(const node* ancestor) {
+            path_[depth_++] = ancestor;
+        }
+
+        void descend_left(const node* from) {
+            for (; from != nullptr; from = from->left) {
+                push(from);
+            }
+        }
+
+        const node* top() const {
+            return (depth_ != 0) ? path_[depth_ - 1] : nullptr;
+        }
+
+      public:
+        const_iterator() = default;
+
+        // Copies only the live part of the path.
+        const_iterator(const const_iterator& other) : depth_(other.depth_) {
+            std::copy(other.path_, other.path_ + depth_, path_);
+        }
+
+        const_iterator& operator=(const const_iterator& other) {
+            depth_ = other.depth_;
+            std::copy(other.path_, other.path_ + depth_, path_);
+
+            return *this;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return top() == other.top();
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+        reference operator*() const {
+            return top()->key;
+        }
+
+        pointer operator->() const {
+            return &top()->key;
+        }
+
+        const_iterator& operator++() {
+            const node* current = path_[--depth_];
+            descend_left(current->right);
+
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator result = *this;
+            ++*this;
+
+            return result;
+        }
+    };
+
+    // One version of the set, kept alive by an epoch pin until the snapshot is destroyed. Hold it briefly:
+    // while it lives, nothing retired since it was taken can be freed.
+    class snapshot {
+      private:
+        epoch_domain::guard guard_;
+        const node* root_;
+        const concurrent_set* set_;
+
+        friend class concurrent_set;
+
+        snapshot(epoch_domain::guard guard, const node* root, const concurrent_set* set)
+                : guard_(std::move(guard)), root_(root), set_(set) {}
+
+      public:
+        const_iterator begin() const {
+            const_iterator iter;
+            iter.descend_left(root_);
+
+            return iter;
+        }
+
+        const_iterator end() const {
+            return const_iterator();
+        }
+
+        [[nodiscard]] bool empty() const {
+            return root_ == nullptr;
+        }
+
+        bool contains(const value_type& value) const {
+            return set_->find_node(root_, value) != nullptr;
+        }
+
+        // The key equal to value in this version, end() if there is none.
+        const_iterator find(const value_type& value) const {
+            const_iterator iter;
+            for (const node* current = root_; current != nullptr;) {
+                if (set_->compare_(value, current->key)) {
+                    iter.push(current);
+                    current = current->left;
+                } else if (set_->compare_(current->key, value)) {
+                    current = current->right;
+                } else {
+                    iter.push(current);
+                    return iter;
+                }
+            }
+
+            return end();
+        }
+    };
+
+  private:
+    node_allocator_type allocator_;
+    value_compare compare_;
+
+    std::atomic<const node*> root_ = nullptr;
+    std::atomic<size_type> size_ = 0;
+    std::mutex writer_;
+
+    // Declared last so that it is destroyed first, freeing retired nodes while the allocator is still alive.
+    mutable epoch_domain domain_{&concurrent_set::retired_free, this};
+
+    // What one write allocated and what it replaced: the former is freed if the write throws, the latter
+    // retired once the new version is published. A write visits at most max_height levels and at each one
+    // replaces the node there and rebuilds at most three, two of them for a rotation.
+    struct path_copy {
+        const node* created[3 * max_height];
+        const node* replaced[3 * max_height];
+        size_t created_size = 0;
+        size_t replaced_size = 0;
+
+        void replace(const node* current) {
+            replaced[replaced_size++] = current;
+        }
+    };
+
+  public:
+    explicit concurrent_set() = default;
+
+    explicit concurrent_set(const value_compare& compare) : compare_(compare) {}
+
+    explicit concurrent_set(const allocator_type& alloc) : allocator_(alloc) {}
+
+    concurrent_set(const concurrent_set&) = delete;
+
+    concurrent_set& operator=(const concurrent_set&) = delete;
+
+    // No thread may still be using the set.
+    ~concurrent_set() {
+        destroy_subtree(root_.load(std::memory_order_relaxed));
+    }
+
+    allocator_type get_allocator() const {
+        return allocator_type(allocator_);
+    }
+
+    size_type size() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size() == 0;
+    }
+
+    bool contains(const value_type& value) const {
+        epoch_domain::guard guard = domain_.pin();
+
+        return find_node(root_.load(std::memory_order_acquire), value) != nullptr;
+    }
+
+    // A consistent version to iterate or search several times.
+    snapshot read() const {
+        epoch_domain::guard guard = domain_.pin();
+        const node* root = root_.load(std::memory_order_acquire);
+
+        return snapshot(std::move(guard), root, this);
+    }
+
+    bool insert(const value_type& value) {
+        return write(1, [&](const node* root, path_copy& copy, bool& changed) {
+            return insert_into(root, value, copy, changed);
+        });
+    }
+
+    size_type erase(const value_type& value) {
+        return write(-1, [&](const node* root, path_copy& copy, bool& changed) {
+            return erase_from(root, value, copy, changed);
+        }) ? 1 : 0;
+    }
+
+  private:
+    template<class Key>
+    const node* find_node(const node* current, const Key& key) const {
+        while (current != nullptr) {
+            if (compare_(key, current->key)) {
+                current = current->left;
+            } else if (compare_(current->key, key)) {
+                current = current->right;
+            } else {
+                return current;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Publishes update's new version of the tree if it changed anything, growing the size by delta.
+    template<class Update>
+    bool write(ptrdiff_t delta, Update update) {
+        std::lock_guard<std::mutex> lock(writer_);
+        epoch_domain::guard guard = domain_.pin();
+
+        path_copy copy;
+        bool changed = false;
+        const node* root = root_.load(std::memory_order_relaxed);
+        const node* new_root;
+        try {
+            new_root = update(root, copy, changed);
+        } catch (...) {
+            for (size_t i = 0; i < copy.created_size; ++i) {
+                free_node(const_cast<node*>(copy.created[i]));
+            }
+            throw;
+        }
+        if (!changed) {
+            return false;
+        }
+
+        root_.store(new_root, std::memory_order_seq_cst);
+        size_.store(size() + delta, std::memory_order_relaxed);
+        for (size_t i = 0; i < copy.replaced_size; ++i) {
+            guard.retire(const_cast<node*>(copy.replaced[i]));
+        }
+
+        return true;
+    }
+
+    static int height(const node* current) {
+        return current != nullptr ? current->height : 0;
+    }
+
+    const node* make_node(const value_type& key, const node* left, const node* right, path_copy& copy) {
+        node* created = alloc_traits::allocate(allocator_, 1);
+        try {
+            alloc_traits::construct(allocator_, created,
+                                    node{{}, key, left, right, 1 + std::max(height(left), height(right))});
+        } catch (...) {
+            alloc_traits::deallocate(allocator_, created, 1);
+            throw;
+        }
+        copy.created[copy.created_size++] = created;
+
+        return created;
+    }
+
+    // A copy of a node holding key over left and right, rotated back into AVL shape if their heights differ
+    // by two. Every node a rotation takes apart is replaced too.
+    const node* balance(const value_type& key, const node* left, const node* right, path_copy& copy) {
+        if (height(left) > height(right) + 1) {
+            copy.replace(left);
+            if (height(left->left) >= height(left->right)) {
+                return make_node(left->key, left->left, make_node(key, left->right, right, copy), copy);
+            }
+            const node* pivot = left->right;
+            copy.replace(pivot);
+            return make_node(pivot->key, make_node(left->key, left->left, pivot->left, copy),
+                             make_node(key, pivot->right, right, copy), copy);
+        }
+        if (height(right) > height(left) + 1) {
+            copy.replace(right);
+            if (height(right->right) >= height(right->left)) {
+                return make_node(right->key, make_node(key, left, right->left, copy), right->right, copy);
+            }
+            const node* pivot = right->left;
+            copy.replace(pivot);
+            return make_node(pivot->key, make_node(key, left, pivot->left, copy),
+                             make_node(right->key, pivot->right, right->right, copy), copy);
+        }
+
+        return make_node(key, left, right, copy);
+    }
+
+    const node* insert_into(const node* current, const value_type& value, path_copy& copy, bool& changed) {
+        if (current == nullptr) {
+            changed = true;
+            return make_node(value, nullptr, nullptr, copy);
+        }
+
+        if (compare_(value, current->key)) {
+            const node* left = insert_into(current->left, value, copy, changed);
+            if (!changed) {
+                return current;
+            }
+            copy.replace(current);
+            return balance(current->key, left, current->right, copy);
+        }
+        if (compare_(current->key, value)) {
+            const node* right = insert_into(current->right, value, copy, changed);
+            if (!changed) {
+                return current;
+            }
+            copy.replace(current);
+            return balance(current->key, current->left, right, copy);
+        }
+
+        return current;
+    }
+
+    const node* erase_from(const node* current, const value_type& value, path_copy& copy, bool& changed) {
+        if (current == nullptr) {
+            return nullptr;
+        }
+
+        if (compare_(value, current->key)) {
+            const node* left = erase_from(current->left, value, copy, changed);
+            if (!changed) {
+                return current;
+            }
+            copy.replace(current);
+            return balance(current->key, left, current->right, copy);
+        }
+        if (compare_(current->key, value)) {
+            const node* right = erase_from(current->right, value, copy, changed);
+            if (!changed) {
+                return current;
+            }
+            copy.replace(current);
+            return balance(current->key, current->left, right, copy);
+        }
+
+        changed = true;
+        copy.replace(current);
+        if (current->left == nullptr || current->right == nullptr) {
+            return (current->left != nullptr) ? current->left : current->right;
+        }
+
+        // The successor takes the erased key's place.
+        const node* successor = nullptr;
+        const node* right = erase_min(current->right, successor, copy);
+        return balance(successor->key, current->left, right, copy);
+    }
+
+    const node* erase_min(const node* current, const node*& min, path_copy& copy) {
+        copy.replace(current);
+        if (current->left == nullptr) {
+            min = current;
+            return current->right;
+        }
+
+        const node* left = erase_min(current->left, min, copy);
+        return balance(current->key, left, current->right, copy);
+    }
+
+    void free_node(node* current) {
+        alloc_traits::destroy(allocator_, current);
+        alloc_traits::deallocate(allocator_, current, 1);
+    }
+
+    static void retired_free(void* context, epoch_domain::retired* current) {
+        static_cast<concurrent_set*>(context)->free_node(static_cast<node*>(current));
+    }
+
+    void destroy_subtree(const node* current) {
+        while (current != nullptr) {
+            destroy_subtree(current->left);
+            const node* right = current->right;
+            free_node(const_cast<node*>(current));
+            current = right;
+        }
+    }
+};
+
+} // notstd
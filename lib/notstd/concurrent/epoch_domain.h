@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace notstd {
+
+// Epoch-based reclamation for lock-free structures. A thread pins the domain while it reads shared nodes, and
+// whoever unlinks a node retires it instead of freeing it. The global epoch only moves on once every pinned
+// thread has seen the current one, so a node retired in epoch e is unreachable to all readers by epoch e + 2
+// and is freed then. Pinning claims one of a fixed number of slots, each on its own cache line; readers never
+// write to shared state besides their own slot.
+class epoch_domain {
+  public:
+    // The hook a node derives from to be retired. The domain links it into a limbo list, so retiring never
+    // allocates; readers may go on reading the rest of the node meanwhile.
+    struct retired {
+        retired* next;
+        uint64_t epoch;
+    };
+
+  private:
+    // epoch is 0 while the slot is free, otherwise the epoch its holder pinned. The limbo list, oldest first,
+    // belongs to whoever holds the slot and outlives them; the next holder goes on draining it.
+    struct alignas(64) slot {
+        std::atomic<uint64_t> epoch = 0;
+        retired* limbo_head = nullptr;
+        retired* limbo_tail = nullptr;
+        size_t limbo_size = 0;
+    };
+
+    // Retired nodes a slot collects before its holder tries to move the epoch on and free some.
+    static constexpr size_t reclaim_batch = 64;
+
+    std::atomic<uint64_t> epoch_ = 1;
+    std::unique_ptr<slot[]> slots_;
+    size_t slot_count_;
+    void (*free_)(void* context, retired* node);
+    void* context_;
+
+  public:
+    // Keeps the domain pinned, and the nodes it can reach alive, until destroyed.
+    class guard {
+      private:
+        epoch_domain* domain_;
+        slot* slot_;
+
+        friend class epoch_domain;
+
+        guard(epoch_domain* domain, slot* slot) : domain_(domain), slot_(slot) {}
+
+      public:
+        guard(guard&& other) noexcept : domain_(other.domain_), slot_(std::exchange(other.slot_, nullptr)) {}
+
+        guard& operator=(guard&& other) noexcept {
+            if (this != &other) {
+                release();
+                domain_ = other.domain_;
+                slot_ = std::exchange(other.slot_, nullptr);
+            }
+
+            return *this;
+        }
+
+        ~guard() {
+            release();
+        }
+
+        // Hands node, already unreachable from the structure, to the domain's free once no reader can hold it.
+        // A node is retired at most once.
+        void retire(retired* node) {
+            node->next = nullptr;
+            node->epoch = domain_->epoch_.load(std::memory_order_seq_cst);
+            if (slot_->limbo_tail != nullptr) {
+                slot_->limbo_tail->next = node;
+            } else {
+                slot_->limbo_head = node;
+            }
+            slot_->limbo_tail = node;
+            ++slot_->limbo_size;
+        }
+
+        // Ends the critical section early.
+        void release() {
+            if (slot_ != nullptr) {
+                domain_->unpin(*slot_);
+                slot_ = nullptr;
+            }
+        }
+    };
+
+    // Retired nodes go to free(context, node). slots bounds the pins held at once, a thread holding one per live
+    // guard; more wait for a slot to free up.
+    explicit epoch_domain(void (*free)(void* context, retired* node), void* context,
+                          size_t slots = std::max(128u, 4 * std::thread::hardware_concurrency()))
+            : slots_(std::make_unique<slot[]>(slots)), slot_count_(slots), free_(free), context_(context) {}
+
+    epoch_domain(const epoch_domain&) = delete;
+
+    epoch_domain& operator=(const epoch_domain&) = delete;
+
+    // Frees everything still retired; no thread may be pinned.
+    ~epoch_domain() {
+        for (size_t i = 0; i < slot_count_; ++i) {
+            while (slots_[i].limbo_head != nullptr) {
+                retired* node = std::exchange(slots_[i].limbo_head, slots_[i].limbo_head->next);
+                free_(context_, node);
+            }
+        }
+    }
+
+    guard pin() {
+        // Thread ids hash to addresses, alike in their low bits; the multiply spreads threads over the slots.
+        size_t start = (std::hash<std::thread::id>()(std::this_thread::get_id()) * 0x9e3779b97f4a7c15ull) >> 32;
+
+        for (size_t attempt = 0;; ++attempt) {
+            slot& candidate = slots_[(start + attempt) % slot_count_];
+            uint64_t free = 0;
+            // The seq_cst claim is ordered before every later read of shared nodes, which is what a reclaiming
+            // thread relies on when it finds the slot pinned at an older epoch.
+            if (candidate.epoch.load(std::memory_order_relaxed) == 0 &&
+                candidate.epoch.compare_exchange_strong(free, epoch_.load(std::memory_order_seq_cst),
+                                                        std::memory_order_seq_cst)) {
+                return guard(this, &candidate);
+            }
+            if (attempt % slot_count_ == slot_count_ - 1) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+  private:
+    void unpin(slot& held) {
+        if (held.limbo_size >= reclaim_batch) {
+            reclaim(held);
+        }
+        held.epoch.store(0, std::memory_order_release);
+    }
+
+    // Runs just before unpinning, when the holder no longer touches shared nodes, so its own slot need not
+    // hold the epoch back.
+    void reclaim(slot& held) {
+        uint64_t current = epoch_.load(std::memory_order_seq_cst);
+        bool quiescent = true;
+        for (size_t i = 0; i < slot_count_ && quiescent; ++i) {
+            uint64_t pinned = slots_[i].epoch.load(std::memory_order_seq_cst);
+            quiescent = &slots_[i] == &held || pinned == 0 || pinned == current;
+        }
+        if (quiescent && epoch_.compare_exchange_strong(current, current + 1, std::memory_order_seq_cst)) {
+            ++current;
+        }
+
+        // The global epoch never goes back, so the limbo list is sorted by epoch and what is free to go is a
+        // prefix of it; a reader stalled in an old epoch costs nothing here but memory.
+        while (held.limbo_head != nullptr && held.limbo_head->epoch + 2 <= current) {
+            retired* node = std::exchange(held.limbo_head, held.limbo_head->next);
+            --held.limbo_size;
+            free_(context_, node);
+        }
+        if (held.limbo_head == nullptr) {
+            held.limbo_tail = nullptr;
+        }
+    }
+};
+
+} // notstd
@@ -0,0 +1,352 @@
+#pragma once
+
+#include "epoch_domain.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace notstd {
+
+// A set any number of threads insert into, erase from and search at once, none of them ever blocking another:
+// the external binary search tree of Natarajan and Mittal. Keys live in the leaves and internal nodes only
+// route. An insert swings one edge to a new router over the old leaf and the new one. An erase marks the edge
+// to its leaf, then splices the leaf and its parent out with one more compare-and-swap higher up; a thread that
+// runs into a marked edge finishes the splice for whoever started it. Spliced nodes go to an epoch_domain.
+// The tree is not balanced, so keys should arrive in no particular order.
+template<class Tp, class Compare = std::less<Tp>, class Allocator = std::allocator<Tp>>
+class lockfree_set {
+  private:
+    // Which of the three sentinel keys, above every real key and ordered by rank, a node stands for.
+    struct sentinel {
+        int rank;
+    };
+
+    struct node : epoch_domain::retired {
+        // Edges carry two marks in the low bits of the child's address; see flag_bit and tag_bit.
+        std::atomic<uintptr_t> left = 0;
+        std::atomic<uintptr_t> right = 0;
+        // 0 for a node holding a key, otherwise the rank of its sentinel.
+        int infinity;
+
+        union {
+            Tp key;
+        };
+
+        explicit node(sentinel key) : infinity(key.rank) {}
+
+        explicit node(const Tp& key) : infinity(0), key(key) {}
+
+        ~node() {
+            if (infinity == 0) {
+                key.~Tp();
+            }
+        }
+    };
+
+    using alloc_traits = typename std::allocator_traits<Allocator>::template rebind_traits<node>;
+    using node_allocator_type = typename alloc_traits::allocator_type;
+
+    // The edge leads to a leaf being erased. It never changes again.
+    static constexpr uintptr_t flag_bit = 1;
+    // The edge belongs to a router being spliced out. It never changes again.
+    static constexpr uintptr_t tag_bit = 2;
+
+    static_assert(alignof(node) > (flag_bit | tag_bit));
+
+    // Where a search for a key ended: the leaf, its parent, and the last edge on the way down, from
+    // ancestor to successor, not tagged. Erasing the leaf splices everything from successor to parent out.
+    struct seek_record {
+        node* ancestor;
+        node* successor;
+        node* parent;
+        node* leaf;
+    };
+
+  public:
+    using key_type = Tp;
+    using value_type = Tp;
+    using key_compare = Compare;
+    using value_compare = Compare;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+
+  private:
+    node_allocator_type allocator_;
+    value_compare compare_;
+
+    // The sentinel router holding the largest sentinel key. Its left child is a router that never goes away
+    // either, and every real key sits in that one's left subtree.
+    node* root_ = nullptr;
+    std::atomic<size_type> size_ = 0;
+
+    // Declared last so that it is destroyed first, freeing retired nodes while the allocator is still alive.
+    mutable epoch_domain domain_{&lockfree_set::retired_free, this};
+
+  public:
+    explicit lockfree_set() {
+        make_sentinels();
+    }
+
+    explicit lockfree_set(const value_compare& compare) : compare_(compare) {
+        make_sentinels();
+    }
+
+    explicit lockfree_set(const allocator_type& alloc) : allocator_(alloc) {
+        make_sentinels();
+    }
+
+    lockfree_set(const lockfree_set&) = delete;
+
+    lockfree_set& operator=(const lockfree_set&) = delete;
+
+    // No thread may still be using the set.
+    ~lockfree_set() {
+        destroy_tree(root_);
+    }
+
+    allocator_type get_allocator() const {
+        return allocator_type(allocator_);
+    }
+
+    // Exact once writers are done; while they run, some recent count.
+    size_type size() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size() == 0;
+    }
+
+    bool contains(const value_type& value) const {
+        epoch_domain::guard guard = domain_.pin();
+
+        node* current = root_;
+        for (node* next; (next = address(child(current, value).load(std::memory_order_acquire))) != nullptr;) {
+            current = next;
+        }
+
+        return holds(current, value);
+    }
+
+    bool insert(const value_type& value) {
+        epoch_domain::guard guard = domain_.pin();
+        node* leaf = nullptr;
+
+        while (true) {
+            seek_record record = seek(value);
+            if (holds(record.leaf, value)) {
+                if (leaf != nullptr) {
+                    free_node(leaf);
+                }
+                return false;
+            }
+
+            if (leaf == nullptr) {
+                leaf = make_node(value);
+            }
+            node* router;
+            try {
+                router = below(value, record.leaf) ? make_router(record.leaf) : make_node(value);
+            } catch (...) {
+                free_node(leaf);
+                throw;
+            }
+            bool left = below(value, record.leaf);
+            router->left.store(edge_to(left ? leaf : record.leaf), std::memory_order_relaxed);
+            router->right.store(edge_to(left ? record.leaf : leaf), std::memory_order_relaxed);
+
+            std::atomic<uintptr_t>& edge = child(record.parent, value);
+            uintptr_t expected = edge_to(record.leaf);
+            if (edge.compare_exchange_strong(expected, edge_to(router), std::memory_order_seq_cst)) {
+                size_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            free_node(router);
+            // An erase holds the edge; help it out of the way before trying again.
+            if (address(expected) == record.leaf && (expected & (flag_bit | tag_bit)) != 0) {
+                cleanup(value, record, guard);
+            }
+        }
+    }
+
+    size_type erase(const value_type& value) {
+        epoch_domain::guard guard = domain_.pin();
+        // The leaf once this erase has flagged it, from when on the key counts as gone.
+        node* target = nullptr;
+
+        while (true) {
+            seek_record record = seek(value);
+
+            if (target == nullptr) {
+                if (!holds(record.leaf, value)) {
+                    return 0;
+                }
+                std::atomic<uintptr_t>& edge = child(record.parent, value);
+                uintptr_t expected = edge_to(record.leaf);
+                if (edge.compare_exchange_strong(expected, expected | flag_bit, std::memory_order_seq_cst)) {
+                    target = record.leaf;
+                    size_.fetch_sub(1, std::memory_order_relaxed);
+                    if (cleanup(value, record, guard)) {
+                        return 1;
+                    }
+                } else if (address(expected) == record.leaf && (expected & (flag_bit | tag_bit)) != 0) {
+                    cleanup(value, record, guard);
+                }
+            } else if (record.leaf != target || cleanup(value, record, guard)) {
+                // Gone from the tree, by this thread's splice or another's.
+                return 1;
+            }
+        }
+    }
+
+  private:
+    static node* address(uintptr_t edge) {
+        return reinterpret_cast<node*>(edge & ~(flag_bit | tag_bit));
+    }
+
+    static uintptr_t edge_to(const node* target) {
+        return reinterpret_cast<uintptr_t>(target);
+    }
+
+    // Whether value goes left of current.
+    bool below(const value_type& value, const node* current) const {
+        return current->infinity != 0 || compare_(value, current->key);
+    }
+
+    bool holds(const node* leaf, const value_type& value) const {
+        return leaf->infinity == 0 && !compare_(value, leaf->key) && !compare_(leaf->key, value);
+    }
+
+    std::atomic<uintptr_t>& child(node* current, const value_type& value) const {
+        return below(value, current) ? current->left : current->right;
+    }
+
+    seek_record seek(const value_type& value) const {
+        node* inner = address(root_->left.load(std::memory_order_acquire));
+        uintptr_t parent_field = inner->left.load(std::memory_order_acquire);
+        seek_record record{root_, inner, inner, address(parent_field)};
+
+        uintptr_t current_field = child(record.leaf, value).load(std::memory_order_acquire);
+        for (node* current = address(current_field); current != nullptr; current = address(current_field)) {
+            if ((parent_field & tag_bit) == 0) {
+                record.ancestor = record.parent;
+                record.successor = record.leaf;
+            }
+            record.parent = record.leaf;
+            record.leaf = current;
+            parent_field = current_field;
+            current_field = child(current, value).load(std::memory_order_acquire);
+        }
+
+        return record;
+    }
+
+    // Splices out the parent in record and whichever of its children is flagged, moving the other child up to
+    // the ancestor. False if the ancestor's edge changed first and the seek must be redone.
+    bool cleanup(const value_type& value, const seek_record& record, epoch_domain::guard& guard) {
+        std::atomic<uintptr_t>& successor_edge = child(record.ancestor, value);
+        std::atomic<uintptr_t>* child_edge = &child(record.parent, value);
+        std::atomic<uintptr_t>* sibling_edge =
+                (child_edge == &record.parent->left) ? &record.parent->right : &record.parent->left;
+        if ((child_edge->load(std::memory_order_acquire) & flag_bit) == 0) {
+            // The leaf on value's side stays; the sibling is the one being erased.
+            sibling_edge = child_edge;
+        }
+
+        // Tagging freezes the edge, so what it held just before is what moves up.
+        uintptr_t promoted = sibling_edge->fetch_or(tag_bit, std::memory_order_seq_cst) & ~tag_bit;
+        uintptr_t expected = edge_to(record.successor);
+        if (!successor_edge.compare_exchange_strong(expected, promoted, std::memory_order_seq_cst)) {
+            return false;
+        }
+
+        retire_spliced(value, record, address(promoted), guard);
+        return true;
+    }
+
+    // Retires what a successful cleanup cut out: every router from the successor down to the parent, and the
+    // flagged leaf beside each. All their edges are marked, so none of it changes any more.
+    void retire_spliced(const value_type& value, const seek_record& record, const node* promoted,
+                        epoch_domain::guard& guard) {
+        for (node* current = record.successor; current != record.parent;) {
+            std::atomic<uintptr_t>& next = child(current, value);
+            std::atomic<uintptr_t>& erased = (&next == &current->left) ? current->right : current->left;
+            retire(address(erased.load(std::memory_order_acquire)), guard);
+            node* below_current = address(next.load(std::memory_order_acquire));
+            retire(current, guard);
+            current = below_current;
+        }
+
+        node* left = address(record.parent->left.load(std::memory_order_acquire));
+        node* right = address(record.parent->right.load(std::memory_order_acquire));
+        retire((left == promoted) ? right : left, guard);
+        retire(record.parent, guard);
+    }
+
+    void retire(node* current, epoch_domain::guard& guard) {
+        guard.retire(current);
+    }
+
+    template<class... Args>
+    node* make_node(Args&&... args) {
+        node* created = alloc_traits::allocate(allocator_, 1);
+        try {
+            alloc_traits::construct(allocator_, created, std::forward<Args>(args)...);
+        } catch (...) {
+            alloc_traits::deallocate(allocator_, created, 1);
+            throw;
+        }
+
+        return created;
+    }
+
+    // A router holding the same key, real or sentinel, as like.
+    node* make_router(const node* like) {
+        return (like->infinity != 0) ? make_node(sentinel{like->infinity}) : make_node(like->key);
+    }
+
+    void make_sentinels() {
+        root_ = make_node(sentinel{3});
+        try {
+            node* inner = make_node(sentinel{2});
+            root_->left.store(edge_to(inner), std::memory_order_relaxed);
+            root_->right.store(edge_to(make_node(sentinel{3})), std::memory_order_relaxed);
+            inner->left.store(edge_to(make_node(sentinel{1})), std::memory_order_relaxed);
+            inner->right.store(edge_to(make_node(sentinel{2})), std::memory_order_relaxed);
+        } catch (...) {
+            destroy_tree(root_);
+            throw;
+        }
+    }
+
+    void free_node(node* current) {
+        alloc_traits::destroy(allocator_, current);
+        alloc_traits::deallocate(allocator_, current, 1);
+    }
+
+    static void retired_free(void* context, epoch_domain::retired* current) {
+        static_cast<lockfree_set*>(context)->free_node(static_cast<node*>(current));
+    }
+
+    // Rotates each left child up until there is none, so that the tree, however deep, goes without a stack.
+    void destroy_tree(node* current) {
+        while (current != nullptr) {
+            node* left = address(current->left.load(std::memory_order_relaxed));
+            if (left != nullptr) {
+                current->left.store(left->right.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                left->right.store(edge_to(current), std::memory_order_relaxed);
+                current = left;
+            } else {
+                node* right = address(current->right.load(std::memory_order_relaxed));
+                free_node(current);
+                current = right;
+            }
+        }
+    }
+};
+
+} // notstd
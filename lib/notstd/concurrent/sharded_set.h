@@ -0,0 +1,556 @@
+#pragma once
+
+#include "lib/notstd/set.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+
+namespace notstd {
+
+// A set split by key range into shards, each a notstd::set under its own mutex, so that threads working on
+// different ranges update it in parallel. A point operation locks the one shard its key falls in. A shard that
+// grows past shard_capacity keys is split at its median, and one that shrinks below a quarter of it is merged
+// into a neighbour when the two fit in half; both relink nodes in O(log n) under a short exclusive lock on the
+// shard layout, which every other operation holds shared.
+template<class Tp, class Compare = std::less<Tp>, class Allocator = std::allocator<Tp>>
+class sharded_set {
+  public:
+    using key_type = Tp;
+    using value_type = Tp;
+    using key_compare = Compare;
+    using value_compare = Compare;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+
+    static constexpr size_type default_shard_capacity = size_type(1) << 16;
+
+  private:
+    // Sized for nth, which finds the median a split cuts at.
+    using shard_set = set<Tp, bst_order::in_order_tag, Compare, Allocator, bst_balance::red_black_tag,
+                          bst_augment::size_tag>;
+
+    // On its own cache lines, so that threads locking neighbouring shards do not contend for one.
+    struct alignas(64) shard {
+        std::mutex mutex;
+        shard_set keys;
+
+        explicit shard(const value_compare& compare) : keys(compare) {}
+    };
+
+    using key_alloc_traits = std::allocator_traits<Allocator>;
+    using shard_alloc_traits = typename key_alloc_traits::template rebind_traits<shard>;
+    using shard_allocator_type = typename shard_alloc_traits::allocator_type;
+    using pointer_alloc_traits = typename key_alloc_traits::template rebind_traits<shard*>;
+    using pointer_allocator_type = typename pointer_alloc_traits::allocator_type;
+
+    value_compare compare_;
+    size_type shard_capacity_;
+    allocator_type allocator_;
+
+    // Shard i holds the keys from bounds_[i - 1] up to, not including, bounds_[i]; the first and last shards are
+    // open at their outer ends. Both arrays have room for layout_capacity_ entries, one of them spare in bounds_.
+    shard** shards_ = nullptr;
+    value_type* bounds_ = nullptr;
+    size_type shard_count_ = 0;
+    size_type layout_capacity_ = 0;
+    mutable std::shared_mutex layout_;
+
+    std::atomic<size_type> size_ = 0;
+
+  public:
+    // Iterates every shard in key order, crossing from one to the next as if they were one set.
+    class const_iterator {
+      public:
+        using difference_type = ptrdiff_t;
+        using value_type = Tp;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+        using iterator_category = std::bidirectional_iterator_tag;
+
+      private:
+        using inner_iterator = typename shard_set::const_iterator;
+
+        const sharded_set* set_ = nullptr;
+        size_type shard_ = 0;
+        inner_iterator inner_;
+
+        friend class sharded_set;
+
+        // Never left at the end of any shard but the last, so that every position has one representation.
+        const_iterator(const sharded_set* set, size_type shard, inner_iterator inner)
+                : set_(set), shard_(shard), inner_(inner) {
+            skip_ends();
+        }
+
+        const shard_set& keys(size_type index) const {
+            return set_->shards_[index]->keys;
+        }
+
+        void skip_ends() {
+            while (inner_ == keys(shard_).cend() && shard_ + 1 < set_->shard_count_) {
+                ++shard_;
+                inner_ = keys(shard_).cbegin();
+            }
+        }
+
+      public:
+        const_iterator() = default;
+
+        bool operator==(const const_iterator& other) const {
+            return shard_ == other.shard_ && inner_ == other.inner_;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+        reference operator*() const {
+            return *inner_;
+        }
+
+        pointer operator->() const {
+            return &*inner_;
+        }
+
+        const_iterator& operator++() {
+            ++inner_;
+            skip_ends();
+
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator result = *this;
+            ++*this;
+
+            return result;
+        }
+
+        const_iterator& operator--() {
+            while (inner_ == keys(shard_).cbegin()) {
+                --shard_;
+                inner_ = keys(shard_).cend();
+            }
+            --inner_;
+
+            return *this;
+        }
+
+        const_iterator operator--(int) {
+            const_iterator result = *this;
+            --*this;
+
+            return result;
+        }
+    };
+
+    // The whole set locked against writers, every shard at once, to iterate or search consistently. Writers
+    // wait until it is destroyed.
+    class view {
+      private:
+        std::shared_lock<std::shared_mutex> layout_;
+        const sharded_set* set_;
+
+        friend class sharded_set;
+
+        // The shared layout lock keeps the shards in place, so the view unlocks the very ones it locked.
+        explicit view(const sharded_set* set) : layout_(set->layout_), set_(set) {
+            // In shard order, the one order anything takes two shard locks in.
+            size_type locked = 0;
+            try {
+                for (; locked < set->shard_count_; ++locked) {
+                    set->shards_[locked]->mutex.lock();
+                }
+            } catch (...) {
+                while (locked-- > 0) {
+                    set->shards_[locked]->mutex.unlock();
+                }
+                throw;
+            }
+        }
+
+      public:
+        view(view&& other) noexcept : layout_(std::move(other.layout_)), set_(std::exchange(other.set_, nullptr)) {}
+
+        view& operator=(view&&) = delete;
+
+        ~view() {
+            if (set_ != nullptr) {
+                for (size_type index = 0; index < set_->shard_count_; ++index) {
+                    set_->shards_[index]->mutex.unlock();
+                }
+            }
+        }
+
+        const_iterator begin() const {
+            return const_iterator(set_, 0, set_->shards_[0]->keys.cbegin());
+        }
+
+        const_iterator end() const {
+            size_type last = set_->shard_count_ - 1;
+
+            return const_iterator(set_, last, set_->shards_[last]->keys.cend());
+        }
+
+        size_type size() const {
+            return set_->size();
+        }
+
+        [[nodiscard]] bool empty() const {
+            return set_->empty();
+        }
+
+        bool contains(const value_type& value) const {
+            return set_->shards_[set_->shard_of(value)]->keys.contains(value);
+        }
+
+        const_iterator find(const value_type& value) const {
+            size_type index = set_->shard_of(value);
+            const shard_set& keys = set_->shards_[index]->keys;
+            typename shard_set::const_iterator found = keys.find(value);
+
+            return (found != keys.cend()) ? const_iterator(set_, index, found) : end();
+        }
+
+        // Same convention as set: the greatest key not above value, end() if there is none.
+        const_iterator lower_bound(const value_type& value) const {
+            for (size_type index = set_->shard_of(value) + 1; index-- > 0;) {
+                const shard_set& keys = set_->shards_[index]->keys;
+                typename shard_set::const_iterator found = keys.lower_bound(value);
+                if (found != keys.cend()) {
+                    return const_iterator(set_, index, found);
+                }
+            }
+
+            return end();
+        }
+
+        // The least key not below value, end() if there is none.
+        const_iterator upper_bound(const value_type& value) const {
+            size_type index = set_->shard_of(value);
+
+            return const_iterator(set_, index, set_->shards_[index]->keys.upper_bound(value));
+        }
+    };
+
+    explicit sharded_set(size_type shard_capacity = default_shard_capacity,
+                         const value_compare& compare = value_compare())
+            : compare_(compare), shard_capacity_(std::max<size_type>(shard_capacity, 2)) {
+        build<const value_type*>(nullptr, nullptr);
+    }
+
+    // Starts with one shard more than there are bounds in [first, last), split at them. The bounds must be
+    // strictly increasing.
+    template<class InputIter>
+    explicit sharded_set(InputIter first, InputIter last, size_type shard_capacity = default_shard_capacity,
+                         const value_compare& compare = value_compare())
+            : compare_(compare), shard_capacity_(std::max<size_type>(shard_capacity, 2)) {
+        build(first, last);
+    }
+
+    sharded_set(const sharded_set&) = delete;
+
+    sharded_set& operator=(const sharded_set&) = delete;
+
+    // No thread may still be using the set.
+    ~sharded_set() {
+        release();
+    }
+
+    key_compare key_comp() const {
+        return compare_;
+    }
+
+    value_compare value_comp() const {
+        return compare_;
+    }
+
+    // Exact once writers are done; while they run, some recent count.
+    size_type size() const {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size() == 0;
+    }
+
+    size_type shard_count() const {
+        std::shared_lock<std::shared_mutex> layout(layout_);
+
+        return shard_count_;
+    }
+
+    bool insert(const value_type& value) {
+        bool inserted;
+        bool overfull;
+        {
+            std::shared_lock<std::shared_mutex> layout(layout_);
+            shard& target = *shards_[shard_of(value)];
+            std::lock_guard<std::mutex> lock(target.mutex);
+
+            inserted = target.keys.insert(value).second;
+            overfull = target.keys.size() > shard_capacity_;
+        }
+
+        if (inserted) {
+            size_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (overfull) {
+            split_shard(value);
+        }
+
+        return inserted;
+    }
+
+    size_type erase(const value_type& value) {
+        size_type erased;
+        bool underfull;
+        {
+            std::shared_lock<std::shared_mutex> layout(layout_);
+            shard& target = *shards_[shard_of(value)];
+            std::lock_guard<std::mutex> lock(target.mutex);
+
+            erased = target.keys.erase(value);
+            underfull = erased != 0 && shard_count_ > 1 && target.keys.size() < shard_capacity_ / 4;
+        }
+
+        if (erased != 0) {
+            size_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        if (underfull) {
+            merge_shard(value);
+        }
+
+        return erased;
+    }
+
+    bool contains(const value_type& value) const {
+        std::shared_lock<std::shared_mutex> layout(layout_);
+        shard& target = *shards_[shard_of(value)];
+        std::lock_guard<std::mutex> lock(target.mutex);
+
+        return target.keys.contains(value);
+    }
+
+    // A copy of the greatest key not above value, if any. Shards are searched one at a time, each under its own
+    // lock, so a key that writers move across the answer meanwhile may be missed; use read() to rule that out.
+    std::optional<value_type> lower_bound(const value_type& value) const {
+        std::shared_lock<std::shared_mutex> layout(layout_);
+
+        for (size_type index = shard_of(value) + 1; index-- > 0;) {
+            std::lock_guard<std::mutex> lock(shards_[index]->mutex);
+            const shard_set& keys = shards_[index]->keys;
+            if (typename shard_set::const_iterator found = keys.lower_bound(value); found != keys.cend()) {
+                return *found;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    // A copy of the least key not below value, if any; see lower_bound.
+    std::optional<value_type> upper_bound(const value_type& value) const {
+        std::shared_lock<std::shared_mutex> layout(layout_);
+
+        for (size_type index = shard_of(value); index < shard_count_; ++index) {
+            std::lock_guard<std::mutex> lock(shards_[index]->mutex);
+            const shard_set& keys = shards_[index]->keys;
+            if (typename shard_set::const_iterator found = keys.upper_bound(value); found != keys.cend()) {
+                return *found;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    // Calls visit on every key in order, locking one shard at a time: writers to the other shards carry on,
+    // and the keys seen are each shard's as of when the scan reached it.
+    template<class Visitor>
+    void for_each(Visitor visit) const {
+        std::shared_lock<std::shared_mutex> layout(layout_);
+
+        for (size_type index = 0; index < shard_count_; ++index) {
+            std::lock_guard<std::mutex> lock(shards_[index]->mutex);
+            for (const value_type& key : shards_[index]->keys) {
+                visit(key);
+            }
+        }
+    }
+
+    // Every shard locked at once, for iteration or searches that must agree with each other.
+    view read() const {
+        return view(this);
+    }
+
+  private:
+    size_type shard_of(const value_type& value) const {
+        return static_cast<size_type>(std::upper_bound(bounds_, bounds_ + shard_count_ - 1, value, compare_) -
+                                      bounds_);
+    }
+
+    template<class InputIter>
+    void build(InputIter first, InputIter last) {
+        try {
+            reserve_layout(1);
+            shards_[0] = make_shard();
+            shard_count_ = 1;
+            for (; first != last; ++first) {
+                reserve_layout(shard_count_ + 1);
+                key_alloc_traits::construct(allocator_, bounds_ + shard_count_ - 1, *first);
+                try {
+                    shards_[shard_count_] = make_shard();
+                } catch (...) {
+                    key_alloc_traits::destroy(allocator_, bounds_ + shard_count_ - 1);
+                    throw;
+                }
+                ++shard_count_;
+            }
+        } catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    shard* make_shard() {
+        shard_allocator_type allocator(allocator_);
+        shard* created = shard_alloc_traits::allocate(allocator, 1);
+        try {
+            shard_alloc_traits::construct(allocator, created, compare_);
+        } catch (...) {
+            shard_alloc_traits::deallocate(allocator, created, 1);
+            throw;
+        }
+
+        return created;
+    }
+
+    void free_shard(shard* current) {
+        shard_allocator_type allocator(allocator_);
+        shard_alloc_traits::destroy(allocator, current);
+        shard_alloc_traits::deallocate(allocator, current, 1);
+    }
+
+    // Makes room for count shards, moving the bounds and shard pointers to new arrays if need be. The shards
+    // themselves stay where they are.
+    void reserve_layout(size_type count) {
+        if (count <= layout_capacity_) {
+            return;
+        }
+
+        size_type capacity = std::max({count, 2 * layout_capacity_, size_type(4)});
+        pointer_allocator_type pointer_allocator(allocator_);
+        shard** shards = pointer_alloc_traits::allocate(pointer_allocator, capacity);
+        value_type* bounds = nullptr;
+        size_type moved = 0;
+        try {
+            bounds = key_alloc_traits::allocate(allocator_, capacity);
+            for (; moved + 1 < shard_count_; ++moved) {
+                key_alloc_traits::construct(allocator_, bounds + moved, std::move_if_noexcept(bounds_[moved]));
+            }
+        } catch (...) {
+            if (bounds != nullptr) {
+                for (size_type index = 0; index < moved; ++index) {
+                    key_alloc_traits::destroy(allocator_, bounds + index);
+                }
+                key_alloc_traits::deallocate(allocator_, bounds, capacity);
+            }
+            pointer_alloc_traits::deallocate(pointer_allocator, shards, capacity);
+            throw;
+        }
+        std::copy(shards_, shards_ + shard_count_, shards);
+
+        free_layout();
+        shards_ = shards;
+        bounds_ = bounds;
+        layout_capacity_ = capacity;
+    }
+
+    // Destroys the bounds and frees both arrays, but not the shards they point to.
+    void free_layout() {
+        if (layout_capacity_ == 0) {
+            return;
+        }
+        for (size_type index = 0; index + 1 < shard_count_; ++index) {
+            key_alloc_traits::destroy(allocator_, bounds_ + index);
+        }
+        key_alloc_traits::deallocate(allocator_, bounds_, layout_capacity_);
+        pointer_allocator_type pointer_allocator(allocator_);
+        pointer_alloc_traits::deallocate(pointer_allocator, shards_, layout_capacity_);
+    }
+
+    void release() {
+        for (size_type index = 0; index < shard_count_; ++index) {
+            free_shard(shards_[index]);
+        }
+        free_layout();
+        shards_ = nullptr;
+        bounds_ = nullptr;
+        shard_count_ = 0;
+        layout_capacity_ = 0;
+    }
+
+    // Splits the shard holding value at its median if it is still too big by the time the layout is ours.
+    void split_shard(const value_type& value) {
+        std::unique_lock<std::shared_mutex> layout(layout_);
+        size_type index = shard_of(value);
+        shard_set& keys = shards_[index]->keys;
+        if (keys.size() <= shard_capacity_) {
+            return;
+        }
+
+        value_type median = *keys.nth(keys.size() / 2);
+        reserve_layout(shard_count_ + 1);
+        shard* upper = make_shard();
+
+        // Past the new shard nothing throws but moving bounds: splitting relinks nodes and the room is reserved.
+        size_type last = shard_count_ - 1;
+        if (index == last) {
+            key_alloc_traits::construct(allocator_, bounds_ + last, std::move(median));
+        } else {
+            key_alloc_traits::construct(allocator_, bounds_ + last, std::move(bounds_[last - 1]));
+            std::move_backward(bounds_ + index, bounds_ + last - 1, bounds_ + last);
+            bounds_[index] = std::move(median);
+        }
+        upper->keys = keys.split(bounds_[index]);
+        std::copy_backward(shards_ + index + 1, shards_ + shard_count_, shards_ + shard_count_ + 1);
+        shards_[index + 1] = upper;
+        ++shard_count_;
+    }
+
+    // Folds the shard holding value into the smaller of its neighbours if it is still small by the time the
+    // layout is ours and the two fit in half a shard together.
+    void merge_shard(const value_type& value) {
+        std::unique_lock<std::shared_mutex> layout(layout_);
+        size_type index = shard_of(value);
+        if (shard_count_ < 2 || shards_[index]->keys.size() >= shard_capacity_ / 4) {
+            return;
+        }
+
+        auto size_at = [&](size_type at) {
+            return shards_[at]->keys.size();
+        };
+        size_type left = index;
+        if (index + 1 == shard_count_ || (index > 0 && size_at(index - 1) < size_at(index + 1))) {
+            left = index - 1;
+        }
+        if (size_at(left) + size_at(left + 1) > shard_capacity_ / 2) {
+            return;
+        }
+
+        shards_[left]->keys.concat(shards_[left + 1]->keys);
+        free_shard(shards_[left + 1]);
+        std::copy(shards_ + left + 2, shards_ + shard_count_, shards_ + left + 1);
+        std::move(bounds_ + left + 1, bounds_ + shard_count_ - 1, bounds_ + left);
+        key_alloc_traits::destroy(allocator_, bounds_ + shard_count_ - 2);
+        --shard_count_;
+    }
+};
+
+} // notstd
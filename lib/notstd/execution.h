@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+namespace notstd::execution {
+
+// Execution policies for the bulk set operations that take one. Each is itself a pool in the sense of
+// bst::unite: size() workers and fork_join(left, right), so either can go wherever a pool can.
+
+// Everything on the calling thread, in order.
+struct sequenced_policy {
+    size_t size() const {
+        return 0;
+    }
+
+    template<class Left, class Right>
+    void fork_join(Left&& left, Right&& right) const {
+        left();
+        right();
+    }
+};
+
+inline constexpr sequenced_policy seq{};
+
+// Branches offered to the workers of pool, such as a notstd::thread_pool, with the calling thread helping.
+template<class Pool>
+struct parallel_policy {
+    Pool* pool;
+
+    size_t size() const {
+        return pool->size();
+    }
+
+    template<class Left, class Right>
+    void fork_join(Left&& left, Right&& right) const {
+        pool->fork_join(left, right);
+    }
+};
+
+template<class Pool>
+parallel_policy<Pool> par(Pool& pool) {
+    return parallel_policy<Pool>{&pool};
+}
+
+template<class Tp>
+struct is_execution_policy : std::false_type {};
+
+template<>
+struct is_execution_policy<sequenced_policy> : std::true_type {};
+
+template<class Pool>
+struct is_execution_policy<parallel_policy<Pool>> : std::true_type {};
+
+template<class Tp>
+inline constexpr bool is_execution_policy_v = is_execution_policy<std::remove_cvref_t<Tp>>::value;
+
+} // notstd::execution
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <iterator>
+
+// Walks an Eytzinger array in key order. The array is an implicit complete tree numbered from 1, the children of
+// slot k being 2k and 2k + 1, so in-order steps are index arithmetic. Slot 0 is unused and stands for end().
+template<class Tp>
+class frozen_const_iterator {
+  public:
+    using difference_type = ptrdiff_t;
+    using size_type = size_t;
+    using value_type = Tp;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+    using iterator_category = std::bidirectional_iterator_tag;
+
+  private:
+    size_type index_;
+    const value_type* keys_;
+    size_type size_;
+
+  public:
+    explicit frozen_const_iterator(size_type index, const value_type* keys, size_type size)
+            : index_(index), keys_(keys), size_(size) {}
+
+    bool operator==(const frozen_const_iterator& other) const {
+        return index_ == other.index_;
+    }
+
+    bool operator!=(const frozen_const_iterator& other) const {
+        return !(*this == other);
+    }
+
+    reference operator*() const {
+        return keys_[index_];
+    }
+
+    pointer operator->() const {
+        return &keys_[index_];
+    }
+
+    // The Eytzinger slot the iterator stands on, 0 for end().
+    size_type index() const {
+        return index_;
+    }
+
+    frozen_const_iterator& operator++() {
+        index_ = next(index_, size_);
+
+        return *this;
+    }
+
+    frozen_const_iterator operator++(int) {
+        frozen_const_iterator result = *this;
+        ++*this;
+
+        return result;
+    }
+
+    frozen_const_iterator& operator--() {
+        index_ = prev(index_, size_);
+
+        return *this;
+    }
+
+    frozen_const_iterator operator--(int) {
+        frozen_const_iterator result = *this;
+        --*this;
+
+        return result;
+    }
+
+    // In-order successor of slot index in a tree of size slots; from 0 it is the first slot.
+    static size_type next(size_type index, size_type size) {
+        if (index == 0 || 2 * index + 1 <= size) {
+            index = (index == 0) ? 1 : 2 * index + 1;
+            while (2 * index <= size) {
+                index *= 2;
+            }
+            return (index <= size) ? index : 0;
+        }
+
+        // Climb while we are a right child; the parent of the first left child is next.
+        return index >> (std::countr_one(index) + 1);
+    }
+
+    static size_type prev(size_type index, size_type size) {
+        if (index == 0 || 2 * index <= size) {
+            index = (index == 0) ? 1 : 2 * index;
+            while (2 * index + 1 <= size) {
+                index = 2 * index + 1;
+            }
+            return (index <= size) ? index : 0;
+        }
+
+        return index >> (std::countr_zero(index) + 1);
+    }
+};
@@ -0,0 +1,411 @@
+#pragma once
+
+#include "frozen_const_iterator.h"
+#include "lib/notstd/bst/bst.h"
+#include "lib/notstd/sorted_unique.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define NOTSTD_FROZEN_AVX2 1
+#endif
+
+namespace notstd {
+
+// An immutable set whose keys sit in one array in Eytzinger order: the implicit binary tree stored level by
+// level, root first. A search reads one array slot per level, with no pointers and no branches on comparisons,
+// and the 16 slots four levels below the current one are adjacent, so they are prefetched while the search
+// climbs down to them. Built by set::freeze().
+template<class Tp, class Compare = std::less<Tp>, class Allocator = std::allocator<Tp>>
+class frozen_set {
+  public:
+    using key_type = Tp;
+    using value_type = Tp;
+    using key_compare = Compare;
+    using value_compare = Compare;
+    using allocator_type = Allocator;
+    using reference = const value_type&;
+    using const_reference = const value_type&;
+    using iterator = frozen_const_iterator<value_type>;
+    using const_iterator = frozen_const_iterator<value_type>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using difference_type = typename const_iterator::difference_type;
+    using size_type = typename const_iterator::size_type;
+
+  private:
+    // 32-bit keys under their natural order have an AVX2 kernel for batches; see contains_batch.
+    static constexpr bool simd_searchable =
+            (std::is_same_v<Tp, int32_t> || std::is_same_v<Tp, uint32_t>) &&
+            (std::is_same_v<Compare, std::less<Tp>> || std::is_same_v<Compare, std::less<>>);
+
+    using alloc_traits = std::allocator_traits<allocator_type>;
+
+    allocator_type allocator_;
+    // size_ + 1 slots, null while the set is empty. Slot 0 is left unconstructed, so the root is slot 1 and the
+    // children of slot k are 2k and 2k + 1.
+    value_type* keys_ = nullptr;
+    size_type size_ = 0;
+    value_compare compare_;
+
+  public:
+    explicit frozen_set() = default;
+
+    // Lays out a strictly increasing range, O(n) and without comparisons.
+    template<class ForwardIter>
+    explicit frozen_set(sorted_unique_t, ForwardIter first, ForwardIter last,
+                        const value_compare& compare = value_compare(),
+                        const allocator_type& alloc = allocator_type())
+            : allocator_(alloc), compare_(compare) {
+        lay_out(first, static_cast<size_type>(std::distance(first, last)));
+    }
+
+    // Copies the array slot for slot.
+    frozen_set(const frozen_set& other)
+            : allocator_(alloc_traits::select_on_container_copy_construction(other.allocator_)),
+              compare_(other.compare_) {
+        copy_from(other);
+    }
+
+    frozen_set(frozen_set&& other) noexcept
+            : allocator_(std::move(other.allocator_)), compare_(std::move(other.compare_)) {
+        steal(other);
+    }
+
+    frozen_set& operator=(const frozen_set& other) {
+        if (this == &other) {
+            return *this;
+        }
+
+        release();
+        if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+            allocator_ = other.allocator_;
+        }
+        compare_ = other.compare_;
+        copy_from(other);
+
+        return *this;
+    }
+
+    frozen_set& operator=(frozen_set&& other) noexcept(alloc_traits::propagate_on_container_move_assignment::value ||
+                                                       alloc_traits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+
+        release();
+        compare_ = std::move(other.compare_);
+
+        if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+            allocator_ = std::move(other.allocator_);
+        } else if (!alloc_traits::is_always_equal::value && allocator_ != other.allocator_) {
+            // Our allocator cannot free the other array, so only the keys can move over.
+            copy_from(std::move(other));
+            other.release();
+
+            return *this;
+        }
+
+        steal(other);
+
+        return *this;
+    }
+
+    ~frozen_set() {
+        release();
+    }
+
+    allocator_type get_allocator() const {
+        return allocator_;
+    }
+
+    key_compare key_comp() const {
+        return compare_;
+    }
+
+    value_compare value_comp() const {
+        return compare_;
+    }
+
+    const_iterator begin() const {
+        return cbegin();
+    }
+
+    const_iterator end() const {
+        return cend();
+    }
+
+    const_iterator cbegin() const {
+        return make_iterator(const_iterator::next(0, size()));
+    }
+
+    const_iterator cend() const {
+        return make_iterator(0);
+    }
+
+    const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(cend());
+    }
+
+    const_reverse_iterator rend() const {
+        return const_reverse_iterator(cbegin());
+    }
+
+    bool operator==(const frozen_set& other) const {
+        return size_ == other.size_ && (size_ == 0 || std::equal(keys_ + 1, keys_ + size_ + 1, other.keys_ + 1));
+    }
+
+    bool operator!=(const frozen_set& other) const {
+        return !(*this == other);
+    }
+
+    size_type size() const {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size() == 0;
+    }
+
+    bool contains(const value_type& value) const {
+        return holds(first_not_below(value), value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    bool contains(const Key& key) const {
+        return holds(first_not_below(key), key);
+    }
+
+    size_type count(const value_type& value) const {
+        return contains(value) ? 1 : 0;
+    }
+
+    const_iterator find(const value_type& value) const {
+        size_type index = first_not_below(value);
+        return make_iterator(holds(index, value) ? index : 0);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator find(const Key& key) const {
+        size_type index = first_not_below(key);
+        return make_iterator(holds(index, key) ? index : 0);
+    }
+
+    // Same convention as bst: the greatest key not above value.
+    const_iterator lower_bound(const value_type& value) const {
+        return lower_bound_key(value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator lower_bound(const Key& key) const {
+        return lower_bound_key(key);
+    }
+
+    // The least key not below value.
+    const_iterator upper_bound(const value_type& value) const {
+        return make_iterator(first_not_below(value));
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator upper_bound(const Key& key) const {
+        return make_iterator(first_not_below(key));
+    }
+
+    // results[i] = contains(keys[i]). For 32-bit integer keys on a CPU with AVX2 eight searches descend at
+    // once, each level one gather; elsewhere, and for the tail, this is the plain search.
+    void contains_batch(std::span<const value_type> keys, std::span<bool> results) const {
+        size_type done = 0;
+
+#ifdef NOTSTD_FROZEN_AVX2
+        if constexpr (simd_searchable) {
+            // Gather takes 32-bit indices, and a search may step one level past the last slot.
+            if (size() < (size_type(1) << 30) && __builtin_cpu_supports("avx2")) {
+                uint32_t fell_off[8];
+                for (; done + 8 <= keys.size(); done += 8) {
+                    descend_avx2(keys.data() + done, fell_off);
+                    for (size_type lane = 0; lane < 8; ++lane) {
+                        results[done + lane] = holds(fell_off[lane] >> (std::countr_one(fell_off[lane]) + 1),
+                                                     keys[done + lane]);
+                    }
+                }
+            }
+        }
+#endif
+
+        for (; done < keys.size(); ++done) {
+            results[done] = contains(keys[done]);
+        }
+    }
+
+  private:
+    const_iterator make_iterator(size_type index) const {
+        return const_iterator(index, keys_, size());
+    }
+
+    // Fills a new array from count strictly increasing keys: an in-order walk of the implicit tree meets the
+    // slots in key order.
+    template<class ForwardIter>
+    void lay_out(ForwardIter first, size_type count) {
+        if (count == 0) {
+            return;
+        }
+
+        keys_ = alloc_traits::allocate(allocator_, count + 1);
+        size_type index = const_iterator::next(0, count);
+        try {
+            for (; index != 0; ++first) {
+                alloc_traits::construct(allocator_, keys_ + index, *first);
+                index = const_iterator::next(index, count);
+            }
+        } catch (...) {
+            // The slots built so far are the ones the walk passed before index.
+            for (size_type built = const_iterator::next(0, count); built != index;
+                 built = const_iterator::next(built, count)) {
+                alloc_traits::destroy(allocator_, keys_ + built);
+            }
+            alloc_traits::deallocate(allocator_, keys_, count + 1);
+            keys_ = nullptr;
+            throw;
+        }
+        size_ = count;
+    }
+
+    // Takes other's keys, moving them if other is an rvalue, into a new array of the same layout.
+    template<class Other>
+    void copy_from(Other&& other) {
+        if (other.size_ == 0) {
+            return;
+        }
+
+        keys_ = alloc_traits::allocate(allocator_, other.size_ + 1);
+        size_type index = 1;
+        try {
+            for (; index <= other.size_; ++index) {
+                if constexpr (std::is_lvalue_reference_v<Other>) {
+                    alloc_traits::construct(allocator_, keys_ + index, other.keys_[index]);
+                } else {
+                    alloc_traits::construct(allocator_, keys_ + index, std::move(other.keys_[index]));
+                }
+            }
+        } catch (...) {
+            while (--index > 0) {
+                alloc_traits::destroy(allocator_, keys_ + index);
+            }
+            alloc_traits::deallocate(allocator_, keys_, other.size_ + 1);
+            keys_ = nullptr;
+            throw;
+        }
+        size_ = other.size_;
+    }
+
+    void steal(frozen_set& other) {
+        keys_ = std::exchange(other.keys_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+
+    void release() {
+        if (keys_ == nullptr) {
+            return;
+        }
+
+        for (size_type index = 1; index <= size_; ++index) {
+            alloc_traits::destroy(allocator_, keys_ + index);
+        }
+        alloc_traits::deallocate(allocator_, keys_, size_ + 1);
+        keys_ = nullptr;
+        size_ = 0;
+    }
+
+    static void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#endif
+    }
+
+    template<class Key>
+    bool holds(size_type index, const Key& key) const {
+        return index != 0 && !compare_(key, keys_[index]);
+    }
+
+    // The first of the 16 slots four levels below index, clamped to the last slot near the bottom of the tree
+    // so that the address stays inside the array.
+    const value_type* descendants(size_type index) const {
+        return keys_ + std::min(16 * index, size());
+    }
+
+    // The slot of the least key not below key, 0 if there is none. The search walks off the bottom of the
+    // tree having turned right at every key below key; the trailing right turns undone, the last left turn
+    // was at the answer.
+    template<class Key>
+    size_type first_not_below(const Key& key) const {
+        const value_type* keys = keys_;
+        size_type index = 1;
+
+        while (index <= size()) {
+            prefetch(descendants(index));
+            index = 2 * index + compare_(keys[index], key);
+        }
+
+        return index >> (std::countr_one(index) + 1);
+    }
+
+    // The mirror search finds the least key above key; the answer is the key before it.
+    template<class Key>
+    const_iterator lower_bound_key(const Key& key) const {
+        const value_type* keys = keys_;
+        size_type index = 1;
+
+        while (index <= size()) {
+            prefetch(descendants(index));
+            index = 2 * index + !compare_(key, keys[index]);
+        }
+
+        index >>= std::countr_one(index) + 1;
+        if (index == const_iterator::next(0, size())) {
+            return cend();
+        }
+
+        return --make_iterator(index);
+    }
+
+#ifdef NOTSTD_FROZEN_AVX2
+    // The descent of first_not_below for eight keys, leaving in fell_off the slot each one walked off at.
+    // Every level above the last is full, so only the last step needs a mask.
+    __attribute__((target("avx2"))) void descend_avx2(const value_type* queries, uint32_t* fell_off) const {
+        const int* keys = reinterpret_cast<const int*>(keys_);
+        // Flipping the sign bit makes a signed comparison order unsigned keys.
+        const __m256i bias = _mm256_set1_epi32(std::is_signed_v<value_type> ? 0 : INT32_MIN);
+        const __m256i bound = _mm256_set1_epi32(static_cast<int>(size() + 1));
+        const int full_levels = std::bit_width(size() + 1) - 1;
+
+        __m256i key = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(queries)), bias);
+        __m256i index = _mm256_set1_epi32(1);
+
+        for (int level = 0; level < full_levels; ++level) {
+            __m256i slot = _mm256_xor_si256(_mm256_i32gather_epi32(keys, index, 4), bias);
+            // cmpgt yields -1 where the slot is below the key: subtracting it turns right.
+            index = _mm256_sub_epi32(_mm256_add_epi32(index, index), _mm256_cmpgt_epi32(key, slot));
+        }
+
+        __m256i inside = _mm256_cmpgt_epi32(bound, index);
+        if (!_mm256_testz_si256(inside, inside)) {
+            __m256i slot = _mm256_xor_si256(
+                    _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), keys, index, inside, 4), bias);
+            __m256i right = _mm256_and_si256(_mm256_cmpgt_epi32(key, slot), inside);
+            index = _mm256_sub_epi32(_mm256_add_epi32(index, _mm256_and_si256(index, inside)), right);
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(fell_off), index);
+    }
+#endif
+};
+
+} // notstd
@@ -0,0 +1,478 @@
+#pragma once
+
+#include "persistent_const_iterator.h"
+#include "persistent_node.h"
+#include "lib/notstd/bst/bst.h"
+
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// An AVL tree whose versions share nodes. Copying it takes one reference on the root, O(1). An update walks
+// down from the root and, before changing a node, copies it if any other version still holds it, so a change
+// costs O(log n) new nodes while snapshots exist and none once they are gone. Distinct versions may be read and
+// updated from different threads at once; frozen nodes are never written. Any update of a version invalidates
+// its iterators, which hold the path to their node; a version left alone keeps them valid for as long as it lives.
+// The versions of one tree must have allocators that compare equal, since whichever drops a node last frees it.
+template<class Tp, class Order = bst_order::in_order_tag, class Compare = std::less<Tp>,
+        class Allocator = std::allocator<Tp>>
+class persistent_bst {
+  public:
+    using value_type = Tp;
+    using node_type = persistent_node<value_type>;
+    using value_compare = Compare;
+    using allocator_type = Allocator;
+
+  private:
+    using alloc_traits = std::allocator_traits<allocator_type>;
+
+  public:
+    using pointer = typename alloc_traits::pointer;
+    using const_pointer = typename alloc_traits::const_pointer;
+    using const_iterator = persistent_const_iterator<node_type, Order>;
+    using difference_type = typename const_iterator::difference_type;
+    using size_type = typename const_iterator::size_type;
+
+    using node_allocator_type = typename alloc_traits::template rebind_alloc<node_type>;
+
+  private:
+    using node_alloc_traits = std::allocator_traits<node_allocator_type>;
+
+    static_assert(std::is_copy_constructible_v<value_type>, "persistent_bst copies the shared nodes it changes");
+
+    node_allocator_type allocator_;
+    value_compare compare_;
+
+    node_type* root_ = nullptr;
+    size_type size_ = 0;
+
+  public:
+    explicit persistent_bst() = default;
+
+    explicit persistent_bst(const value_compare& compare) : compare_(compare) {};
+
+    explicit persistent_bst(const allocator_type& alloc) : allocator_(alloc) {};
+
+    // Shares every node with other.
+    persistent_bst(const persistent_bst& other)
+            : allocator_(node_alloc_traits::select_on_container_copy_construction(other.allocator_)),
+              compare_(other.compare_), root_(retain(other.root_)), size_(other.size_) {}
+
+    persistent_bst(persistent_bst&& other) noexcept
+            : allocator_(std::move(other.allocator_)), compare_(std::move(other.compare_)),
+              root_(std::exchange(other.root_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+    persistent_bst& operator=(const persistent_bst& other) {
+        if (this == &other) {
+            return *this;
+        }
+
+        node_type* old_root = std::exchange(root_, retain(other.root_));
+        release(old_root);
+        compare_ = other.compare_;
+        size_ = other.size_;
+
+        return *this;
+    }
+
+    persistent_bst& operator=(persistent_bst&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+
+        release(root_);
+        compare_ = std::move(other.compare_);
+        root_ = std::exchange(other.root_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+
+        return *this;
+    }
+
+    ~persistent_bst() {
+        release(root_);
+    }
+
+    template<class InputIter>
+    void assign(InputIter first, InputIter last) {
+        clear();
+        for (; first != last; ++first) {
+            insert(*first);
+        }
+    }
+
+    std::pair<const_iterator, bool> insert(const value_type& value) {
+        return place_unique(value, [&] { return create_node(value); });
+    }
+
+    std::pair<const_iterator, bool> insert(value_type&& value) {
+        return place_unique(value, [&] { return create_node(std::move(value)); });
+    }
+
+    template<class... Args>
+    std::pair<const_iterator, bool> emplace(Args&&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    // The hint is ignored: without parent links a position saves nothing over searching from the root.
+    const_iterator insert(const_iterator, const value_type& value) {
+        return insert(value).first;
+    }
+
+    const_iterator insert(const_iterator, value_type&& value) {
+        return insert(std::move(value)).first;
+    }
+
+    template<class... Args>
+    const_iterator emplace_hint(const_iterator hint, Args&&... args) {
+        return insert(hint, value_type(std::forward<Args>(args)...));
+    }
+
+    size_type erase(const value_type& value) {
+        if (find_node(value) == nullptr) {
+            return 0;
+        }
+
+        release(unlink(root_, value));
+        --size_;
+
+        return 1;
+    }
+
+    // Updates may copy or move any node, so the next key is found again by value.
+    const_iterator erase(const_iterator iter) {
+        if (iter == cend()) {
+            return iter;
+        }
+
+        const_iterator next = std::next(iter);
+        if (next == cend()) {
+            erase(*iter);
+            return cend();
+        }
+
+        value_type next_key = *next;
+        erase(*iter);
+        return find(next_key);
+    }
+
+    // One key at a time, each step leaving the tree whole if a copy throws. The first erase invalidates last, so
+    // its key marks where to stop, and the iterator that reaches it is already the one to return.
+    const_iterator erase(const_iterator first, const_iterator last) {
+        if (last == cend()) {
+            while (first != cend()) {
+                first = erase(first);
+            }
+            return first;
+        }
+
+        value_type last_key = *last;
+        while (compare_(*first, last_key) || compare_(last_key, *first)) {
+            first = erase(first);
+        }
+        return first;
+    }
+
+    const_iterator find(const value_type& value) const {
+        return find_key(value);
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator find(const Key& key) const {
+        return find_key(key);
+    }
+
+    // Same convention as bst: the greatest key not above value.
+    const_iterator lower_bound(const value_type& value) const {
+        return bound_key(value, [&](const value_type& key) { return !compare_(value, key); });
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator lower_bound(const Key& key) const {
+        return bound_key(key, [&](const value_type& other) { return !compare_(key, other); });
+    }
+
+    // The least key not below value.
+    const_iterator upper_bound(const value_type& value) const {
+        return bound_key(value, [&](const value_type& key) { return !compare_(key, value); });
+    }
+
+    template<class Key> requires transparent_comparator<Compare>
+    const_iterator upper_bound(const Key& key) const {
+        return bound_key(key, [&](const value_type& other) { return !compare_(other, key); });
+    }
+
+    void clear() {
+        release(std::exchange(root_, nullptr));
+        size_ = 0;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return root_ == nullptr;
+    }
+
+    size_type size() const {
+        return size_;
+    }
+
+    allocator_type get_allocator() const {
+        return allocator_type(allocator_);
+    }
+
+    const_iterator cbegin() const {
+        return ++cend();
+    }
+
+    const_iterator cend() const {
+        return const_iterator(root_);
+    }
+
+  private:
+    template<class Key>
+    node_type* find_node(const Key& key) const {
+        node_type* current = root_;
+        while (current != nullptr) {
+            if (compare_(key, current->key)) {
+                current = current->left;
+            } else if (compare_(current->key, key)) {
+                current = current->right;
+            } else {
+                return current;
+            }
+        }
+
+        return nullptr;
+    }
+
+    template<class Key>
+    const_iterator find_key(const Key& key) const {
+        const_iterator iter = cend();
+        for (const node_type* current = root_; current != nullptr;) {
+            iter.push(current);
+            if (compare_(key, current->key)) {
+                current = current->left;
+            } else if (compare_(current->key, key)) {
+                current = current->right;
+            } else {
+                return iter;
+            }
+        }
+
+        return cend();
+    }
+
+    // The deepest node on key's search path that satisfies accept; accepted keys lie on one side of key, so
+    // that is also the nearest one. The path down to it is a prefix of the search path.
+    template<class Key, class Accept>
+    const_iterator bound_key(const Key& key, Accept accept) const {
+        const_iterator iter = cend();
+        size_type best = 0;
+        for (const node_type* current = root_; current != nullptr;) {
+            iter.push(current);
+            if (accept(current->key)) {
+                best = iter.depth_;
+            }
+            if (compare_(key, current->key)) {
+                current = current->left;
+            } else if (compare_(current->key, key)) {
+                current = current->right;
+            } else {
+                break;
+            }
+        }
+        iter.depth_ = best;
+
+        return iter;
+    }
+
+    template<class Key, class MakeNode>
+    std::pair<const_iterator, bool> place_unique(const Key& key, MakeNode make_node) {
+        if (find_node(key) != nullptr) {
+            return std::make_pair(find_key(key), false);
+        }
+
+        node_type* created = make_node();
+        try {
+            link(root_, created);
+        } catch (...) {
+            release(created);
+            throw;
+        }
+        ++size_;
+
+        return std::make_pair(find_key(created->key), true);
+    }
+
+    template<class... Args>
+    node_type* create_node(Args&&... args) {
+        node_type* node = node_alloc_traits::allocate(allocator_, 1);
+        try {
+            node_alloc_traits::construct(allocator_, node, std::forward<Args>(args)...);
+        } catch (...) {
+            node_alloc_traits::deallocate(allocator_, node, 1);
+            throw;
+        }
+
+        return node;
+    }
+
+    static node_type* retain(node_type* node) {
+        if (node != nullptr) {
+            node->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return node;
+    }
+
+    // Drops one link to node, freeing it and dropping its own links if that was the last.
+    void release(node_type* node) {
+        while (node != nullptr && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            release(node->left);
+            node_type* right = node->right;
+            node_alloc_traits::destroy(allocator_, node);
+            node_alloc_traits::deallocate(allocator_, node, 1);
+            node = right;
+        }
+    }
+
+    // Makes the node slot links to one this version alone holds, copying it if it is shared. Slot itself must
+    // belong to a node this version alone holds, or be the root. If the copy throws, nothing has changed.
+    void own(node_type*& slot) {
+        if (slot->refs.load(std::memory_order_acquire) == 1) {
+            return;
+        }
+
+        node_type* copy = create_node(slot->key);
+        copy->left = retain(slot->left);
+        copy->right = retain(slot->right);
+        copy->height = slot->height;
+        release(std::exchange(slot, copy));
+    }
+
+    static int32_t height(const node_type* node) {
+        return (node != nullptr) ? node->height : 0;
+    }
+
+    static void update_height(node_type* node) {
+        node->height = 1 + std::max(height(node->left), height(node->right));
+    }
+
+    // Both rotate an owned node with its owned child and return the new subtree root; no reference changes hands.
+    static node_type* rotate_left(node_type* node) {
+        node_type* right = node->right;
+        node->right = right->left;
+        right->left = node;
+        update_height(node);
+        update_height(right);
+
+        return right;
+    }
+
+    static node_type* rotate_right(node_type* node) {
+        node_type* left = node->left;
+        node->left = left->right;
+        left->right = node;
+        update_height(node);
+        update_height(left);
+
+        return left;
+    }
+
+    // Restores the AVL shape at the owned node in slot after one of its subtrees grew or shrank by one level.
+    // Every node a rotation takes apart is owned by then: an insert rotates only nodes on its own path, and an
+    // erase owns what it may need on the way down (see own_sibling), so every copy precedes the first change.
+    void rebalance(node_type*& slot) {
+        node_type* node = slot;
+        int32_t balance = height(node->left) - height(node->right);
+
+        if (balance > 1) {
+            own(node->left);
+            if (height(node->left->left) < height(node->left->right)) {
+                own(node->left->right);
+                node->left = rotate_left(node->left);
+            }
+            slot = rotate_right(node);
+        } else if (balance < -1) {
+            own(node->right);
+            if (height(node->right->right) < height(node->right->left)) {
+                own(node->right->left);
+                node->right = rotate_right(node->right);
+            }
+            slot = rotate_left(node);
+        } else {
+            update_height(node);
+        }
+    }
+
+    // Before an erase descends to one side of the owned node, owns what a rotation there could take apart once
+    // that side has shrunk: the sibling, if it is the taller side, and its inner child.
+    void own_sibling(node_type* node, bool descend_left) {
+        node_type*& sibling = descend_left ? node->right : node->left;
+        if (height(sibling) <= height(descend_left ? node->left : node->right)) {
+            return;
+        }
+
+        own(sibling);
+        node_type*& inner = descend_left ? sibling->left : sibling->right;
+        if (inner != nullptr) {
+            own(inner);
+        }
+    }
+
+    // Hangs created, whose key is not in the tree, below slot.
+    void link(node_type*& slot, node_type* created) {
+        if (slot == nullptr) {
+            slot = created;
+            return;
+        }
+
+        own(slot);
+        link(compare_(created->key, slot->key) ? slot->left : slot->right, created);
+        rebalance(slot);
+    }
+
+    // Detaches the node holding key, which must be below slot, and returns it owned and without children.
+    template<class Key>
+    node_type* unlink(node_type*& slot, const Key& key) {
+        own(slot);
+        node_type* node = slot;
+        node_type* removed;
+
+        if (compare_(key, node->key)) {
+            own_sibling(node, true);
+            removed = unlink(node->left, key);
+        } else if (compare_(node->key, key)) {
+            own_sibling(node, false);
+            removed = unlink(node->right, key);
+        } else if (node->left == nullptr || node->right == nullptr) {
+            slot = (node->left != nullptr) ? node->left : node->right;
+            node->left = node->right = nullptr;
+            return node;
+        } else {
+            // The successor takes the node's place, children and all.
+            own_sibling(node, false);
+            node_type* successor = unlink_min(node->right);
+            successor->left = std::exchange(node->left, nullptr);
+            successor->right = std::exchange(node->right, nullptr);
+            slot = successor;
+            removed = node;
+        }
+
+        rebalance(slot);
+        return removed;
+    }
+
+    node_type* unlink_min(node_type*& slot) {
+        own(slot);
+        node_type* node = slot;
+        if (node->left == nullptr) {
+            slot = std::exchange(node->right, nullptr);
+            return node;
+        }
+
+        own_sibling(node, true);
+        node_type* min = unlink_min(node->left);
+        rebalance(slot);
+        return min;
+    }
+};
@@ -0,0 +1,221 @@
+#pragma once
+
+#include "lib/notstd/bst/bst_order.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+
+// The counterpart of bst_const_iterator for persistent_bst, with the same three traversal orders. Shared nodes
+// cannot point back at one parent, so the iterator carries the path down from the root to its node instead.
+template<class Node, class Order>
+class persistent_const_iterator {
+  public:
+    using difference_type = ptrdiff_t;
+    using size_type = size_t;
+    using value_type = typename Node::value_type;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+    using iterator_category = std::bidirectional_iterator_tag;
+
+    // The tallest AVL tree whose size fits in a size_t.
+    static constexpr size_type max_depth = 92;
+
+  private:
+    const Node* root_ = nullptr;
+    // path_[depth_ - 1] is the node the iterator stands on; end() has an empty path.
+    size_type depth_ = 0;
+    const Node* path_[max_depth];
+
+    template<class, class, class, class>
+    friend class persistent_bst;
+
+  public:
+    persistent_const_iterator() = default;
+
+    explicit persistent_const_iterator(const Node* root) : root_(root) {}
+
+    persistent_const_iterator(const persistent_const_iterator& other) : root_(other.root_), depth_(other.depth_) {
+        std::copy(other.path_, other.path_ + depth_, path_);
+    }
+
+    persistent_const_iterator& operator=(const persistent_const_iterator& other) {
+        root_ = other.root_;
+        depth_ = other.depth_;
+        std::copy(other.path_, other.path_ + depth_, path_);
+
+        return *this;
+    }
+
+    bool operator==(const persistent_const_iterator& other) const {
+        return top() == other.top();
+    }
+
+    bool operator!=(const persistent_const_iterator& other) const {
+        return !(*this == other);
+    }
+
+    reference operator*() const {
+        return top()->key;
+    }
+
+    pointer operator->() const {
+        return &top()->key;
+    }
+
+    persistent_const_iterator& operator++() {
+        increment(Order());
+
+        return *this;
+    }
+
+    persistent_const_iterator operator++(int) {
+        persistent_const_iterator result = *this;
+        ++*this;
+
+        return result;
+    }
+
+    persistent_const_iterator& operator--() {
+        decrement(Order());
+
+        return *this;
+    }
+
+    persistent_const_iterator operator--(int) {
+        persistent_const_iterator result = *this;
+        --*this;
+
+        return result;
+    }
+
+  private:
+    const Node* top() const {
+        return (depth_ != 0) ? path_[depth_ - 1] : nullptr;
+    }
+
+    void push(const Node* node) {
+        path_[depth_++] = node;
+    }
+
+    // Steps up to the parent and returns the child it left.
+    const Node* pop() {
+        return path_[--depth_];
+    }
+
+    void push_root() {
+        if (root_ != nullptr) {
+            push(root_);
+        }
+    }
+
+    void push_leftmost(const Node* node) {
+        for (; node != nullptr; node = node->left) {
+            push(node);
+        }
+    }
+
+    void push_rightmost(const Node* node) {
+        for (; node != nullptr; node = node->right) {
+            push(node);
+        }
+    }
+
+    void push_first_leaf(const Node* node) {
+        while (node != nullptr) {
+            push(node);
+            node = (node->left != nullptr) ? node->left : node->right;
+        }
+    }
+
+    void push_last_leaf(const Node* node) {
+        while (node != nullptr) {
+            push(node);
+            node = (node->right != nullptr) ? node->right : node->left;
+        }
+    }
+
+    void increment(const bst_order::in_order_tag&) {
+        if (depth_ == 0) {
+            push_leftmost(root_);
+        } else if (top()->right != nullptr) {
+            push_leftmost(top()->right);
+        } else {
+            for (const Node* child = pop(); depth_ != 0 && top()->right == child;) {
+                child = pop();
+            }
+        }
+    }
+
+    void increment(const bst_order::pre_order_tag&) {
+        if (depth_ == 0) {
+            push_root();
+        } else if (top()->left != nullptr) {
+            push(top()->left);
+        } else if (top()->right != nullptr) {
+            push(top()->right);
+        } else {
+            while (depth_ != 0) {
+                const Node* child = pop();
+                if (depth_ != 0 && top()->left == child && top()->right != nullptr) {
+                    push(top()->right);
+                    return;
+                }
+            }
+        }
+    }
+
+    void increment(const bst_order::post_order_tag&) {
+        if (depth_ == 0) {
+            push_first_leaf(root_);
+            return;
+        }
+
+        const Node* child = pop();
+        if (depth_ != 0 && top()->left == child && top()->right != nullptr) {
+            push_first_leaf(top()->right);
+        }
+    }
+
+    void decrement(const bst_order::in_order_tag&) {
+        if (depth_ == 0) {
+            push_rightmost(root_);
+        } else if (top()->left != nullptr) {
+            push_rightmost(top()->left);
+        } else {
+            for (const Node* child = pop(); depth_ != 0 && top()->left == child;) {
+                child = pop();
+            }
+        }
+    }
+
+    void decrement(const bst_order::pre_order_tag&) {
+        if (depth_ == 0) {
+            push_last_leaf(root_);
+            return;
+        }
+
+        const Node* child = pop();
+        if (depth_ != 0 && top()->right == child && top()->left != nullptr) {
+            push_last_leaf(top()->left);
+        }
+    }
+
+    void decrement(const bst_order::post_order_tag&) {
+        if (depth_ == 0) {
+            push_root();
+        } else if (top()->right != nullptr) {
+            push(top()->right);
+        } else if (top()->left != nullptr) {
+            push(top()->left);
+        } else {
+            while (depth_ != 0) {
+                const Node* child = pop();
+                if (depth_ != 0 && top()->right == child && top()->left != nullptr) {
+                    push(top()->left);
+                    return;
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+// A node of persistent_bst, shared by every version of the tree that reaches it. refs counts the links to it,
+// from parents and from tree roots. A node with more than one is frozen; one with exactly one belongs to a single
+// version, whose updates may change it in place.
+template<class Tp>
+struct persistent_node {
+    using value_type = Tp;
+
+    value_type key;
+    persistent_node* left = nullptr;
+    persistent_node* right = nullptr;
+    int32_t height = 1;
+    std::atomic<uint32_t> refs = 1;
+
+    template<class... Args>
+    explicit persistent_node(Args&&... args) : key(std::forward<Args>(args)...) {}
+
+    persistent_node(const persistent_node&) = delete;
+
+    persistent_node& operator=(const persistent_node&) = delete;
+};
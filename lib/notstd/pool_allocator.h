@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace notstd {
+
+// Hands out fixed-size chunks carved from large slabs and recycles freed chunks through an intrusive free list.
+// Slabs are only returned to the system when the pool itself is destroyed. Not thread-safe.
+template<size_t ChunkSize, size_t ChunkAlign, size_t SlabSize>
+class pool_resource {
+  private:
+    struct free_chunk {
+        free_chunk* next;
+    };
+
+    static constexpr size_t kAlign = ChunkAlign > alignof(free_chunk) ? ChunkAlign : alignof(free_chunk);
+    static constexpr size_t kChunk = ((ChunkSize > sizeof(free_chunk) ? ChunkSize : sizeof(free_chunk)) + kAlign - 1)
+                                     / kAlign * kAlign;
+    static constexpr size_t kHeader = (sizeof(void*) + kAlign - 1) / kAlign * kAlign;
+    static constexpr size_t kChunksPerSlab = (SlabSize > kHeader + kChunk) ? (SlabSize - kHeader) / kChunk : 1;
+    static constexpr size_t kSlabBytes = kHeader + kChunksPerSlab * kChunk;
+
+    free_chunk* free_list_ = nullptr;
+    std::byte* slabs_ = nullptr;
+    std::byte* bump_ = nullptr;
+    std::byte* bump_end_ = nullptr;
+
+  public:
+    pool_resource() = default;
+
+    pool_resource(const pool_resource&) = delete;
+
+    pool_resource& operator=(const pool_resource&) = delete;
+
+    void* allocate() {
+        if (free_list_ != nullptr) {
+            free_chunk* chunk = free_list_;
+            free_list_ = chunk->next;
+            return chunk;
+        }
+
+        if (bump_ == bump_end_) {
+            grow();
+        }
+
+        void* chunk = bump_;
+        bump_ += kChunk;
+
+        return chunk;
+    }
+
+    void deallocate(void* chunk) {
+        free_chunk* freed = static_cast<free_chunk*>(chunk);
+        freed->next = free_list_;
+        free_list_ = freed;
+    }
+
+    ~pool_resource() {
+        while (slabs_ != nullptr) {
+            std::byte* next = *reinterpret_cast<std::byte**>(slabs_);
+            ::operator delete(slabs_, std::align_val_t(kAlign));
+            slabs_ = next;
+        }
+    }
+
+  private:
+    void grow() {
+        std::byte* slab = static_cast<std::byte*>(::operator new(kSlabBytes, std::align_val_t(kAlign)));
+
+        *reinterpret_cast<std::byte**>(slab) = slabs_;
+        slabs_ = slab;
+        bump_ = slab + kHeader;
+        bump_end_ = slab + kSlabBytes;
+    }
+};
+
+// One pool per chunk shape, shared by an allocator and everything rebound from it, so that a rebound copy
+// frees what the original allocated. A family only ever asks for a handful of shapes: a short list will do.
+template<size_t SlabSize>
+class pool_arena {
+  private:
+    struct entry_base {
+        size_t size;
+        size_t align;
+        entry_base* next;
+
+        entry_base(size_t size, size_t align, entry_base* next) : size(size), align(align), next(next) {}
+
+        virtual ~entry_base() = default;
+    };
+
+    template<size_t ChunkSize, size_t ChunkAlign>
+    struct entry : entry_base {
+        pool_resource<ChunkSize, ChunkAlign, SlabSize> pool;
+
+        explicit entry(entry_base* next) : entry_base(ChunkSize, ChunkAlign, next) {}
+    };
+
+    entry_base* entries_ = nullptr;
+
+  public:
+    pool_arena() = default;
+
+    pool_arena(const pool_arena&) = delete;
+
+    pool_arena& operator=(const pool_arena&) = delete;
+
+    template<size_t ChunkSize, size_t ChunkAlign>
+    pool_resource<ChunkSize, ChunkAlign, SlabSize>& resource() {
+        for (entry_base* current = entries_; current != nullptr; current = current->next) {
+            if (current->size == ChunkSize && current->align == ChunkAlign) {
+                return static_cast<entry<ChunkSize, ChunkAlign>*>(current)->pool;
+            }
+        }
+
+        auto* created = new entry<ChunkSize, ChunkAlign>(entries_);
+        entries_ = created;
+
+        return created->pool;
+    }
+
+    ~pool_arena() {
+        while (entries_ != nullptr) {
+            entry_base* next = entries_->next;
+            delete entries_;
+            entries_ = next;
+        }
+    }
+};
+
+// Single-object allocations (the only kind bst makes for its nodes) come from a pool in the allocator's arena;
+// copies and rebound allocators share the arena. Array allocations go to operator new.
+template<class Tp, size_t SlabSize = 64 * 1024>
+class pool_allocator {
+  public:
+    using value_type = Tp;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    template<class Up>
+    struct rebind {
+        using other = pool_allocator<Up, SlabSize>;
+    };
+
+  private:
+    using arena_type = pool_arena<SlabSize>;
+    using resource_type = pool_resource<sizeof(Tp), alignof(Tp), SlabSize>;
+
+    template<class Up, size_t OtherSlabSize>
+    friend class pool_allocator;
+
+    std::shared_ptr<arena_type> arena_;
+    resource_type* pool_;
+
+    explicit pool_allocator(std::shared_ptr<arena_type> arena)
+            : arena_(std::move(arena)), pool_(&arena_->template resource<sizeof(Tp), alignof(Tp)>()) {}
+
+  public:
+    pool_allocator() : pool_allocator(std::make_shared<arena_type>()) {}
+
+    pool_allocator(const pool_allocator& other) = default;
+
+    template<class Up>
+    pool_allocator(const pool_allocator<Up, SlabSize>& other) : pool_allocator(other.arena_) {}
+
+    pool_allocator& operator=(const pool_allocator& other) = default;
+
+    Tp* allocate(size_type n) {
+        if (n == 1) {
+            return static_cast<Tp*>(pool_->allocate());
+        }
+
+        return static_cast<Tp*>(::operator new(n * sizeof(Tp), std::align_val_t(alignof(Tp))));
+    }
+
+    void deallocate(Tp* ptr, size_type n) {
+        if (n == 1) {
+            pool_->deallocate(ptr);
+            return;
+        }
+
+        ::operator delete(ptr, std::align_val_t(alignof(Tp)));
+    }
+
+    // A copied container gets its own arena instead of interleaving its nodes with the source's.
+    pool_allocator select_on_container_copy_construction() const {
+        return pool_allocator();
+    }
+
+    template<class Up>
+    bool operator==(const pool_allocator<Up, SlabSize>& other) const {
+        return arena_ == other.arena_;
+    }
+
+    template<class Up>
+    bool operator!=(const pool_allocator<Up, SlabSize>& other) const {
+        return !(*this == other);
+    }
+};
+
+} // notstd
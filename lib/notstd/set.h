@@ -2,228 +2,373 @@
 
 #include <algorithm>
 
+#include "lib/notstd/basic_set.h"
 #include "lib/notstd/bst/bst.h"
+#include "lib/notstd/btree/btree.h"
+#include "lib/notstd/compact/compact_bst.h"
+#include "lib/notstd/execution.h"
+#include "lib/notstd/frozen/frozen_set.h"
+#include "lib/notstd/persistent/persistent_bst.h"
+#include "lib/notstd/set_backend.h"
+#include "lib/notstd/sorted_unique.h"
 
 namespace notstd {
 
 template<class Tp, class Order = bst_order::in_order_tag, class Compare = std::less<Tp>,
-        class Allocator = std::allocator<Tp>>
-class set {
-  public:
-    using key_type = Tp;
-    using value_type = Tp;
-    using key_compare = Compare;
-    using value_compare = Compare;
-    using allocator_type = Allocator;
-    using reference = value_type&;
-    using const_reference = const value_type&;
-
-  private:
-    using base = bst<value_type, Order, value_compare, allocator_type>;
+        class Allocator = std::allocator<Tp>, class Balance = bst_balance::none_tag,
+        class Augment = bst_augment::none_tag, class Thread = bst_thread::none_tag,
+        class Backend = set_backend::bst_tag>
+class set : public basic_set<bst<Tp, Order, Compare, Allocator, Balance, Augment, Thread>> {
+    using tree_type = bst<Tp, Order, Compare, Allocator, Balance, Augment, Thread>;
+    using base = basic_set<tree_type>;
 
-    base tree_;
+    using base::tree_;
 
   public:
-    using node_type = typename base::node_type;
-    using pointer = typename base::pointer;
-    using const_pointer = typename base::const_pointer;
-    using iterator = typename base::const_iterator;
-    using const_iterator = typename base::const_iterator;
-    using difference_type = typename base::difference_type;
-    using size_type = typename base::size_type;
-    using reverse_iterator = typename std::reverse_iterator<iterator>;
-    using const_reverse_iterator = typename std::reverse_iterator<const_iterator>;
+    using typename base::key_type;
+    using typename base::value_type;
+    using typename base::key_compare;
+    using typename base::iterator;
+    using typename base::const_iterator;
+    using typename base::size_type;
+    using node_type = typename tree_type::node_handle;
+    using insert_return_type = typename tree_type::insert_return_type;
+
+    using base::base;
+    using base::operator=;
+    using base::insert;
 
     explicit set() = default;
 
-    explicit set(const key_compare& compare) : tree_(compare) {}
-
-    explicit set(const allocator_type& alloc) : tree_(alloc) {}
-
     template<class InputIter>
-    explicit set(InputIter i, InputIter j) {
-        insert(i, j);
+    explicit set(sorted_unique_t, InputIter i, InputIter j) {
+        tree_.assign_sorted_unique(i, j);
     }
 
     template<class InputIter>
-    explicit set(InputIter i, InputIter j, const key_compare& compare) : set(i, j), tree_(compare) {}
-
-    set(std::initializer_list<value_type> list, const key_compare& compare) : set(list.begin(), list.end(), compare) {}
-
-    set(std::initializer_list<value_type> list) : set(list.begin(), list.end()) {}
-
-    set& operator=(std::initializer_list<value_type> list) {
-        clear();
-        insert(list.begin(), list.end());
-
-        return *this;
+    explicit set(sorted_unique_t, InputIter i, InputIter j, const key_compare& compare) : base(compare) {
+        tree_.assign_sorted_unique(i, j);
     }
 
-    set(const set& other) : tree_(other.tree_) {}
-
-    set& operator=(const set& other) {
-        if (this == &other) {
-            return *this;
-        }
+    set(sorted_unique_t, std::initializer_list<value_type> list) : set(sorted_unique, list.begin(), list.end()) {}
 
-        tree_ = other.tree_;
+    // Bulk construction from unsorted input under an execution policy. See bst::assign.
+    template<class Policy, class InputIter> requires execution::is_execution_policy_v<Policy>
+    explicit set(const Policy& policy, InputIter i, InputIter j) {
+        tree_.assign(i, j, policy);
+    }
 
-        return *this;
+    template<class Policy, class InputIter> requires execution::is_execution_policy_v<Policy>
+    explicit set(const Policy& policy, InputIter i, InputIter j, const key_compare& compare) : base(compare) {
+        tree_.assign(i, j, policy);
     }
 
-    ~set() = default;
+    // An immutable copy of the keys laid out for fast lookups (see frozen_set); it iterates in key order.
+    frozen_set<Tp, Compare, Allocator> freeze() const {
+        return frozen_set<Tp, Compare, Allocator>(sorted_unique, tree_.sorted_begin(), tree_.sorted_end(),
+                                                  this->key_comp(), this->get_allocator());
+    }
 
-    allocator_type get_allocator() const {
-        return allocator_type();
+    // Binary snapshots that reload into the exact same tree. See bst::serialize and bst::deserialize.
+    void serialize(std::ostream& out) const requires std::is_trivially_copyable_v<value_type> {
+        tree_.serialize(out);
     }
 
-    key_compare key_comp() const {
-        return key_compare();
+    template<class WriteKey>
+    void serialize(std::ostream& out, WriteKey write_key) const {
+        tree_.serialize(out, std::move(write_key));
     }
 
-    value_compare value_comp() const {
-        return value_compare();
+    size_type serialized_size() const requires std::is_trivially_copyable_v<value_type> {
+        return tree_.serialized_size();
     }
 
-    iterator begin() {
-        return tree_.cbegin();
+    void serialize(std::span<std::byte> out) const requires std::is_trivially_copyable_v<value_type> {
+        tree_.serialize(out);
     }
 
-    iterator end() {
-        return tree_.cend();
+    void deserialize(std::istream& in) requires std::is_trivially_copyable_v<value_type> {
+        tree_.deserialize(in);
     }
 
-    const_iterator cbegin() const {
-        return tree_.cbegin();
+    template<class ReadKey>
+    void deserialize(std::istream& in, ReadKey read_key) {
+        tree_.deserialize(in, std::move(read_key));
     }
 
-    const_iterator cend() const {
-        return tree_.cend();
+    void deserialize(std::span<const std::byte> in) requires std::is_trivially_copyable_v<value_type> {
+        tree_.deserialize(in);
     }
 
-    reverse_iterator rbegin() {
-        return reverse_iterator(tree_.cend());
+    insert_return_type insert(node_type&& node) {
+        return tree_.insert(std::move(node));
     }
 
-    reverse_iterator rend() {
-        return reverse_iterator(tree_.cbegin());
+    iterator insert(const_iterator hint, node_type&& node) {
+        return tree_.insert(hint, std::move(node));
     }
 
-    const_reverse_iterator crbegin() const {
-        return const_reverse_iterator(tree_.cend());
+    value_type pop_min() {
+        return tree_.pop_min();
     }
 
-    const_reverse_iterator crend() const {
-        return const_reverse_iterator(tree_.cbegin());
+    value_type pop_max() {
+        return tree_.pop_max();
     }
 
-    bool operator==(const set& other) const {
-        return std::equal(cbegin(), cend(), other.cbegin(), other.cend());
+    node_type extract(const value_type& value) {
+        return tree_.extract(value);
     }
 
-    bool operator!=(const set& other) const {
-        return !(*this == other);
+    node_type extract(const_iterator iter) {
+        return tree_.extract(iter);
     }
 
-    size_type size() const {
-        return std::distance(cbegin(), cend());
+    // Keys already present stay behind in other.
+    void merge(set& other) {
+        tree_.merge(other.tree_);
     }
 
-    size_type max_size() const {
-        return std::numeric_limits<size_type>::max();
+    void merge(set&& other) {
+        tree_.merge(other.tree_);
     }
 
-    [[nodiscard]] bool empty() const {
-        return tree_.empty();
+    // Moves every key >= key into the returned set in O(height); see bst::split.
+    set split(const key_type& key) {
+        return set(tree_.split(key));
     }
 
-    std::pair<iterator, bool> insert(const value_type& value) {
-        return tree_.insert(value);
+    template<class Key> requires transparent_comparator<Compare>
+    set split(const Key& key) {
+        return set(tree_.split(key));
     }
 
-    template<class InputIter>
-    void insert(InputIter i, InputIter j) {
-        for (InputIter iter = i; iter != j; ++iter) {
-            tree_.insert(*iter);
-        }
+    // Appends right, whose keys must all be greater than ours, and leaves it empty.
+    void concat(set& right) {
+        tree_.concat(right.tree_);
     }
 
-    void insert(std::initializer_list<value_type> list) {
-        insert(list.begin(), list.end());
+    // In-place set algebra for red-black sets; other is left empty. See bst::unite.
+    void unite(set& other) {
+        tree_.unite(other.tree_);
     }
 
-    node_type extract(const value_type& value) {
-        return tree_.extract(value);
+    template<class Pool>
+    void unite(set& other, Pool& pool) {
+        tree_.unite(other.tree_, pool);
     }
 
-    node_type extract(const_iterator iter) {
-        return tree_.extract(iter);
+    void intersect(set& other) {
+        tree_.intersect(other.tree_);
     }
 
-    void merge(const set& other) {
-        insert(other.cbegin(), other.cend());
+    template<class Pool>
+    void intersect(set& other, Pool& pool) {
+        tree_.intersect(other.tree_, pool);
     }
 
-    size_type erase(const value_type& value) {
-        return tree_.erase(value);
+    void subtract(set& other) {
+        tree_.subtract(other.tree_);
     }
 
-    iterator erase(iterator iter) {
-        return tree_.erase(iter);
+    template<class Pool>
+    void subtract(set& other, Pool& pool) {
+        tree_.subtract(other.tree_, pool);
     }
 
-    iterator erase(const_iterator q1, const_iterator q2) {
-        iterator q = q1;
-        while (q != q2) {
-            q = erase(q);
-        }
+    // Whole-set scans under an execution policy; the free for_each and transform_reduce below forward here.
+    // See bst::for_each and bst::transform_reduce.
+    template<class Policy, class Function> requires execution::is_execution_policy_v<Policy>
+    void for_each(const Policy& policy, Function function) const {
+        tree_.for_each(function, policy);
+    }
 
-        return q;
+    template<class Policy, class Result, class Reduce, class Transform>
+    requires execution::is_execution_policy_v<Policy>
+    Result transform_reduce(const Policy& policy, Result init, Reduce reduce, Transform transform) const {
+        return tree_.transform_reduce(std::move(init), reduce, transform, policy);
     }
 
-    void clear() {
-        erase(begin(), end());
+    // Many lookups at once, faster than one by one on trees that do not fit in cache; results must be at
+    // least as long as keys. See bst::find_batch.
+    void find_batch(std::span<const value_type> keys, std::span<const_iterator> results) const {
+        tree_.find_batch(keys, results);
     }
 
-    iterator find(const value_type& value) {
-        return tree_.find(value);
+    void contains_batch(std::span<const value_type> keys, std::span<bool> results) const {
+        tree_.contains_batch(keys, results);
     }
 
-    const_iterator find(const value_type& value) const {
-        return tree_.find(value);
+    const_iterator nth(size_type k) const {
+        return tree_.nth(k);
     }
 
-    size_type count(const value_type& value) const {
-        return contains(value) ? 1 : 0;
+    size_type rank(const value_type& value) const {
+        return tree_.rank(value);
     }
 
-    bool contains(const value_type& value) const {
-        return find(value) != cend();
+    template<class Key> requires transparent_comparator<Compare>
+    size_type rank(const Key& key) const {
+        return tree_.rank(key);
     }
 
-    iterator lower_bound(const value_type& value) {
-        return tree_.lower_bound(value);
+    size_type count_range(const value_type& lo, const value_type& hi) const {
+        return count_range_between(lo, hi);
     }
 
-    const_iterator lower_bound(const value_type& value) const {
-        return tree_.lower_bound(value);
+    template<class Key> requires transparent_comparator<Compare>
+    size_type count_range(const Key& lo, const Key& hi) const {
+        return count_range_between(lo, hi);
     }
 
-    iterator upper_bound(const value_type& value) {
-        return tree_.upper_bound(value);
+  private:
+    explicit set(tree_type&& tree) : base(std::move(tree)) {}
+
+    template<class Key>
+    size_type count_range_between(const Key& lo, const Key& hi) const {
+        size_type lo_rank = rank(lo);
+        size_type hi_rank = rank(hi);
+
+        return hi_rank > lo_rank ? hi_rank - lo_rank : 0;
     }
+};
+
+// Keys in one node array with 32-bit links (see compact_bst), for all three orders. Balance applies as with bst.
+template<class Tp, class Order, class Compare, class Allocator, class Balance, class Augment, class Thread>
+class set<Tp, Order, Compare, Allocator, Balance, Augment, Thread, set_backend::compact_tag>
+        : public basic_set<compact_bst<Tp, Order, Compare, Allocator, Balance>> {
+    static_assert(std::is_same_v<Augment, bst_augment::none_tag> && std::is_same_v<Thread, bst_thread::none_tag>,
+                  "set_backend::compact_tag supports neither augmentation nor threading");
 
-    const_iterator upper_bound(const value_type& value) const {
-        return tree_.upper_bound(value);
+    using base = basic_set<compact_bst<Tp, Order, Compare, Allocator, Balance>>;
+
+  public:
+    using typename base::size_type;
+
+    using base::base;
+    using base::operator=;
+
+    // Makes room for count keys up front, so filling the set never reallocates.
+    void reserve(size_type count) {
+        this->tree_.reserve(count);
     }
 
-    std::pair<iterator, iterator> equal_range(const value_type& value) {
-        return std::make_pair(lower_bound(value), upper_bound(value));
+    size_type capacity() const {
+        return this->tree_.capacity();
     }
+};
 
-    std::pair<const_iterator, const_iterator> equal_range(const value_type& value) const {
-        return std::make_pair(lower_bound(value), upper_bound(value));
+// Keys in B-tree nodes (see btree), always balanced and in key order only, whatever Order and Balance say.
+template<class Tp, class Order, class Compare, class Allocator, class Balance, class Augment, class Thread,
+        size_t NodeBytes>
+class set<Tp, Order, Compare, Allocator, Balance, Augment, Thread, set_backend::btree_tag<NodeBytes>>
+        : public basic_set<btree<Tp, Compare, Allocator, NodeBytes>> {
+    static_assert(std::is_same_v<Order, bst_order::in_order_tag>, "set_backend::btree_tag iterates in order only");
+    static_assert(std::is_same_v<Augment, bst_augment::none_tag> && std::is_same_v<Thread, bst_thread::none_tag>,
+                  "set_backend::btree_tag supports neither augmentation nor threading");
+
+    using base = basic_set<btree<Tp, Compare, Allocator, NodeBytes>>;
+
+  public:
+    using base::base;
+    using base::operator=;
+};
+
+// Versions that share their nodes (see persistent_bst), always AVL-balanced whatever Balance says, in any of the
+// three orders. Copying the set is O(1), and so is snapshot(), which only names the intent.
+template<class Tp, class Order, class Compare, class Allocator, class Balance, class Augment, class Thread>
+class set<Tp, Order, Compare, Allocator, Balance, Augment, Thread, set_backend::persistent_tag>
+        : public basic_set<persistent_bst<Tp, Order, Compare, Allocator>> {
+    static_assert(std::is_same_v<Augment, bst_augment::none_tag> && std::is_same_v<Thread, bst_thread::none_tag>,
+                  "set_backend::persistent_tag supports neither augmentation nor threading");
+
+    using base = basic_set<persistent_bst<Tp, Order, Compare, Allocator>>;
+
+  public:
+    using base::base;
+    using base::operator=;
+
+    // This version as it stands, unaffected by later updates to either copy.
+    set snapshot() const {
+        return *this;
     }
 };
 
+// Joins two sets whose key ranges do not overlap, every key of left below every key of right.
+template<class Tp, class Order, class Compare, class Allocator, class Balance, class Augment, class Thread>
+set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> concat(
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> left,
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> right) {
+    left.concat(right);
+    return left;
+}
+
+// Value-returning forms of set::unite, set::intersect and set::subtract. Pass the operands as rvalues to have
+// their nodes relinked instead of copied first.
+template<class Tp, class Order, class Compare, class Allocator, class Balance, class Augment, class Thread>
+set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> set_union(
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> lhs,
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> rhs) {
+    lhs.unite(rhs);
+    return lhs;
+}
+
+template<class Tp, class Order, class Compare, class Allocator, class Balance, class Augment, class Thread, class Pool>
+set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> set_union(
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> lhs,
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> rhs, Pool& pool) {
+    lhs.unite(rhs, pool);
+    return lhs;
+}
+
+template<class Tp, class Order, class Compare, class Allocator, class Balance, class Augment, class Thread>
+set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> set_intersection(
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> lhs,
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> rhs) {
+    lhs.intersect(rhs);
+    return lhs;
+}
+
+template<class Tp, class Order, class Compare, class Allocator, class Balance, class Augment, class Thread, class Pool>
+set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> set_intersection(
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> lhs,
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> rhs, Pool& pool) {
+    lhs.intersect(rhs, pool);
+    return lhs;
+}
+
+template<class Tp, class Order, class Compare, class Allocator, class Balance, class Augment, class Thread>
+set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> set_difference(
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> lhs,
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> rhs) {
+    lhs.subtract(rhs);
+    return lhs;
+}
+
+template<class Tp, class Order, class Compare, class Allocator, class Balance, class Augment, class Thread, class Pool>
+set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> set_difference(
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> lhs,
+        set<Tp, Order, Compare, Allocator, Balance, Augment, Thread> rhs, Pool& pool) {
+    lhs.subtract(rhs, pool);
+    return lhs;
+}
+
+// Parallel scans in the style of the <algorithm> overloads taking an execution policy.
+template<class Policy, class Tp, class Order, class Compare, class Allocator, class Balance, class Augment,
+        class Thread, class Function>
+requires execution::is_execution_policy_v<Policy>
+void for_each(const Policy& policy, const set<Tp, Order, Compare, Allocator, Balance, Augment, Thread>& my_set,
+              Function function) {
+    my_set.for_each(policy, std::move(function));
+}
+
+template<class Policy, class Tp, class Order, class Compare, class Allocator, class Balance, class Augment,
+        class Thread, class Result, class Reduce, class Transform>
+requires execution::is_execution_policy_v<Policy>
+Result transform_reduce(const Policy& policy,
+                        const set<Tp, Order, Compare, Allocator, Balance, Augment, Thread>& my_set, Result init,
+                        Reduce reduce, Transform transform) {
+    return my_set.transform_reduce(policy, std::move(init), std::move(reduce), std::move(transform));
+}
+
 } // notstd
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+// Node storage behind notstd::set. bst_tag links heap nodes by pointer and supports every set operation;
+// the other backends keep the core associative interface.
+namespace set_backend {
+
+struct bst_tag {};
+struct compact_tag {};
+
+// Nodes of several keys whose leaves fit in NodeBytes; a cache line or two for small keys, up to a page.
+template<size_t NodeBytes = 256>
+struct btree_tag {};
+
+// Reference-counted nodes shared between versions of a set, so that copies and snapshots cost O(1).
+struct persistent_tag {};
+
+} // set_backend
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace notstd {
+
+// Promises that a range is strictly increasing under the set's comparator, so it can be built without checks.
+struct sorted_unique_t {
+    explicit sorted_unique_t() = default;
+};
+
+inline constexpr sorted_unique_t sorted_unique{};
+
+} // notstd
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace notstd {
+
+// A fixed set of workers for fork-join parallelism. fork_join runs one branch on the calling thread and offers
+// the other to the workers. While it waits for the offered branch, the caller runs queued branches itself, so
+// nested forks cannot deadlock. Branches live on the forking thread's stack; queueing them never allocates.
+class thread_pool {
+  private:
+    struct task {
+        void (*invoke)(task*);
+        task* next = nullptr;
+        std::exception_ptr error;
+        std::atomic<bool> done = false;
+
+        explicit task(void (*invoke)(task*)) : invoke(invoke) {}
+    };
+
+    template<class Fn>
+    struct fn_task : task {
+        Fn& fn;
+
+        explicit fn_task(Fn& fn) : task(&fn_task::run), fn(fn) {}
+
+        static void run(task* self) {
+            static_cast<fn_task*>(self)->fn();
+        }
+    };
+
+    std::unique_ptr<std::thread[]> workers_;
+    size_t worker_count_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    task* head_ = nullptr;
+    bool stop_ = false;
+
+  public:
+    explicit thread_pool(size_t workers = std::thread::hardware_concurrency())
+            : workers_(std::make_unique<std::thread[]>(workers)), worker_count_(workers) {
+        for (size_t i = 0; i < worker_count_; ++i) {
+            workers_[i] = std::thread([this] { work(); });
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+
+        for (size_t i = 0; i < worker_count_; ++i) {
+            workers_[i].join();
+        }
+    }
+
+    // Number of worker threads, not counting callers that help out while waiting.
+    size_t size() const {
+        return worker_count_;
+    }
+
+    // Runs left() here and right() wherever a thread is free, returning once both are done. An exception from
+    // either branch is rethrown after both have finished; left's wins if both throw.
+    template<class Left, class Right>
+    void fork_join(Left&& left, Right&& right) {
+        fn_task<Right> offered(right);
+        push(&offered);
+
+        std::exception_ptr error;
+        try {
+            left();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        wait(&offered);
+
+        if (error == nullptr) {
+            error = offered.error;
+        }
+        if (error != nullptr) {
+            std::rethrow_exception(error);
+        }
+    }
+
+  private:
+    void push(task* item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            item->next = head_;
+            head_ = item;
+        }
+        wake_.notify_one();
+    }
+
+    // Newest first: the branches forked deepest are the smallest and the most likely to still be cache-hot.
+    task* try_pop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        task* item = head_;
+        if (item != nullptr) {
+            head_ = item->next;
+        }
+
+        return item;
+    }
+
+    static void execute(task* item) {
+        try {
+            item->invoke(item);
+        } catch (...) {
+            item->error = std::current_exception();
+        }
+        item->done.store(true, std::memory_order_release);
+    }
+
+    void wait(task* item) {
+        while (!item->done.load(std::memory_order_acquire)) {
+            if (task* other = try_pop(); other != nullptr) {
+                execute(other);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void work() {
+        while (true) {
+            task* item;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return stop_ || head_ != nullptr; });
+                if (head_ == nullptr) {
+                    return;
+                }
+                item = head_;
+                head_ = item->next;
+            }
+
+            execute(item);
+        }
+    }
+};
+
+} // notstd
@@ -0,0 +1,114 @@
+#include <lib/notstd/set.h>
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace notstd;
+
+template<class Tp, size_t NodeBytes, class Compare = std::less<Tp>>
+using btree_set = set<Tp, bst_order::in_order_tag, Compare, std::allocator<Tp>, bst_balance::none_tag,
+                      bst_augment::none_tag, bst_thread::none_tag, set_backend::btree_tag<NodeBytes>>;
+
+template<class Set>
+static std::vector<typename Set::value_type> Forward(Set& my_set) {
+    return std::vector<typename Set::value_type>(my_set.begin(), my_set.end());
+}
+
+template<class Set>
+static std::vector<typename Set::value_type> Backward(Set& my_set) {
+    return std::vector<typename Set::value_type>(my_set.rbegin(), my_set.rend());
+}
+
+// Four keys per node, so a few thousand keys already make a tree several levels deep.
+TEST(NotStdBTreeSetTestSuite, RandomOpsMatchStdSetTest) {
+    btree_set<int, 32> my_set;
+    std::set<int> expected;
+    std::mt19937 random(7);
+
+    for (int i = 0; i < 20000; ++i) {
+        int key = static_cast<int>(random() % 3000);
+        if (random() % 3 == 0) {
+            auto iter = my_set.find(key);
+            auto expected_iter = expected.find(key);
+            ASSERT_EQ(iter == my_set.end(), expected_iter == expected.end());
+            if (iter != my_set.end()) {
+                auto next = my_set.erase(iter);
+                auto expected_next = expected.erase(expected_iter);
+                ASSERT_EQ(next == my_set.end(), expected_next == expected.end());
+                if (next != my_set.end()) {
+                    ASSERT_EQ(*next, *expected_next);
+                }
+            }
+        } else {
+            ASSERT_EQ(my_set.insert(key).second, expected.insert(key).second);
+        }
+    }
+
+    ASSERT_EQ(my_set.size(), expected.size());
+    ASSERT_EQ(Forward(my_set), std::vector<int>(expected.begin(), expected.end()));
+    ASSERT_EQ(Backward(my_set), std::vector<int>(expected.rbegin(), expected.rend()));
+
+    for (int key = -1; key <= 3001; ++key) {
+        auto greater = expected.upper_bound(key);
+        auto not_below = expected.lower_bound(key);
+
+        auto lower = my_set.lower_bound(key);
+        if (greater == expected.begin()) {
+            ASSERT_TRUE(lower == my_set.end());
+        } else {
+            ASSERT_EQ(*lower, *std::prev(greater));
+        }
+
+        auto upper = my_set.upper_bound(key);
+        if (not_below == expected.end()) {
+            ASSERT_TRUE(upper == my_set.end());
+        } else {
+            ASSERT_EQ(*upper, *not_below);
+        }
+    }
+
+    while (!my_set.empty()) {
+        my_set.erase(my_set.begin());
+    }
+    ASSERT_TRUE(my_set.begin() == my_set.end());
+}
+
+TEST(NotStdBTreeSetTestSuite, EraseRangeTest) {
+    btree_set<int, 64> my_set;
+    for (int i = 0; i < 1000; ++i) {
+        my_set.insert(i);
+    }
+
+    auto next = my_set.erase(my_set.find(100), my_set.find(900));
+
+    ASSERT_EQ(*next, 900);
+    ASSERT_EQ(my_set.size(), 200);
+    ASSERT_EQ(*--next, 99);
+}
+
+TEST(NotStdBTreeSetTestSuite, StringKeysTest) {
+    btree_set<std::string, 32, std::less<>> my_set;
+    for (int i = 0; i < 500; ++i) {
+        my_set.emplace(std::to_string(i));
+    }
+
+    btree_set<std::string, 32, std::less<>> copy(my_set);
+    ASSERT_TRUE(copy == my_set);
+    ASSERT_TRUE(copy.contains(std::string_view("250")));
+    ASSERT_EQ(*copy.upper_bound(std::string_view("49a")), "5");
+
+    for (int i = 0; i < 500; i += 2) {
+        ASSERT_EQ(copy.erase(std::to_string(i)), 1);
+    }
+    btree_set<std::string, 32, std::less<>> moved(std::move(copy));
+    ASSERT_EQ(moved.size(), 250);
+    ASSERT_FALSE(moved.contains("250"));
+    ASSERT_TRUE(copy.empty());
+
+    my_set = moved;
+    ASSERT_EQ(Forward(my_set), Forward(moved));
+}
@@ -0,0 +1,109 @@
+#include <lib/notstd/set.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace notstd;
+
+template<class Tp, class Order, class Balance = bst_balance::red_black_tag>
+using compact_set = set<Tp, Order, std::less<Tp>, std::allocator<Tp>, Balance, bst_augment::none_tag,
+                        bst_thread::none_tag, set_backend::compact_tag>;
+
+template<class Set>
+static std::vector<typename Set::value_type> Forward(Set& my_set) {
+    return std::vector<typename Set::value_type>(my_set.begin(), my_set.end());
+}
+
+template<class Set>
+static std::vector<typename Set::value_type> Backward(Set& my_set) {
+    return std::vector<typename Set::value_type>(my_set.rbegin(), my_set.rend());
+}
+
+// Runs the same inserts and erases on a compact and a pointer-linked set, which must then agree node for node.
+template<class Order, class Balance>
+static void ExpectSameShape() {
+    compact_set<int, Order, Balance> compact;
+    set<int, Order, std::less<int>, std::allocator<int>, Balance> linked;
+
+    for (int i = 0; i < 2000; ++i) {
+        int key = static_cast<int>((i * 7919u) % 1500);
+        if (i % 5 == 4) {
+            compact.erase(key);
+            linked.erase(key);
+        } else {
+            compact.insert(key);
+            linked.insert(key);
+        }
+    }
+
+    ASSERT_EQ(compact.size(), linked.size());
+    ASSERT_EQ(Forward(compact), Forward(linked));
+    ASSERT_EQ(Backward(compact), Backward(linked));
+}
+
+TEST(NotStdCompactSetTestSuite, NodeSizeTest) {
+    ASSERT_EQ(sizeof(compact_node<uint32_t>), 16);
+    ASSERT_EQ(sizeof(compact_node<uint64_t>), 24);
+}
+
+TEST(NotStdCompactSetTestSuite, OrdersMatchBstTest) {
+    ExpectSameShape<bst_order::in_order_tag, bst_balance::none_tag>();
+    ExpectSameShape<bst_order::pre_order_tag, bst_balance::none_tag>();
+    ExpectSameShape<bst_order::post_order_tag, bst_balance::none_tag>();
+    ExpectSameShape<bst_order::in_order_tag, bst_balance::red_black_tag>();
+    ExpectSameShape<bst_order::pre_order_tag, bst_balance::red_black_tag>();
+    ExpectSameShape<bst_order::post_order_tag, bst_balance::red_black_tag>();
+}
+
+TEST(NotStdCompactSetTestSuite, IteratorsSurviveGrowthTest) {
+    compact_set<std::string, bst_order::in_order_tag> my_set;
+    my_set.insert("m");
+    auto iter = my_set.find("m");
+
+    for (int i = 0; i < 1000; ++i) {
+        my_set.insert(std::to_string(i));
+    }
+
+    ASSERT_GE(my_set.capacity(), 1001);
+    ASSERT_EQ(*iter, "m");
+    ASSERT_EQ(*--iter, "999");
+}
+
+TEST(NotStdCompactSetTestSuite, FreeSlotsReusedTest) {
+    compact_set<int, bst_order::in_order_tag> my_set;
+    my_set.reserve(100);
+    for (int i = 0; i < 100; ++i) {
+        my_set.insert(i);
+    }
+    for (int i = 0; i < 100; i += 2) {
+        my_set.erase(i);
+    }
+    for (int i = 100; i < 150; ++i) {
+        my_set.insert(i);
+    }
+
+    ASSERT_EQ(my_set.capacity(), 100);
+    ASSERT_EQ(my_set.size(), 100);
+    ASSERT_EQ(*my_set.lower_bound(98), 97);
+    ASSERT_EQ(*my_set.upper_bound(98), 99);
+}
+
+TEST(NotStdCompactSetTestSuite, CopyAndMoveTest) {
+    compact_set<std::string, bst_order::pre_order_tag> my_set = {"b", "a", "c", "d"};
+    my_set.erase("c");
+
+    compact_set<std::string, bst_order::pre_order_tag> copy(my_set);
+    ASSERT_TRUE(copy == my_set);
+
+    copy.insert("e");
+    compact_set<std::string, bst_order::pre_order_tag> moved(std::move(copy));
+    ASSERT_EQ(Forward(moved), std::vector<std::string>({"b", "a", "d", "e"}));
+    ASSERT_TRUE(copy.empty());
+
+    my_set = moved;
+    ASSERT_TRUE(my_set == moved);
+    my_set.clear();
+    ASSERT_TRUE(my_set.begin() == my_set.end());
+}
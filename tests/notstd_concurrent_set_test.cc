@@ -0,0 +1,101 @@
+#include <lib/notstd/concurrent/concurrent_set.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace notstd;
+
+TEST(NotStdConcurrentSetTestSuite, MatchesStdSetTest) {
+    concurrent_set<int> my_set;
+    std::set<int> expected;
+    std::mt19937 random(11);
+
+    for (int i = 0; i < 20000; ++i) {
+        int key = static_cast<int>(random() % 2000);
+        if (random() % 3 == 0) {
+            ASSERT_EQ(my_set.erase(key), expected.erase(key));
+        } else {
+            ASSERT_EQ(my_set.insert(key), expected.insert(key).second);
+        }
+    }
+
+    ASSERT_EQ(my_set.size(), expected.size());
+    auto snapshot = my_set.read();
+    ASSERT_EQ(std::vector<int>(snapshot.begin(), snapshot.end()), std::vector<int>(expected.begin(), expected.end()));
+    for (int key = 0; key < 2000; ++key) {
+        ASSERT_EQ(snapshot.contains(key), expected.count(key) == 1);
+    }
+
+    auto iter = snapshot.find(*expected.begin());
+    ASSERT_EQ(std::vector<int>(iter, snapshot.end()), std::vector<int>(expected.begin(), expected.end()));
+}
+
+TEST(NotStdConcurrentSetTestSuite, SnapshotIsStableTest) {
+    concurrent_set<std::string> my_set;
+    for (int i = 0; i < 100; ++i) {
+        my_set.insert(std::to_string(i));
+    }
+
+    auto snapshot = my_set.read();
+    for (int i = 0; i < 100; i += 2) {
+        my_set.erase(std::to_string(i));
+    }
+    my_set.insert("x");
+
+    ASSERT_EQ(std::distance(snapshot.begin(), snapshot.end()), 100);
+    ASSERT_TRUE(snapshot.contains("0"));
+    ASSERT_FALSE(snapshot.contains("x"));
+    ASSERT_FALSE(my_set.contains("0"));
+    ASSERT_TRUE(my_set.contains("x"));
+    ASSERT_EQ(*snapshot.find("98"), "98");
+    ASSERT_TRUE(snapshot.find("x") == snapshot.end());
+}
+
+// Readers run while the writer churns odd keys; the even keys, never touched, must always all be there, in order.
+TEST(NotStdConcurrentSetTestSuite, ReadersDuringWritesTest) {
+    concurrent_set<int> my_set;
+    for (int i = 0; i < 1000; i += 2) {
+        my_set.insert(i);
+    }
+
+    std::atomic<bool> stop = false;
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < 4; ++reader) {
+        readers.emplace_back([&] {
+            while (!stop.load()) {
+                auto snapshot = my_set.read();
+                int evens = 0;
+                int last = -1;
+                for (int key : snapshot) {
+                    failures += (key <= last);
+                    evens += (key % 2 == 0);
+                    last = key;
+                }
+                failures += (evens != 500);
+                failures += !my_set.contains(500);
+            }
+        });
+    }
+
+    for (int round = 0; round < 50; ++round) {
+        for (int i = 1; i < 1000; i += 2) {
+            my_set.insert(i);
+        }
+        for (int i = 1; i < 1000; i += 2) {
+            my_set.erase(i);
+        }
+    }
+    stop = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    ASSERT_EQ(failures.load(), 0);
+    ASSERT_EQ(my_set.size(), 500);
+}
@@ -0,0 +1,115 @@
+#include <lib/notstd/set.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace notstd;
+
+// Every size from empty to a few full levels and beyond, against the set it was frozen from.
+TEST(NotStdFrozenSetTestSuite, MatchesSourceSetTest) {
+    for (int count = 0; count < 70; ++count) {
+        set<int, bst_order::pre_order_tag, std::less<int>, std::allocator<int>, bst_balance::red_black_tag> my_set;
+        for (int i = 0; i < count; ++i) {
+            my_set.insert(3 * ((i * 7919) % count));
+        }
+
+        frozen_set<int> frozen = my_set.freeze();
+        std::vector<int> sorted;
+        for (int i = 0; i < count; ++i) {
+            sorted.push_back(3 * i);
+        }
+
+        ASSERT_EQ(frozen.size(), my_set.size());
+        ASSERT_EQ(std::vector<int>(frozen.begin(), frozen.end()), sorted);
+        ASSERT_EQ(std::vector<int>(frozen.rbegin(), frozen.rend()), std::vector<int>(sorted.rbegin(), sorted.rend()));
+
+        for (int key = -2; key <= 3 * count + 2; ++key) {
+            ASSERT_EQ(frozen.contains(key), my_set.contains(key));
+            ASSERT_EQ(frozen.find(key) == frozen.end(), my_set.find(key) == my_set.end());
+
+            auto lower = frozen.lower_bound(key);
+            auto expected_lower = my_set.lower_bound(key);
+            ASSERT_EQ(lower == frozen.end(), expected_lower == my_set.end());
+            if (lower != frozen.end()) {
+                ASSERT_EQ(*lower, *expected_lower);
+            }
+
+            auto upper = frozen.upper_bound(key);
+            auto expected_upper = my_set.upper_bound(key);
+            ASSERT_EQ(upper == frozen.end(), expected_upper == my_set.end());
+            if (upper != frozen.end()) {
+                ASSERT_EQ(*upper, *expected_upper);
+            }
+        }
+    }
+}
+
+template<class Tp>
+static void ExpectBatchMatchesSingle(Tp base) {
+    for (int count : {0, 1, 7, 8, 9, 100, 1023, 1024, 5000}) {
+        set<Tp> my_set;
+        for (int i = 0; i < count; ++i) {
+            my_set.insert(static_cast<Tp>(base + static_cast<Tp>(2 * i)));
+        }
+        frozen_set<Tp> frozen = my_set.freeze();
+
+        std::vector<Tp> keys;
+        for (int i = -3; i < 2 * count + 20; ++i) {
+            keys.push_back(static_cast<Tp>(base + static_cast<Tp>(i)));
+        }
+        std::vector<bool> expected;
+        for (Tp key : keys) {
+            expected.push_back(frozen.contains(key));
+        }
+
+        std::unique_ptr<bool[]> out(new bool[keys.size()]);
+        frozen.contains_batch(keys, std::span<bool>(out.get(), keys.size()));
+        for (size_t i = 0; i < keys.size(); ++i) {
+            ASSERT_EQ(out[i], expected[i]) << "count " << count << ", key " << keys[i];
+        }
+    }
+}
+
+TEST(NotStdFrozenSetTestSuite, ContainsBatchTest) {
+    ExpectBatchMatchesSingle<int32_t>(-1000);
+    ExpectBatchMatchesSingle<uint32_t>(0x7ffffff0u);
+    ExpectBatchMatchesSingle<int64_t>(-5);
+}
+
+TEST(NotStdFrozenSetTestSuite, TransparentLookupTest) {
+    set<std::string, bst_order::in_order_tag, std::less<>> my_set = {"pear", "apple", "fig", "plum"};
+    frozen_set<std::string, std::less<>> frozen = my_set.freeze();
+
+    ASSERT_TRUE(frozen.contains(std::string_view("fig")));
+    ASSERT_FALSE(frozen.contains("kiwi"));
+    ASSERT_EQ(*frozen.lower_bound(std::string_view("kiwi")), "fig");
+    ASSERT_EQ(*frozen.upper_bound("kiwi"), "pear");
+    ASSERT_TRUE(frozen.lower_bound("a") == frozen.end());
+}
+
+TEST(NotStdFrozenSetTestSuite, CopyAndMoveTest) {
+    set<std::string> my_set = {"pear", "apple", "fig", "plum", "kiwi"};
+    frozen_set<std::string> frozen = my_set.freeze();
+
+    frozen_set<std::string> copy = frozen;
+    ASSERT_TRUE(copy == frozen);
+    ASSERT_EQ(std::vector<std::string>(copy.begin(), copy.end()),
+              std::vector<std::string>(my_set.begin(), my_set.end()));
+
+    frozen_set<std::string> moved = std::move(copy);
+    ASSERT_TRUE(moved == frozen);
+    ASSERT_TRUE(copy.empty());
+    ASSERT_FALSE(copy.contains("fig"));
+
+    copy = moved;
+    moved = frozen_set<std::string>();
+    ASSERT_TRUE(moved.empty());
+    ASSERT_TRUE(moved.begin() == moved.end());
+    ASSERT_TRUE(copy == frozen);
+    ASSERT_FALSE(copy == moved);
+}
@@ -0,0 +1,93 @@
+#include <lib/notstd/concurrent/lockfree_set.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace notstd;
+
+TEST(NotStdLockfreeSetTestSuite, MatchesStdSetTest) {
+    lockfree_set<std::string> my_set;
+    std::set<std::string> expected;
+    std::mt19937 random(5);
+
+    for (int i = 0; i < 20000; ++i) {
+        std::string key = std::to_string(random() % 2000);
+        if (random() % 3 == 0) {
+            ASSERT_EQ(my_set.erase(key), expected.erase(key));
+        } else {
+            ASSERT_EQ(my_set.insert(key), expected.insert(key).second);
+        }
+    }
+
+    ASSERT_EQ(my_set.size(), expected.size());
+    for (int key = 0; key < 2000; ++key) {
+        ASSERT_EQ(my_set.contains(std::to_string(key)), expected.count(std::to_string(key)) == 1);
+    }
+}
+
+// Every thread owns the keys equal to its index modulo the thread count, inserts them all and erases every
+// other one; at the end the survivors of all threads must be there and nothing else.
+TEST(NotStdLockfreeSetTestSuite, DisjointWritersTest) {
+    const int threads = 4;
+    const int keys = 20000;
+    lockfree_set<int> my_set;
+
+    std::vector<std::thread> writers;
+    for (int thread = 0; thread < threads; ++thread) {
+        writers.emplace_back([&, thread] {
+            for (int i = thread; i < keys; i += threads) {
+                my_set.insert(i * 7919 % keys);
+            }
+            for (int i = thread; i < keys; i += 2 * threads) {
+                my_set.erase(i * 7919 % keys);
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+
+    ASSERT_EQ(my_set.size(), keys / 2);
+    for (int i = 0; i < keys; ++i) {
+        ASSERT_EQ(my_set.contains(i * 7919 % keys), (i % (2 * threads)) >= threads);
+    }
+}
+
+// All threads fight over the same few keys. A key must end up present exactly when its successful inserts
+// outnumber its successful erases, which can only hold if every insert and erase took effect atomically.
+TEST(NotStdLockfreeSetTestSuite, ContendedKeysTest) {
+    const int threads = 4;
+    const int keys = 16;
+    lockfree_set<int> my_set;
+    std::vector<std::atomic<int>> balance(keys);
+
+    std::vector<std::thread> writers;
+    for (int thread = 0; thread < threads; ++thread) {
+        writers.emplace_back([&, thread] {
+            std::mt19937 random(thread);
+            for (int i = 0; i < 50000; ++i) {
+                int key = static_cast<int>(random() % keys);
+                if (random() % 2 == 0) {
+                    balance[key] += my_set.insert(key) ? 1 : 0;
+                } else {
+                    balance[key] -= static_cast<int>(my_set.erase(key));
+                }
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+
+    size_t present = 0;
+    for (int key = 0; key < keys; ++key) {
+        ASSERT_EQ(balance[key].load(), my_set.contains(key) ? 1 : 0);
+        present += my_set.contains(key);
+    }
+    ASSERT_EQ(my_set.size(), present);
+}
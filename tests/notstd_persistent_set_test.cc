@@ -0,0 +1,239 @@
+#include <lib/notstd/set.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace notstd;
+
+template<class Tp, class Order = bst_order::in_order_tag, class Allocator = std::allocator<Tp>>
+using persistent_set = set<Tp, Order, std::less<Tp>, Allocator, bst_balance::none_tag, bst_augment::none_tag,
+                           bst_thread::none_tag, set_backend::persistent_tag>;
+
+// Counts allocations in a counter shared by every copy.
+template<class Tp>
+struct CountingAllocator : std::allocator<Tp> {
+    using value_type = Tp;
+
+    template<class Other>
+    struct rebind {
+        using other = CountingAllocator<Other>;
+    };
+
+    std::shared_ptr<long> count = std::make_shared<long>(0);
+
+    CountingAllocator() = default;
+
+    template<class Other>
+    CountingAllocator(const CountingAllocator<Other>& other) : count(other.count) {}
+
+    Tp* allocate(size_t n) {
+        ++*count;
+        return std::allocator<Tp>().allocate(n);
+    }
+};
+
+struct ShapeNode {
+    int key;
+    std::unique_ptr<ShapeNode> left;
+    std::unique_ptr<ShapeNode> right;
+};
+
+// The search tree a pre-order sequence of distinct keys describes; there is exactly one.
+static std::unique_ptr<ShapeNode> FromPreOrder(const std::vector<int>& keys, size_t& next, int bound) {
+    if (next == keys.size() || keys[next] > bound) {
+        return nullptr;
+    }
+
+    auto node = std::make_unique<ShapeNode>();
+    node->key = keys[next++];
+    node->left = FromPreOrder(keys, next, node->key);
+    node->right = FromPreOrder(keys, next, bound);
+    return node;
+}
+
+static int PostOrder(const ShapeNode* node, std::vector<int>& keys) {
+    if (node == nullptr) {
+        return 0;
+    }
+    int left = PostOrder(node->left.get(), keys);
+    int right = PostOrder(node->right.get(), keys);
+    keys.push_back(node->key);
+    return 1 + std::max(left, right);
+}
+
+template<class Order>
+static std::vector<int> Churn(persistent_set<int, Order>& my_set) {
+    for (int i = 0; i < 3000; ++i) {
+        int key = static_cast<int>((i * 7919u) % 2000);
+        if (i % 4 == 3) {
+            my_set.erase(key);
+        } else {
+            my_set.insert(key);
+        }
+    }
+
+    std::vector<int> keys(my_set.begin(), my_set.end());
+    std::vector<int> backward(my_set.rbegin(), my_set.rend());
+    std::reverse(backward.begin(), backward.end());
+    EXPECT_EQ(keys, backward);
+    return keys;
+}
+
+// The pre-order sequence must describe a tree that is balanced and whose post-order the post-order set reports,
+// both sets having been through the same updates.
+TEST(NotStdPersistentSetTestSuite, OrdersAgreeTest) {
+    persistent_set<int, bst_order::in_order_tag> in_order;
+    persistent_set<int, bst_order::pre_order_tag> pre_order;
+    persistent_set<int, bst_order::post_order_tag> post_order;
+
+    std::vector<int> sorted = Churn(in_order);
+    std::vector<int> pre = Churn(pre_order);
+    std::vector<int> post = Churn(post_order);
+    ASSERT_TRUE(std::is_sorted(sorted.begin(), sorted.end()));
+
+    size_t next = 0;
+    std::unique_ptr<ShapeNode> root = FromPreOrder(pre, next, std::numeric_limits<int>::max());
+    ASSERT_EQ(next, pre.size());
+
+    std::vector<int> expected_post;
+    int height = PostOrder(root.get(), expected_post);
+    ASSERT_EQ(post, expected_post);
+    ASSERT_LE(height, 1.45 * std::log2(sorted.size() + 2));
+
+    std::sort(pre.begin(), pre.end());
+    ASSERT_EQ(pre, sorted);
+}
+
+TEST(NotStdPersistentSetTestSuite, BoundsAndEraseTest) {
+    persistent_set<int> my_set = {1, 3, 6, 11, 15};
+
+    ASSERT_EQ(*my_set.lower_bound(5), 3);
+    ASSERT_EQ(*my_set.lower_bound(6), 6);
+    ASSERT_TRUE(my_set.lower_bound(0) == my_set.end());
+    ASSERT_EQ(*my_set.upper_bound(7), 11);
+    ASSERT_TRUE(my_set.upper_bound(16) == my_set.end());
+
+    auto next = my_set.erase(my_set.find(6));
+    ASSERT_EQ(*next, 11);
+    next = my_set.erase(my_set.find(3), my_set.find(15));
+    ASSERT_EQ(*next, 15);
+    ASSERT_EQ(std::vector<int>(my_set.begin(), my_set.end()), std::vector<int>({1, 15}));
+    ASSERT_TRUE(my_set.erase(my_set.find(15)) == my_set.end());
+
+    // A range erase copies the shared nodes it changes and leaves the snapshot alone.
+    persistent_set<int> big_set;
+    for (int i = 0; i < 1000; ++i) {
+        big_set.insert(i);
+    }
+    persistent_set<int> snapshot = big_set;
+    next = big_set.erase(big_set.find(100), big_set.find(900));
+    ASSERT_EQ(*next, 900);
+    ASSERT_EQ(big_set.size(), 200);
+    ASSERT_EQ(*std::prev(next), 99);
+    ASSERT_TRUE(big_set.erase(big_set.find(950), big_set.end()) == big_set.end());
+    ASSERT_EQ(*big_set.rbegin(), 949);
+    ASSERT_EQ(snapshot.size(), 1000);
+    ASSERT_EQ(std::vector<int>(snapshot.begin(), snapshot.end()).back(), 999);
+}
+
+TEST(NotStdPersistentSetTestSuite, SnapshotsAreIndependentTest) {
+    persistent_set<std::string> my_set;
+    std::set<std::string> expected;
+    std::vector<persistent_set<std::string>> snapshots;
+    std::vector<std::set<std::string>> expected_snapshots;
+
+    for (int i = 0; i < 2000; ++i) {
+        std::string key = std::to_string((i * 7919) % 700);
+        if (i % 3 == 2) {
+            my_set.erase(key);
+            expected.erase(key);
+        } else {
+            my_set.insert(key);
+            expected.insert(key);
+        }
+        if (i % 100 == 0) {
+            snapshots.push_back(my_set.snapshot());
+            expected_snapshots.push_back(expected);
+        }
+    }
+
+    // Updating a snapshot leaves the set it came from alone.
+    snapshots.back().insert("x");
+    snapshots.back().erase(*expected.begin());
+    ASSERT_TRUE(my_set.contains(*expected.begin()));
+    ASSERT_FALSE(my_set.contains("x"));
+
+    ASSERT_EQ(std::vector<std::string>(my_set.begin(), my_set.end()),
+              std::vector<std::string>(expected.begin(), expected.end()));
+    for (size_t i = 0; i + 1 < snapshots.size(); ++i) {
+        ASSERT_EQ(snapshots[i].size(), expected_snapshots[i].size());
+        ASSERT_EQ(std::vector<std::string>(snapshots[i].begin(), snapshots[i].end()),
+                  std::vector<std::string>(expected_snapshots[i].begin(), expected_snapshots[i].end()));
+    }
+}
+
+TEST(NotStdPersistentSetTestSuite, SnapshotSharesNodesTest) {
+    CountingAllocator<int> alloc;
+    persistent_set<int, bst_order::in_order_tag, CountingAllocator<int>> my_set(alloc);
+    for (int i = 0; i < 10000; ++i) {
+        my_set.insert(i);
+    }
+    ASSERT_EQ(*alloc.count, 10000);
+
+    {
+        auto snapshot = my_set.snapshot();
+        ASSERT_EQ(*alloc.count, 10000);
+
+        // The path down to the new key is copied, about log2(n) nodes, and nothing else.
+        my_set.insert(10000);
+        ASSERT_GT(*alloc.count, 10000 + 10);
+        ASSERT_LE(*alloc.count, 10000 + 20);
+        ASSERT_EQ(snapshot.size(), 10000);
+        ASSERT_FALSE(snapshot.contains(10000));
+    }
+
+    // With the snapshot gone every node is the set's own again and updates happen in place.
+    long before = *alloc.count;
+    my_set.insert(10001);
+    my_set.erase(5000);
+    ASSERT_EQ(*alloc.count, before + 1);
+}
+
+// Readers on other threads walk snapshots they took while the owning thread keeps updating the set.
+TEST(NotStdPersistentSetTestSuite, SnapshotsAcrossThreadsTest) {
+    persistent_set<int> my_set;
+    for (int i = 0; i < 1000; ++i) {
+        my_set.insert(2 * i);
+    }
+
+    std::vector<std::thread> readers;
+    for (int round = 0; round < 4; ++round) {
+        auto snapshot = my_set.snapshot();
+        readers.emplace_back([snapshot = std::move(snapshot)]() mutable {
+            for (int pass = 0; pass < 20; ++pass) {
+                std::vector<int> keys(snapshot.begin(), snapshot.end());
+                EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+                EXPECT_EQ(keys.size(), snapshot.size());
+                snapshot.insert(-pass - 1);
+            }
+        });
+        for (int i = 0; i < 500; ++i) {
+            my_set.erase(2 * (round * 250 + i % 250));
+            my_set.insert(2 * (round * 250 + i % 250) + 1);
+        }
+    }
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    ASSERT_EQ(my_set.size(), 1000);
+    ASSERT_TRUE(my_set.contains(1));
+    ASSERT_FALSE(my_set.contains(0));
+}
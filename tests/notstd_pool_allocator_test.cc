@@ -0,0 +1,79 @@
+#include <lib/notstd/pool_allocator.h>
+#include <lib/notstd/set.h>
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace notstd;
+
+TEST(NotStdPoolAllocatorTestSuite, RecycleTest) {
+    pool_allocator<long> alloc;
+
+    long* first = alloc.allocate(1);
+    long* second = alloc.allocate(1);
+
+    ASSERT_NE(first, second);
+
+    alloc.deallocate(first, 1);
+
+    ASSERT_EQ(alloc.allocate(1), first);
+
+    long* array = alloc.allocate(16);
+    array[15] = 1;
+    alloc.deallocate(array, 16);
+    alloc.deallocate(second, 1);
+}
+
+TEST(NotStdPoolAllocatorTestSuite, EqualityTest) {
+    pool_allocator<int> alloc1;
+    pool_allocator<int> alloc2(alloc1);
+    pool_allocator<int> alloc3;
+
+    ASSERT_TRUE(alloc1 == alloc2);
+    ASSERT_TRUE(alloc1 != alloc3);
+    ASSERT_TRUE(alloc1 != alloc1.select_on_container_copy_construction());
+}
+
+TEST(NotStdPoolAllocatorTestSuite, RebindSharesArenaTest) {
+    pool_allocator<int> alloc;
+    pool_allocator<double> rebound(alloc);
+    pool_allocator<int> back(rebound);
+
+    ASSERT_TRUE(rebound == alloc);
+    ASSERT_TRUE(back == alloc);
+
+    int* value = back.allocate(1);
+    alloc.deallocate(value, 1);
+    ASSERT_EQ(alloc.allocate(1), value);
+    alloc.deallocate(value, 1);
+
+    using pool_set = set<int, bst_order::in_order_tag, std::less<int>, pool_allocator<int>>;
+    pool_set my_set(alloc);
+    my_set.insert(1);
+
+    ASSERT_TRUE(my_set.get_allocator() == alloc);
+    ASSERT_TRUE(my_set.extract(1).get_allocator() == alloc);
+}
+
+TEST(NotStdPoolAllocatorTestSuite, SetTest) {
+    using pool_set = set<std::string, bst_order::in_order_tag, std::less<std::string>, pool_allocator<std::string, 1024>,
+                         bst_balance::red_black_tag>;
+
+    pool_set my_set;
+    for (int i = 0; i < 1000; ++i) {
+        my_set.insert(std::to_string(i));
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        my_set.erase(std::to_string(i));
+    }
+    for (int i = 0; i < 1000; i += 4) {
+        my_set.insert(std::to_string(i));
+    }
+
+    pool_set copy(my_set);
+
+    ASSERT_EQ(my_set.size(), 750);
+    ASSERT_TRUE(copy == my_set);
+    ASSERT_TRUE(copy.contains("996"));
+    ASSERT_FALSE(copy.contains("998"));
+}
@@ -1,8 +1,179 @@
 #include <lib/notstd/set.h>
+#include <lib/notstd/thread_pool.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
 using namespace notstd;
 
+template<class Tp, class Order>
+using rb_set = set<Tp, Order, std::less<Tp>, std::allocator<Tp>, bst_balance::red_black_tag>;
+
+template<class Tp, class Balance = bst_balance::red_black_tag>
+using ranked_set = set<Tp, bst_order::in_order_tag, std::less<Tp>, std::allocator<Tp>, Balance, bst_augment::size_tag>;
+
+// Rebuilds the tree shape from a pre-order sequence of distinct keys and returns its height.
+static size_t HeightFromPreOrder(const std::vector<int>& pre_order) {
+    std::vector<std::pair<int, size_t>> path;
+    size_t height = 0;
+
+    for (int key : pre_order) {
+        size_t depth = 1;
+        if (!path.empty() && key < path.back().first) {
+            depth = path.back().second + 1;
+        } else {
+            while (!path.empty() && path.back().first < key) {
+                depth = path.back().second + 1;
+                path.pop_back();
+            }
+        }
+        path.emplace_back(key, depth);
+        height = std::max(height, depth);
+    }
+
+    return height;
+}
+
+static void PostOrderFromPreOrder(const std::vector<int>& pre_order, size_t& pos, int upper, std::vector<int>& out) {
+    if (pos == pre_order.size() || pre_order[pos] > upper) {
+        return;
+    }
+
+    int key = pre_order[pos++];
+    PostOrderFromPreOrder(pre_order, pos, key, out);
+    PostOrderFromPreOrder(pre_order, pos, upper, out);
+    out.push_back(key);
+}
+
+struct Tracked {
+    static inline int copies = 0;
+    static inline int constructions = 0;
+
+    int value;
+
+    explicit Tracked(int value) : value(value) {
+        ++constructions;
+    }
+
+    Tracked(const Tracked& other) : value(other.value) {
+        ++copies;
+    }
+
+    Tracked(Tracked&& other) noexcept : value(other.value) {}
+
+    bool operator<(const Tracked& other) const {
+        return value < other.value;
+    }
+};
+
+// Throws from the copy constructor once copies_left runs out; live counts the instances in existence.
+struct Fragile {
+    static inline int live = 0;
+    static inline int copies_left = -1;
+
+    int value;
+
+    explicit Fragile(int value) : value(value) {
+        ++live;
+    }
+
+    Fragile(const Fragile& other) : value(other.value) {
+        if (copies_left == 0) {
+            throw std::runtime_error("copy failed");
+        }
+        --copies_left;
+        ++live;
+    }
+
+    ~Fragile() {
+        --live;
+    }
+
+    bool operator<(const Fragile& other) const {
+        return value < other.value;
+    }
+};
+
+static int counted_allocations = 0;
+
+template<class Tp>
+struct CountingAllocator : std::allocator<Tp> {
+    template<class Up>
+    struct rebind {
+        using other = CountingAllocator<Up>;
+    };
+
+    CountingAllocator() = default;
+
+    template<class Up>
+    CountingAllocator(const CountingAllocator<Up>&) {}
+
+    Tp* allocate(size_t n) {
+        ++counted_allocations;
+        return std::allocator<Tp>::allocate(n);
+    }
+};
+
+// Allocators with different ids never compare equal; allocation throws once allocation_budget runs out.
+static int allocation_budget = -1;
+
+template<class Tp>
+struct BudgetAllocator {
+    using value_type = Tp;
+    using is_always_equal = std::false_type;
+
+    int id = 0;
+
+    BudgetAllocator() = default;
+
+    explicit BudgetAllocator(int id) : id(id) {}
+
+    template<class Up>
+    BudgetAllocator(const BudgetAllocator<Up>& other) : id(other.id) {}
+
+    Tp* allocate(size_t n) {
+        if (allocation_budget == 0) {
+            throw std::bad_alloc();
+        }
+        --allocation_budget;
+        return std::allocator<Tp>().allocate(n);
+    }
+
+    void deallocate(Tp* ptr, size_t n) {
+        std::allocator<Tp>().deallocate(ptr, n);
+    }
+
+    template<class Up>
+    bool operator==(const BudgetAllocator<Up>& other) const {
+        return id == other.id;
+    }
+};
+
+struct CountingLess {
+    static inline size_t calls = 0;
+
+    bool operator()(int lhs, int rhs) const {
+        ++calls;
+        return lhs < rhs;
+    }
+};
+
+template<class Set>
+static std::vector<int> Forward(const Set& my_set) {
+    return std::vector<int>(my_set.cbegin(), my_set.cend());
+}
+
+template<class Set>
+static std::vector<int> Backward(const Set& my_set) {
+    return std::vector<int>(my_set.crbegin(), my_set.crend());
+}
+
 TEST(NotStdSetTestSuite, EmptyTest) {
     set<int> my_set;
 
@@ -381,15 +552,15 @@ TEST(NotStdSetTestSuite, EraseRangeTest) {
 TEST(NotStdSetTestSuite, ExtractValueTest) {
     set<int> my_set = {1, 3, 6, 9, 10, 11, 14, 15};
 
-    bst_node<int> node = my_set.extract(6);
+    set<int>::node_type node = my_set.extract(6);
 
     ASSERT_TRUE(my_set.find(6) == my_set.end());
 
-    ASSERT_TRUE(node.key == 6);
+    ASSERT_TRUE(node.value() == 6);
 
     node = my_set.extract(20);
 
-    ASSERT_EQ(node.key, 0);
+    ASSERT_TRUE(node.empty());
 }
 
 TEST(NotStdSetTestSuite, ExtractIteratorTest) {
@@ -397,17 +568,17 @@ TEST(NotStdSetTestSuite, ExtractIteratorTest) {
 
     set<int>::iterator iter = my_set.find(6);
 
-    bst_node<int> node = my_set.extract(iter);
+    set<int>::node_type node = my_set.extract(iter);
 
     ASSERT_TRUE(my_set.find(6) == my_set.end());
 
-    ASSERT_TRUE(node.key == 6);
+    ASSERT_TRUE(node.value() == 6);
 
     iter = my_set.find(20);
 
     node = my_set.extract(iter);
 
-    ASSERT_EQ(node.key, 0);
+    ASSERT_TRUE(node.empty());
 }
 
 TEST(NotStdSetTestSuite, ClearTest) {
@@ -481,3 +652,1177 @@ TEST(NotStdSetTestSuite, MergeTest) {
 
     ASSERT_TRUE(my_set.contains(4));
 }
+
+TEST(NotStdSetTestSuite, RedBlackSortedInsertHeightTest) {
+    rb_set<int, bst_order::pre_order_tag> my_set;
+
+    for (int i = 0; i < (1 << 16); ++i) {
+        my_set.insert(i);
+    }
+
+    ASSERT_EQ(my_set.size(), 1 << 16);
+    ASSERT_LE(HeightFromPreOrder(Forward(my_set)), 2 * 17);
+}
+
+TEST(NotStdSetTestSuite, RedBlackTraversalTest) {
+    rb_set<int, bst_order::in_order_tag> in_order;
+    rb_set<int, bst_order::pre_order_tag> pre_order;
+    rb_set<int, bst_order::post_order_tag> post_order;
+
+    for (int i = 0; i < 2000; ++i) {
+        int key = (i * 7919) % 2003;
+        in_order.insert(key);
+        pre_order.insert(key);
+        post_order.insert(key);
+    }
+    for (int i = 0; i < 2003; i += 3) {
+        in_order.erase(i);
+        pre_order.erase(i);
+        post_order.erase(i);
+    }
+
+    std::vector<int> sorted = Forward(in_order);
+    ASSERT_TRUE(std::is_sorted(sorted.begin(), sorted.end()));
+    ASSERT_EQ(sorted.size(), in_order.size());
+
+    std::vector<int> pre = Forward(pre_order);
+    std::vector<int> post;
+    size_t pos = 0;
+    PostOrderFromPreOrder(pre, pos, std::numeric_limits<int>::max(), post);
+
+    ASSERT_EQ(pre.size(), sorted.size());
+    ASSERT_EQ(post, Forward(post_order));
+    ASSERT_LE(HeightFromPreOrder(pre), 2 * 11);
+
+    std::vector<int> reversed = Backward(in_order);
+    ASSERT_TRUE(std::equal(sorted.rbegin(), sorted.rend(), reversed.begin(), reversed.end()));
+    reversed = Backward(pre_order);
+    ASSERT_TRUE(std::equal(pre.rbegin(), pre.rend(), reversed.begin(), reversed.end()));
+    reversed = Backward(post_order);
+    ASSERT_TRUE(std::equal(post.rbegin(), post.rend(), reversed.begin(), reversed.end()));
+}
+
+TEST(NotStdSetTestSuite, RedBlackEraseTest) {
+    rb_set<int, bst_order::in_order_tag> my_set = {50, 30, 70, 23, 35, 80, 11, 25, 31, 42, 73, 85};
+
+    rb_set<int, bst_order::in_order_tag>::iterator iter = my_set.erase(my_set.find(30));
+
+    ASSERT_EQ(*iter, 31);
+    ASSERT_FALSE(my_set.contains(30));
+
+    my_set.erase(my_set.find(11), my_set.find(50));
+
+    std::stringstream ss;
+    for (int key : my_set) {
+        ss << key << ' ';
+    }
+
+    ASSERT_EQ("50 70 73 80 85 ", ss.str());
+}
+
+TEST(NotStdSetTestSuite, LopsidedTraversalTest) {
+    set<int, bst_order::pre_order_tag> pre_order = {5, 10, 7};
+    set<int, bst_order::post_order_tag> post_order = {5, 2, 3};
+
+    ASSERT_EQ(Forward(pre_order), std::vector<int>({5, 10, 7}));
+    ASSERT_EQ(Backward(pre_order), std::vector<int>({7, 10, 5}));
+    ASSERT_EQ(Forward(post_order), std::vector<int>({3, 2, 5}));
+    ASSERT_EQ(Backward(post_order), std::vector<int>({5, 2, 3}));
+}
+
+TEST(NotStdSetTestSuite, NthTest) {
+    ranked_set<int> my_set = {50, 30, 70, 23, 35, 80, 11, 25, 31, 42, 73, 85};
+
+    ASSERT_EQ(*my_set.nth(0), 11);
+    ASSERT_EQ(*my_set.nth(5), 35);
+    ASSERT_EQ(*my_set.nth(11), 85);
+    ASSERT_TRUE(my_set.nth(12) == my_set.end());
+}
+
+TEST(NotStdSetTestSuite, RankTest) {
+    ranked_set<int, bst_balance::none_tag> my_set = {50, 30, 70, 23, 35, 80, 11, 25, 31, 42, 73, 85};
+
+    ASSERT_EQ(my_set.rank(11), 0);
+    ASSERT_EQ(my_set.rank(12), 1);
+    ASSERT_EQ(my_set.rank(50), 7);
+    ASSERT_EQ(my_set.rank(100), 12);
+
+    ASSERT_EQ(my_set.count_range(23, 50), 6);
+    ASSERT_EQ(my_set.count_range(24, 24), 0);
+    ASSERT_EQ(my_set.count_range(70, 30), 0);
+}
+
+TEST(NotStdSetTestSuite, OrderStatisticAfterEraseTest) {
+    ranked_set<int> my_set;
+    std::vector<int> expected;
+
+    for (int i = 0; i < 1000; ++i) {
+        my_set.insert((i * 631) % 1009);
+    }
+    for (int i = 0; i < 1009; i += 4) {
+        my_set.erase(i);
+    }
+    my_set.extract(1);
+    my_set.erase(my_set.find(2));
+    for (int key : my_set) {
+        expected.push_back(key);
+    }
+
+    for (size_t k = 0; k < expected.size(); ++k) {
+        ASSERT_EQ(*my_set.nth(k), expected[k]);
+        ASSERT_EQ(my_set.rank(expected[k]), k);
+    }
+    ASSERT_EQ(my_set.count_range(100, 200), std::lower_bound(expected.begin(), expected.end(), 200) -
+                                                std::lower_bound(expected.begin(), expected.end(), 100));
+
+    ranked_set<int> copy(my_set);
+    ASSERT_EQ(*copy.nth(expected.size() / 2), expected[expected.size() / 2]);
+}
+
+TEST(NotStdSetTestSuite, SizeAfterModificationsTest) {
+    set<int> my_set = {1, 3, 6, 9, 10, 11, 14, 15};
+
+    my_set.insert(3);
+    my_set.erase(6);
+    my_set.erase(7);
+    my_set.extract(9);
+    my_set.erase(my_set.find(1));
+
+    ASSERT_EQ(my_set.size(), 5);
+
+    set<int> copy(my_set);
+
+    ASSERT_EQ(copy.size(), 5);
+
+    copy.clear();
+
+    ASSERT_EQ(copy.size(), 0);
+}
+
+TEST(NotStdSetTestSuite, EndIteratorSurvivesInsertTest) {
+    rb_set<int, bst_order::in_order_tag> my_set = {5};
+
+    rb_set<int, bst_order::in_order_tag>::iterator end = my_set.end();
+
+    for (int i = 0; i < 10; ++i) {
+        my_set.insert(i);
+    }
+
+    ASSERT_EQ(*--end, 9);
+    ASSERT_EQ(*my_set.begin(), 0);
+
+    my_set.erase(9);
+    my_set.erase(0);
+
+    ASSERT_EQ(*--my_set.end(), 8);
+    ASSERT_EQ(*my_set.begin(), 1);
+}
+
+TEST(NotStdSetTestSuite, PopMinMaxTest) {
+    rb_set<int, bst_order::in_order_tag> my_set = {50, 30, 70, 23, 35, 80, 11, 25, 31, 42, 73, 85};
+
+    ASSERT_EQ(my_set.pop_min(), 11);
+    ASSERT_EQ(my_set.pop_max(), 85);
+    ASSERT_EQ(my_set.pop_min(), 23);
+    ASSERT_EQ(my_set.size(), 9);
+    ASSERT_EQ(*my_set.begin(), 25);
+    ASSERT_EQ(*my_set.rbegin(), 80);
+
+    while (my_set.size() > 1) {
+        my_set.pop_max();
+    }
+
+    ASSERT_EQ(my_set.pop_max(), 25);
+    ASSERT_TRUE(my_set.empty());
+    ASSERT_TRUE(my_set.begin() == my_set.end());
+}
+
+TEST(NotStdSetTestSuite, MoveConstructorTest) {
+    set<std::string> set1 = {"a", "b", "c"};
+    set<std::string>::iterator first = set1.begin();
+
+    set<std::string> set2(std::move(set1));
+
+    ASSERT_TRUE(set1.empty());
+    ASSERT_EQ(set1.size(), 0);
+    ASSERT_EQ(set2.size(), 3);
+    ASSERT_TRUE(first == set2.begin());
+
+    set1.insert("d");
+
+    ASSERT_EQ(*set1.begin(), "d");
+}
+
+TEST(NotStdSetTestSuite, MoveAssignmentOperatorTest) {
+    set<std::string> set1 = {"a", "b", "c"};
+    set<std::string> set2 = {"x", "y"};
+
+    set2 = std::move(set1);
+
+    ASSERT_TRUE(set1.empty());
+    ASSERT_EQ(set2, set<std::string>({"a", "b", "c"}));
+}
+
+TEST(NotStdSetTestSuite, InsertRvalueTest) {
+    set<std::string> my_set;
+    std::string key(100, 'k');
+
+    ASSERT_TRUE(my_set.insert(std::move(key)).second);
+    ASSERT_TRUE(key.empty());
+    ASSERT_EQ(my_set.begin()->size(), 100);
+}
+
+TEST(NotStdSetTestSuite, EmplaceTest) {
+    set<Tracked, bst_order::in_order_tag, std::less<Tracked>, CountingAllocator<Tracked>> my_set;
+    Tracked::copies = 0;
+    Tracked::constructions = 0;
+    counted_allocations = 0;
+
+    ASSERT_TRUE(my_set.emplace(5).second);
+    ASSERT_TRUE(my_set.emplace(3).second);
+    ASSERT_FALSE(my_set.emplace(5).second);
+
+    ASSERT_EQ(Tracked::constructions, 3);
+    ASSERT_EQ(Tracked::copies, 0);
+    ASSERT_EQ(counted_allocations, 2);
+
+    ASSERT_FALSE(my_set.emplace(Tracked(3)).second);
+
+    ASSERT_EQ(Tracked::copies, 0);
+    ASSERT_EQ(counted_allocations, 2);
+    ASSERT_EQ(my_set.begin()->value, 3);
+}
+
+TEST(NotStdSetTestSuite, InsertHintTest) {
+    set<int> my_set = {10, 20, 30};
+
+    set<int>::iterator iter = my_set.insert(my_set.find(20), 15);
+
+    ASSERT_EQ(*iter, 15);
+
+    iter = my_set.insert(my_set.begin(), 5);
+
+    ASSERT_EQ(*iter, 5);
+
+    iter = my_set.insert(my_set.end(), 40);
+
+    ASSERT_EQ(*iter, 40);
+
+    iter = my_set.insert(my_set.find(10), 25);
+
+    ASSERT_EQ(*iter, 25);
+
+    iter = my_set.insert(my_set.begin(), 30);
+
+    ASSERT_TRUE(iter == my_set.find(30));
+
+    iter = my_set.emplace_hint(my_set.find(30), 27);
+
+    ASSERT_EQ(*iter, 27);
+    ASSERT_EQ(Forward(my_set), std::vector<int>({5, 10, 15, 20, 25, 27, 30, 40}));
+}
+
+TEST(NotStdSetTestSuite, InsertHintKeepsShapeTest) {
+    set<int, bst_order::pre_order_tag> my_set;
+    set<int, bst_order::pre_order_tag>::iterator hint = my_set.end();
+
+    for (int key : {50, 30, 70, 23, 35, 80, 11, 25, 31, 42, 73, 85}) {
+        hint = my_set.insert(hint, key);
+    }
+
+    ASSERT_EQ(Forward(my_set), std::vector<int>({50, 30, 23, 11, 25, 35, 31, 42, 70, 80, 73, 85}));
+}
+
+TEST(NotStdSetTestSuite, SortedRangeInsertComparisonsTest) {
+    std::vector<int> keys(100000);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = static_cast<int>(i);
+    }
+
+    set<int, bst_order::in_order_tag, CountingLess> my_set;
+    CountingLess::calls = 0;
+
+    my_set.insert(keys.begin(), keys.end());
+
+    ASSERT_EQ(my_set.size(), keys.size());
+    ASSERT_LE(CountingLess::calls, 2 * keys.size());
+
+    rb_set<int, bst_order::in_order_tag> balanced;
+    rb_set<int, bst_order::in_order_tag>::iterator hint = balanced.end();
+    for (int key : keys) {
+        hint = balanced.emplace_hint(hint, key);
+    }
+
+    ASSERT_EQ(balanced.size(), keys.size());
+}
+
+TEST(NotStdSetTestSuite, SortedRangeBuildIsBalancedTest) {
+    std::vector<int> keys;
+    for (int i = 0; i < 1000; ++i) {
+        keys.push_back(i * 2);
+    }
+
+    set<int, bst_order::pre_order_tag> my_set(keys.begin(), keys.end());
+
+    ASSERT_EQ(my_set.size(), keys.size());
+    ASSERT_EQ(HeightFromPreOrder(Forward(my_set)), 10);
+    ASSERT_EQ(*my_set.begin(), keys[499]);
+
+    set<int> sorted(keys.begin(), keys.end());
+
+    ASSERT_EQ(Forward(sorted), keys);
+    ASSERT_EQ(*--sorted.end(), keys.back());
+}
+
+TEST(NotStdSetTestSuite, SortedRangeBuildDuplicatesTest) {
+    std::vector<int> keys = {1, 1, 2, 3, 3, 3, 4, 9, 9};
+
+    ranked_set<int> my_set(keys.begin(), keys.end());
+
+    ASSERT_EQ(Forward(my_set), std::vector<int>({1, 2, 3, 4, 9}));
+    ASSERT_EQ(my_set.size(), 5);
+    ASSERT_EQ(*my_set.nth(3), 4);
+}
+
+TEST(NotStdSetTestSuite, SortedUniqueBuildTest) {
+    std::vector<int> keys(4095);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = static_cast<int>(i);
+    }
+
+    CountingLess::calls = 0;
+    set<int, bst_order::in_order_tag, CountingLess> my_set(sorted_unique, keys.begin(), keys.end());
+
+    ASSERT_EQ(CountingLess::calls, 0);
+    ASSERT_EQ(Forward(my_set), keys);
+
+    set<int> small(sorted_unique, {1, 2, 3});
+
+    ASSERT_EQ(Forward(small), std::vector<int>({1, 2, 3}));
+}
+
+TEST(NotStdSetTestSuite, RedBlackBulkBuildTest) {
+    for (int count : {1, 2, 3, 6, 7, 8, 100, 1000}) {
+        std::vector<int> keys;
+        for (int i = 0; i < count; ++i) {
+            keys.push_back(i * 3);
+        }
+
+        rb_set<int, bst_order::pre_order_tag> my_set(keys.begin(), keys.end());
+
+        for (int i = 0; i < count * 3; ++i) {
+            if (i % 3 == 0) {
+                my_set.erase(i);
+            } else {
+                my_set.insert(i);
+            }
+        }
+
+        std::vector<int> pre = Forward(my_set);
+        ASSERT_EQ(pre.size(), static_cast<size_t>(count * 2));
+        ASSERT_LE(HeightFromPreOrder(pre), 2 * std::bit_width(pre.size() + 1));
+    }
+}
+
+TEST(NotStdSetTestSuite, InitListAssignmentTest) {
+    set<int> my_set = {7, 8};
+
+    my_set = {1, 3, 6};
+
+    ASSERT_EQ(Forward(my_set), std::vector<int>({1, 3, 6}));
+
+    my_set = {6, 1, 3};
+
+    ASSERT_EQ(Forward(my_set), std::vector<int>({1, 3, 6}));
+    ASSERT_EQ(my_set.size(), 3);
+}
+
+TEST(NotStdSetTestSuite, TransparentLookupTest) {
+    set<std::string, bst_order::in_order_tag, std::less<>> my_set = {"apple", "banana", "cherry"};
+    std::string_view key = "banana";
+
+    ASSERT_EQ(*my_set.find(key), "banana");
+    ASSERT_TRUE(my_set.find(std::string_view("durian")) == my_set.end());
+    ASSERT_TRUE(my_set.contains(key));
+    ASSERT_EQ(my_set.count("cherry"), 1);
+    ASSERT_EQ(my_set.count(std::string_view("fig")), 0);
+    ASSERT_EQ(*my_set.upper_bound(std::string_view("b")), "banana");
+    ASSERT_EQ(*my_set.lower_bound(std::string_view("c")), "banana");
+
+    ASSERT_EQ(*my_set.find("apple"), "apple");
+    ASSERT_EQ(*my_set.upper_bound("b"), "banana");
+    ASSERT_EQ(*my_set.lower_bound("c"), "banana");
+    ASSERT_TRUE(my_set.equal_range("banana").first == my_set.find(key));
+}
+
+struct TrackedLess {
+    using is_transparent = void;
+
+    bool operator()(const Tracked& lhs, const Tracked& rhs) const {
+        return lhs.value < rhs.value;
+    }
+
+    bool operator()(const Tracked& lhs, int rhs) const {
+        return lhs.value < rhs;
+    }
+
+    bool operator()(int lhs, const Tracked& rhs) const {
+        return lhs < rhs.value;
+    }
+};
+
+TEST(NotStdSetTestSuite, TransparentLookupNoTemporariesTest) {
+    set<Tracked, bst_order::in_order_tag, TrackedLess, std::allocator<Tracked>, bst_balance::red_black_tag,
+        bst_augment::size_tag> my_set;
+    for (int i = 0; i < 100; ++i) {
+        my_set.emplace(i * 2);
+    }
+    Tracked::constructions = 0;
+    Tracked::copies = 0;
+
+    ASSERT_TRUE(my_set.contains(42));
+    ASSERT_FALSE(my_set.contains(43));
+    ASSERT_EQ(my_set.find(10)->value, 10);
+    ASSERT_EQ(my_set.rank(11), 6);
+    ASSERT_EQ(my_set.count_range(10, 20), 5);
+    ASSERT_EQ(my_set.equal_range(50).first->value, 50);
+
+    ASSERT_EQ(Tracked::constructions, 0);
+    ASSERT_EQ(Tracked::copies, 0);
+}
+
+TEST(NotStdSetTestSuite, DeepChainCopyAndDestroyTest) {
+    const int count = 10'000'000;
+
+    set<int, bst_order::post_order_tag> chain;
+    for (int i = 0; i < count; ++i) {
+        chain.insert(chain.end(), i);
+    }
+
+    ASSERT_EQ(*chain.begin(), count - 1);
+
+    {
+        set<int, bst_order::post_order_tag> copy(chain);
+
+        ASSERT_EQ(copy.size(), count);
+        ASSERT_EQ(*copy.begin(), count - 1);
+        ASSERT_EQ(*--copy.end(), 0);
+    }
+
+    chain.clear();
+
+    ASSERT_TRUE(chain.empty());
+    ASSERT_TRUE(chain.begin() == chain.end());
+}
+
+TEST(NotStdSetTestSuite, CopyKeepsShapeTest) {
+    rb_set<int, bst_order::pre_order_tag> my_set;
+    for (int i = 0; i < 500; ++i) {
+        my_set.insert((i * 37) % 503);
+    }
+
+    rb_set<int, bst_order::pre_order_tag> copy(my_set);
+
+    ASSERT_EQ(Forward(copy), Forward(my_set));
+    ASSERT_EQ(Backward(copy), Backward(my_set));
+
+    copy.insert(1000);
+    copy.erase(0);
+
+    ASSERT_EQ(copy.size(), my_set.size());
+    ASSERT_FALSE(my_set.contains(1000));
+}
+
+TEST(NotStdSetTestSuite, EraseIteratorComparisonsTest) {
+    set<int, bst_order::in_order_tag, CountingLess> my_set = {1, 3, 6, 9, 10, 11, 14, 15};
+    set<int, bst_order::in_order_tag, CountingLess>::iterator keep = my_set.find(14);
+    CountingLess::calls = 0;
+
+    my_set.erase(my_set.begin());
+    my_set.erase(my_set.begin());
+
+    ASSERT_EQ(CountingLess::calls, 0);
+    ASSERT_EQ(*keep, 14);
+    ASSERT_EQ(*my_set.begin(), 6);
+}
+
+TEST(NotStdSetTestSuite, RedBlackEraseRangeTest) {
+    for (int first = 0; first < 60; first += 7) {
+        for (int last = first; last <= 64; last += 5) {
+            ranked_set<int> my_set;
+            std::vector<int> expected;
+            for (int i = 0; i < 64; ++i) {
+                my_set.insert((i * 37) % 64);
+                if (i < first || i >= last) {
+                    expected.push_back(i);
+                }
+            }
+
+            ranked_set<int>::iterator iter = my_set.erase(my_set.find(first), my_set.find(last));
+
+            ASSERT_EQ(Forward(my_set), expected);
+            ASSERT_EQ(my_set.size(), expected.size());
+            ASSERT_TRUE(last == 64 ? iter == my_set.end() : *iter == last);
+            ASSERT_EQ(*--my_set.end(), expected.back());
+            for (size_t k = 0; k < expected.size(); ++k) {
+                ASSERT_EQ(*my_set.nth(k), expected[k]);
+            }
+        }
+    }
+}
+
+TEST(NotStdSetTestSuite, PreOrderEraseRangeTest) {
+    set<int, bst_order::pre_order_tag> my_set = {8, 4, 2, 6, 12, 10, 14};
+
+    set<int, bst_order::pre_order_tag>::iterator iter = my_set.erase(my_set.find(2), my_set.find(10));
+
+    ASSERT_EQ(Forward(my_set), std::vector<int>({8, 4, 14, 10}));
+    ASSERT_EQ(*iter, 10);
+}
+
+TEST(NotStdSetTestSuite, NodeHandleReinsertTest) {
+    using tracked_set = set<Tracked, bst_order::in_order_tag, std::less<Tracked>, CountingAllocator<Tracked>>;
+    tracked_set my_set;
+    for (int i = 0; i < 10; ++i) {
+        my_set.emplace(i);
+    }
+    counted_allocations = 0;
+    Tracked::copies = 0;
+
+    tracked_set::node_type node = my_set.extract(Tracked(3));
+    ASSERT_FALSE(node.empty());
+
+    node.value().value = 30;
+    tracked_set::insert_return_type result = my_set.insert(std::move(node));
+
+    ASSERT_TRUE(result.inserted);
+    ASSERT_TRUE(result.node.empty());
+    ASSERT_EQ(result.position->value, 30);
+
+    node = my_set.extract(my_set.find(Tracked(5)));
+    node.value().value = 4;
+    result = my_set.insert(std::move(node));
+
+    ASSERT_FALSE(result.inserted);
+    ASSERT_EQ(result.node.value().value, 4);
+    ASSERT_EQ(result.position->value, 4);
+
+    result.node.value().value = 5;
+    tracked_set::iterator iter = my_set.insert(my_set.find(Tracked(6)), std::move(result.node));
+
+    ASSERT_EQ(iter->value, 5);
+    ASSERT_EQ(my_set.size(), 10);
+    ASSERT_EQ(counted_allocations, 0);
+    ASSERT_EQ(Tracked::copies, 0);
+}
+
+TEST(NotStdSetTestSuite, MergeSplicesNodesTest) {
+    using tracked_set = set<Tracked, bst_order::in_order_tag, std::less<Tracked>, CountingAllocator<Tracked>,
+                            bst_balance::red_black_tag, bst_augment::size_tag>;
+    tracked_set my_set;
+    tracked_set other;
+    for (int i = 0; i < 1000; i += 2) {
+        my_set.emplace(i);
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        other.emplace(i);
+    }
+    counted_allocations = 0;
+    Tracked::copies = 0;
+
+    my_set.merge(other);
+
+    ASSERT_EQ(counted_allocations, 0);
+    ASSERT_EQ(Tracked::copies, 0);
+    ASSERT_EQ(my_set.size(), 500 + 334 - 167);
+    ASSERT_EQ(other.size(), 167);
+    for (size_t k = 0; k < other.size(); ++k) {
+        ASSERT_EQ(other.nth(k)->value, static_cast<int>(6 * k));
+    }
+
+    int previous = -1;
+    for (size_t k = 0; k < my_set.size(); ++k) {
+        int key = my_set.nth(k)->value;
+        ASSERT_LT(previous, key);
+        ASSERT_TRUE(key % 2 == 0 || key % 3 == 0);
+        previous = key;
+    }
+}
+
+TEST(NotStdSetTestSuite, MergeAllocationThrowTest) {
+    using budget_set = set<int, bst_order::in_order_tag, std::less<int>, BudgetAllocator<int>>;
+    budget_set my_set(BudgetAllocator<int>(1));
+    budget_set other(BudgetAllocator<int>(2));
+    for (int i = 0; i < 10; ++i) {
+        my_set.insert(2 * i);
+        other.insert(2 * i + 1);
+    }
+
+    allocation_budget = 4;
+    ASSERT_THROW(my_set.merge(other), std::bad_alloc);
+    allocation_budget = -1;
+
+    ASSERT_EQ(my_set.size(), 14);
+    ASSERT_EQ(other.size(), 6);
+    ASSERT_EQ(*other.begin(), 9);
+}
+
+TEST(NotStdSetTestSuite, SetAlgebraTest) {
+    using algebra_set = set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                            bst_balance::red_black_tag, bst_augment::size_tag>;
+    algebra_set evens;
+    algebra_set threes;
+    for (int i = 0; i < 3000; i += 2) {
+        evens.insert(i);
+    }
+    for (int i = 0; i < 3000; i += 3) {
+        threes.insert(i);
+    }
+
+    std::vector<int> united;
+    std::vector<int> common;
+    std::vector<int> rest;
+    for (int i = 0; i < 3000; ++i) {
+        if (i % 2 == 0 || i % 3 == 0) {
+            united.push_back(i);
+        }
+        if (i % 6 == 0) {
+            common.push_back(i);
+        }
+        if (i % 2 == 0 && i % 3 != 0) {
+            rest.push_back(i);
+        }
+    }
+
+    algebra_set result = set_union(evens, threes);
+    ASSERT_EQ(Forward(result), united);
+    ASSERT_EQ(result.size(), united.size());
+    ASSERT_EQ(*result.nth(united.size() / 2), united[united.size() / 2]);
+
+    result = set_intersection(evens, threes);
+    ASSERT_EQ(Forward(result), common);
+    ASSERT_EQ(result.size(), common.size());
+
+    result = set_difference(evens, threes);
+    ASSERT_EQ(Forward(result), rest);
+    ASSERT_EQ(*--result.end(), rest.back());
+
+    algebra_set small = {4, 5, 7000};
+    evens.unite(small);
+    ASSERT_TRUE(small.empty());
+    ASSERT_EQ(evens.size(), 1502);
+    ASSERT_EQ(*--evens.end(), 7000);
+}
+
+TEST(NotStdSetTestSuite, ParallelSetAlgebraTest) {
+    thread_pool pool(3);
+    rb_set<int, bst_order::in_order_tag> lhs;
+    rb_set<int, bst_order::in_order_tag> rhs;
+    std::vector<int> common;
+    for (int i = 0; i < 100000; ++i) {
+        lhs.insert(i * 2);
+        rhs.insert(i * 5);
+        if (i % 5 == 0) {
+            common.push_back(i * 2);
+        }
+    }
+
+    rb_set<int, bst_order::in_order_tag> result = set_intersection(lhs, rhs, pool);
+    ASSERT_EQ(Forward(result), common);
+    ASSERT_EQ(result.size(), common.size());
+
+    lhs.unite(rhs, pool);
+    ASSERT_EQ(lhs.size(), 100000 + 100000 - 20000);
+    ASSERT_TRUE(rhs.empty());
+}
+
+TEST(NotStdSetTestSuite, ParallelBulkBuildTest) {
+    thread_pool pool(3);
+    for (int count : {0, 1, 7, 1000, 200000}) {
+        std::vector<int> keys;
+        for (int i = 0; i < count; ++i) {
+            keys.push_back(i * 7919 % (count / 3 + 1));
+        }
+        std::vector<int> expected(keys);
+        std::sort(expected.begin(), expected.end());
+        expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+
+        ranked_set<int> sequenced(execution::seq, keys.begin(), keys.end());
+        ranked_set<int> parallel(execution::par(pool), keys.begin(), keys.end());
+        ASSERT_EQ(Forward(sequenced), expected);
+        ASSERT_EQ(Forward(parallel), expected);
+        ASSERT_EQ(parallel.size(), expected.size());
+        if (!expected.empty()) {
+            ASSERT_EQ(*parallel.nth(expected.size() / 2), expected[expected.size() / 2]);
+        }
+
+        rb_set<int, bst_order::pre_order_tag> shaped(execution::par(pool), keys.begin(), keys.end());
+        std::vector<int> pre = Forward(shaped);
+        ASSERT_EQ(pre.size(), expected.size());
+        ASSERT_EQ(HeightFromPreOrder(pre), static_cast<size_t>(std::bit_width(pre.size())));
+
+        for (int i = 0; i < count; i += 2) {
+            shaped.insert(-i);
+            shaped.erase(i);
+        }
+        ASSERT_LE(HeightFromPreOrder(Forward(shaped)), 2 * std::bit_width(shaped.size() + 1));
+    }
+}
+
+TEST(NotStdSetTestSuite, ParallelBulkBuildThrowTest) {
+    using budget_set = set<int, bst_order::in_order_tag, std::less<int>, BudgetAllocator<int>>;
+    thread_pool pool(2);
+    std::vector<int> keys;
+    for (int i = 0; i < 1000; ++i) {
+        keys.push_back(999 - i);
+    }
+
+    allocation_budget = 500;
+    ASSERT_THROW(budget_set(execution::par(pool), keys.begin(), keys.end()), std::bad_alloc);
+    allocation_budget = -1;
+
+    budget_set my_set(execution::par(pool), keys.begin(), keys.end());
+    ASSERT_EQ(my_set.size(), 1000);
+    ASSERT_EQ(*my_set.begin(), 0);
+}
+
+template<class Order>
+static void CheckPolicyScans(thread_pool& pool) {
+    for (int count : {0, 1, 5, 4000}) {
+        rb_set<int, Order> my_set;
+        set<int, Order> chain;
+        for (int i = 0; i < count; ++i) {
+            my_set.insert(i * 7919 % count);
+            chain.insert(i);
+        }
+
+        std::vector<int> visited;
+        for_each(execution::seq, my_set, [&](int key) { visited.push_back(key); });
+        ASSERT_EQ(visited, Forward(my_set));
+
+        auto append = [](std::vector<int> lhs, const std::vector<int>& rhs) {
+            lhs.insert(lhs.end(), rhs.begin(), rhs.end());
+            return lhs;
+        };
+        auto wrap = [](int key) { return std::vector<int>{key}; };
+        ASSERT_EQ(transform_reduce(execution::seq, chain, std::vector<int>(), append, wrap), Forward(chain));
+
+        long expected = static_cast<long>(count) * (count - 1) / 2;
+        std::atomic<long> sum = 0;
+        std::atomic<int> calls = 0;
+        for_each(execution::par(pool), my_set, [&](int key) {
+            sum += key;
+            ++calls;
+        });
+        ASSERT_EQ(sum, expected);
+        ASSERT_EQ(calls, count);
+
+        std::atomic<long> chain_sum = 0;
+        chain.for_each(execution::par(pool), [&](int key) { chain_sum += key; });
+        ASSERT_EQ(chain_sum, expected);
+
+        long squares = transform_reduce(execution::par(pool), my_set, 0L, std::plus<>(),
+                                        [](int key) { return static_cast<long>(key) * key; });
+        ASSERT_EQ(squares, static_cast<long>(count) * (count - 1) * (2L * count - 1) / 6);
+    }
+}
+
+TEST(NotStdSetTestSuite, PolicyScanTest) {
+    thread_pool pool(3);
+    CheckPolicyScans<bst_order::in_order_tag>(pool);
+    CheckPolicyScans<bst_order::pre_order_tag>(pool);
+    CheckPolicyScans<bst_order::post_order_tag>(pool);
+
+    rb_set<int, bst_order::in_order_tag> my_set;
+    for (int i = 0; i < 5000; ++i) {
+        my_set.insert(i);
+    }
+    auto append = [](std::vector<int> lhs, const std::vector<int>& rhs) {
+        lhs.insert(lhs.end(), rhs.begin(), rhs.end());
+        return lhs;
+    };
+    auto wrap = [](int key) { return std::vector<int>{key}; };
+    ASSERT_EQ(transform_reduce(execution::par(pool), my_set, std::vector<int>{-1}, append, wrap),
+              append({-1}, Forward(my_set)));
+}
+
+template<class Set>
+static std::string Serialized(const Set& my_set) {
+    std::stringstream out;
+    my_set.serialize(out);
+    return out.str();
+}
+
+TEST(NotStdSetTestSuite, SerializeRoundTripTest) {
+    rb_set<int, bst_order::pre_order_tag> my_set;
+    for (int i = 0; i < 5000; ++i) {
+        my_set.insert(i * 7919 % 6007);
+        if (i % 3 == 0) {
+            my_set.erase(i * 31 % 6007);
+        }
+    }
+
+    std::string bytes = Serialized(my_set);
+    ASSERT_EQ(bytes.size(), my_set.serialized_size());
+
+    rb_set<int, bst_order::pre_order_tag> loaded = {1, 2, 3};
+    std::stringstream in(bytes);
+    loaded.deserialize(in);
+    ASSERT_EQ(Forward(loaded), Forward(my_set));
+    ASSERT_EQ(Backward(loaded), Backward(my_set));
+    ASSERT_EQ(Serialized(loaded), bytes);
+
+    std::vector<std::byte> buffer(my_set.serialized_size());
+    my_set.serialize(std::span<std::byte>(buffer));
+    ASSERT_EQ(std::string(reinterpret_cast<const char*>(buffer.data()), buffer.size()), bytes);
+
+    rb_set<int, bst_order::pre_order_tag> from_span;
+    from_span.deserialize(std::span<const std::byte>(buffer));
+    ASSERT_EQ(Forward(from_span), Forward(my_set));
+
+    for (int i = 0; i < 6007; i += 2) {
+        from_span.insert(i);
+        from_span.erase(i + 1);
+    }
+    ASSERT_LE(HeightFromPreOrder(Forward(from_span)), 2 * std::bit_width(from_span.size() + 1));
+
+    rb_set<int, bst_order::pre_order_tag> empty;
+    std::stringstream empty_in(Serialized(empty));
+    loaded.deserialize(empty_in);
+    ASSERT_TRUE(loaded.empty());
+}
+
+// Four-byte keys and odd counts put the boundaries between header, keys and shape in the middle of checksum words.
+TEST(NotStdSetTestSuite, SerializeSmallCountsTest) {
+    for (int count = 0; count <= 17; ++count) {
+        set<int32_t> my_set;
+        for (int32_t i = 0; i < count; ++i) {
+            my_set.insert(i * 5 % 17);
+        }
+
+        set<int32_t> loaded;
+        std::stringstream in(Serialized(my_set));
+        loaded.deserialize(in);
+        ASSERT_TRUE(loaded == my_set);
+
+        std::vector<std::byte> buffer(my_set.serialized_size());
+        my_set.serialize(std::span<std::byte>(buffer));
+        set<int32_t> from_span;
+        from_span.deserialize(std::span<const std::byte>(buffer));
+        ASSERT_TRUE(from_span == my_set);
+    }
+}
+
+TEST(NotStdSetTestSuite, SerializeAugmentsAndThreadsTest) {
+    using threaded_set = set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                             bst_balance::red_black_tag, bst_augment::size_tag, bst_thread::threaded_tag>;
+    threaded_set my_set;
+    for (int i = 0; i < 1000; ++i) {
+        my_set.insert(i * 37 % 1000);
+    }
+
+    std::stringstream in(Serialized(my_set));
+    threaded_set loaded;
+    loaded.deserialize(in);
+    ASSERT_EQ(Forward(loaded), Forward(my_set));
+    ASSERT_EQ(Backward(loaded), Backward(my_set));
+    ASSERT_EQ(*loaded.nth(500), 500);
+    ASSERT_EQ(loaded.rank(750), 750);
+
+    // An unbalanced chain reloads without recursion and without a single comparison.
+    set<int, bst_order::in_order_tag, CountingLess> chain;
+    for (int i = 0; i < 100000; ++i) {
+        chain.insert(chain.cend(), i);
+    }
+    std::stringstream chain_in(Serialized(chain));
+    set<int, bst_order::in_order_tag, CountingLess> chain_loaded;
+    CountingLess::calls = 0;
+    chain_loaded.deserialize(chain_in);
+    ASSERT_EQ(CountingLess::calls, 0);
+    ASSERT_EQ(chain_loaded.size(), 100000);
+    ASSERT_EQ(*--chain_loaded.end(), 99999);
+}
+
+TEST(NotStdSetTestSuite, SerializeWithKeyCodecTest) {
+    set<std::string> my_set = {"pear", "apple", "", "fig", "banana"};
+    std::stringstream out;
+    my_set.serialize(out, [](const std::string& key, auto& write) {
+        char size = static_cast<char>(key.size());
+        write(&size, 1);
+        write(key.data(), key.size());
+    });
+
+    set<std::string> loaded;
+    std::stringstream in(out.str());
+    loaded.deserialize(in, [](std::string_view& bytes) {
+        if (bytes.empty() || bytes.size() <= static_cast<size_t>(bytes[0])) {
+            throw std::invalid_argument("short key");
+        }
+        std::string key(bytes.substr(1, static_cast<size_t>(bytes[0])));
+        bytes.remove_prefix(key.size() + 1);
+        return key;
+    });
+    ASSERT_TRUE(loaded == my_set);
+
+    // A key reader that throws partway leaves the half-linked nodes freed and the target as it was.
+    for (int fail_at = 0; fail_at < 5; ++fail_at) {
+        std::stringstream again(out.str());
+        int read = 0;
+        ASSERT_THROW(loaded.deserialize(again, [&](std::string_view& bytes) {
+            if (read++ == fail_at) {
+                throw std::runtime_error("reader failed");
+            }
+            std::string key(bytes.substr(1, static_cast<size_t>(bytes[0])));
+            bytes.remove_prefix(key.size() + 1);
+            return key;
+        }), std::runtime_error);
+        ASSERT_TRUE(loaded == my_set);
+    }
+}
+
+TEST(NotStdSetTestSuite, DeserializeRejectsCorruptInputTest) {
+    rb_set<int, bst_order::in_order_tag> my_set;
+    for (int i = 0; i < 100; ++i) {
+        my_set.insert(i * 3);
+    }
+    std::string bytes = Serialized(my_set);
+
+    rb_set<int, bst_order::in_order_tag> target = {7, 8};
+    for (size_t pos : {size_t(0), size_t(4), size_t(16), size_t(24), size_t(33), bytes.size() - 9, bytes.size() - 1}) {
+        std::string damaged = bytes;
+        damaged[pos] ^= 0x10;
+        std::stringstream in(damaged);
+        ASSERT_THROW(target.deserialize(in), std::invalid_argument);
+        ASSERT_THROW(target.deserialize(std::span<const std::byte>(
+                reinterpret_cast<const std::byte*>(damaged.data()), damaged.size())), std::invalid_argument);
+    }
+
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 3));
+    ASSERT_THROW(target.deserialize(truncated), std::invalid_argument);
+    ASSERT_EQ(Forward(target), std::vector<int>({7, 8}));
+
+    set<int> unbalanced = {2, 1, 3};
+    std::stringstream uncoloured(Serialized(unbalanced));
+    ASSERT_THROW(target.deserialize(uncoloured), std::invalid_argument);
+
+    std::stringstream coloured(bytes);
+    unbalanced.deserialize(coloured);
+    ASSERT_EQ(Forward(unbalanced), Forward(my_set));
+}
+
+TEST(NotStdSetTestSuite, SplitConcatTest) {
+    set<int> my_set = {1, 3, 6, 9, 10, 11, 14, 15};
+
+    set<int> upper = my_set.split(10);
+
+    ASSERT_EQ(Forward(my_set), std::vector<int>({1, 3, 6, 9}));
+    ASSERT_EQ(Forward(upper), std::vector<int>({10, 11, 14, 15}));
+    ASSERT_EQ(my_set.size(), 4);
+    ASSERT_EQ(upper.size(), 4);
+    ASSERT_EQ(*--my_set.end(), 9);
+    ASSERT_EQ(*upper.begin(), 10);
+
+    my_set.insert(7);
+    upper.erase(15);
+    my_set.concat(upper);
+
+    ASSERT_TRUE(upper.empty());
+    ASSERT_EQ(Forward(my_set), std::vector<int>({1, 3, 6, 7, 9, 10, 11, 14}));
+    ASSERT_EQ(my_set.size(), 8);
+
+    set<int> empty_upper = my_set.split(100);
+    ASSERT_TRUE(empty_upper.empty());
+    ASSERT_EQ(my_set.size(), 8);
+}
+
+TEST(NotStdSetTestSuite, SplitCountsPiecesTest) {
+    set<int> my_set;
+    for (int i = 0; i < 100; ++i) {
+        my_set.insert((i * 37) % 100);
+    }
+
+    set<int> upper = my_set.split(90);
+    set<int> top = upper.split(99);
+    const set<int>& view = my_set;
+
+    ASSERT_EQ(view.size(), 90);
+    ASSERT_EQ(upper.size(), 9);
+    ASSERT_EQ(top.size(), 1);
+
+    set<int> lower = std::move(my_set);
+    my_set = lower.split(3);
+    ASSERT_EQ(lower.size(), 3);
+    ASSERT_EQ(my_set.size(), 87);
+    ASSERT_EQ(lower.split(-1).size(), 3);
+    ASSERT_EQ(lower.size(), 0);
+}
+
+TEST(NotStdSetTestSuite, RedBlackSplitConcatTest) {
+    ranked_set<int> my_set;
+    for (int i = 0; i < 10000; ++i) {
+        my_set.insert(i);
+    }
+
+    ranked_set<int> upper = my_set.split(2500);
+    ranked_set<int> middle = my_set.split(1000);
+
+    ASSERT_EQ(my_set.size(), 1000);
+    ASSERT_EQ(middle.size(), 1500);
+    ASSERT_EQ(upper.size(), 7500);
+    ASSERT_EQ(*middle.nth(0), 1000);
+    ASSERT_EQ(*upper.nth(7499), 9999);
+
+    ranked_set<int> joined = concat(std::move(middle), std::move(upper));
+    my_set.concat(joined);
+
+    ASSERT_EQ(my_set.size(), 10000);
+    for (size_t k = 0; k < my_set.size(); k += 97) {
+        ASSERT_EQ(*my_set.nth(k), static_cast<int>(k));
+    }
+    ASSERT_EQ(*--my_set.end(), 9999);
+}
+
+TEST(NotStdSetTestSuite, SplitKeepsBalanceTest) {
+    rb_set<int, bst_order::pre_order_tag> my_set;
+    for (int i = 0; i < 4096; ++i) {
+        my_set.insert(i);
+    }
+
+    rb_set<int, bst_order::pre_order_tag> upper = my_set.split(1000);
+
+    ASSERT_LE(HeightFromPreOrder(Forward(my_set)), 2 * 10);
+    ASSERT_LE(HeightFromPreOrder(Forward(upper)), 2 * 12);
+    ASSERT_EQ(my_set.size(), 1000);
+    ASSERT_EQ(upper.size(), 3096);
+}
+
+TEST(NotStdSetTestSuite, ThreadedIterationTest) {
+    using threaded_set = set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                             bst_balance::red_black_tag, bst_augment::none_tag, bst_thread::threaded_tag>;
+    threaded_set my_set;
+    std::vector<int> expected;
+    for (int i = 0; i < 1000; ++i) {
+        my_set.insert((i * 7) % 1000);
+        if (i % 3 != 0 && (i < 100 || i >= 200)) {
+            expected.push_back(i);
+        }
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        my_set.erase(i);
+    }
+    my_set.erase(my_set.find(100), my_set.find(200));
+
+    ASSERT_EQ(Forward(my_set), expected);
+    ASSERT_EQ(Backward(my_set), std::vector<int>(expected.rbegin(), expected.rend()));
+
+    threaded_set upper = my_set.split(500);
+    threaded_set other = {5000, 5001};
+    upper.unite(other);
+    my_set.concat(upper);
+    expected.push_back(5000);
+    expected.push_back(5001);
+
+    ASSERT_EQ(Forward(my_set), expected);
+    ASSERT_EQ(Backward(my_set), std::vector<int>(expected.rbegin(), expected.rend()));
+
+    threaded_set copy(my_set);
+    ASSERT_EQ(Forward(copy), expected);
+}
+
+TEST(NotStdSetTestSuite, ThreadedMergeTest) {
+    using threaded_set = set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                             bst_balance::none_tag, bst_augment::none_tag, bst_thread::threaded_tag>;
+    threaded_set my_set = {1, 3, 5, 7, 9};
+    threaded_set other = {0, 2, 3, 4, 10};
+
+    my_set.merge(other);
+    ASSERT_EQ(Forward(my_set), std::vector<int>({0, 1, 2, 3, 4, 5, 7, 9, 10}));
+    ASSERT_EQ(Backward(my_set), std::vector<int>({10, 9, 7, 5, 4, 3, 2, 1, 0}));
+    ASSERT_EQ(Forward(other), std::vector<int>({3}));
+
+    my_set.insert(my_set.find(7), 6);
+    my_set.insert(my_set.extract(10));
+    ASSERT_EQ(my_set.pop_min(), 0);
+    ASSERT_EQ(my_set.pop_max(), 10);
+    ASSERT_EQ(Forward(my_set), std::vector<int>({1, 2, 3, 4, 5, 6, 7, 9}));
+    ASSERT_EQ(Backward(my_set), std::vector<int>({9, 7, 6, 5, 4, 3, 2, 1}));
+}
+
+TEST(NotStdSetTestSuite, ThreadedSetAlgebraTest) {
+    using threaded_set = set<int, bst_order::in_order_tag, std::less<int>, std::allocator<int>,
+                             bst_balance::red_black_tag, bst_augment::none_tag, bst_thread::threaded_tag>;
+    threaded_set evens;
+    threaded_set threes;
+    threaded_set fives;
+    for (int i = 0; i < 300; ++i) {
+        evens.insert(2 * i);
+        threes.insert(3 * i);
+        fives.insert(5 * i);
+    }
+
+    std::vector<int> expected;
+    for (int i = 0; i < 900; ++i) {
+        if ((i % 2 == 0 && i < 600) || i % 3 == 0) {
+            if (!(i % 5 == 0 && i < 1500)) {
+                expected.push_back(i);
+            }
+        }
+    }
+
+    evens.unite(threes);
+    evens.subtract(fives);
+
+    ASSERT_EQ(Forward(evens), expected);
+    ASSERT_EQ(Backward(evens), std::vector<int>(expected.rbegin(), expected.rend()));
+
+    threaded_set odds;
+    for (int i = 1; i < 900; i += 2) {
+        odds.insert(i);
+    }
+    evens.intersect(odds);
+    expected.erase(std::remove_if(expected.begin(), expected.end(), [](int key) { return key % 2 == 0; }),
+                   expected.end());
+
+    ASSERT_EQ(Forward(evens), expected);
+    ASSERT_EQ(Backward(evens), std::vector<int>(expected.rbegin(), expected.rend()));
+}
+
+TEST(NotStdSetTestSuite, SortedBuildThrowTest) {
+    std::vector<Fragile> sorted;
+    for (int i = 0; i < 100; ++i) {
+        sorted.emplace_back(i);
+    }
+
+    Fragile::copies_left = 50;
+    ASSERT_THROW((set<Fragile>(sorted.begin(), sorted.end())), std::runtime_error);
+    Fragile::copies_left = -1;
+
+    ASSERT_EQ(Fragile::live, 100);
+}
+
+TEST(NotStdSetTestSuite, BatchLookupTest) {
+    rb_set<int, bst_order::pre_order_tag> my_set;
+    for (int i = 0; i < 1000; i += 3) {
+        my_set.insert(i);
+    }
+
+    // More keys than one batch holds, and a ragged last batch.
+    std::vector<int> keys;
+    for (int i = -5; i < 1005; i += 2) {
+        keys.push_back(i);
+    }
+
+    std::vector<decltype(my_set)::const_iterator> found(keys.size(), my_set.cend());
+    std::unique_ptr<bool[]> contained(new bool[keys.size()]);
+    my_set.find_batch(keys, found);
+    my_set.contains_batch(keys, std::span<bool>(contained.get(), keys.size()));
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_TRUE(found[i] == my_set.find(keys[i]));
+        ASSERT_EQ(contained[i], my_set.contains(keys[i]));
+    }
+
+    rb_set<int, bst_order::in_order_tag> empty;
+    empty.contains_batch(keys, std::span<bool>(contained.get(), keys.size()));
+    ASSERT_FALSE(contained[0]);
+}
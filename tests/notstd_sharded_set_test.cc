@@ -0,0 +1,99 @@
+#include <lib/notstd/concurrent/sharded_set.h>
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace notstd;
+
+// A capacity of 16 keeps shards splitting and merging all through the run.
+TEST(NotStdShardedSetTestSuite, MatchesStdSetTest) {
+    sharded_set<int> my_set(16);
+    std::set<int> expected;
+    std::mt19937 random(3);
+
+    for (int i = 0; i < 20000; ++i) {
+        int key = static_cast<int>(random() % 1000);
+        if (random() % 2 == 0) {
+            ASSERT_EQ(my_set.erase(key), expected.erase(key));
+        } else {
+            ASSERT_EQ(my_set.insert(key), expected.insert(key).second);
+        }
+    }
+
+    ASSERT_EQ(my_set.size(), expected.size());
+    ASSERT_GT(my_set.shard_count(), 1);
+    std::vector<int> visited;
+    my_set.for_each([&](int key) { visited.push_back(key); });
+    ASSERT_EQ(visited, std::vector<int>(expected.begin(), expected.end()));
+
+    auto view = my_set.read();
+    ASSERT_EQ(std::vector<int>(view.begin(), view.end()), visited);
+    ASSERT_EQ(std::vector<int>(std::make_reverse_iterator(view.end()), std::make_reverse_iterator(view.begin())),
+              std::vector<int>(expected.rbegin(), expected.rend()));
+
+    for (int key = -1; key <= 1000; ++key) {
+        ASSERT_EQ(view.contains(key), expected.count(key) == 1);
+
+        auto above = expected.lower_bound(key);
+        auto upper = view.upper_bound(key);
+        ASSERT_EQ(upper == view.end(), above == expected.end());
+        ASSERT_TRUE(above == expected.end() || *upper == *above);
+
+        auto not_above = expected.upper_bound(key);
+        auto lower = view.lower_bound(key);
+        ASSERT_EQ(lower == view.end(), not_above == expected.begin());
+        ASSERT_TRUE(not_above == expected.begin() || *lower == *std::prev(not_above));
+    }
+}
+
+TEST(NotStdShardedSetTestSuite, PointBoundsCrossShardsTest) {
+    const std::string bounds[] = {"b", "d", "f"};
+    sharded_set<std::string> my_set(std::begin(bounds), std::end(bounds));
+    my_set.insert("a");
+    my_set.insert("g");
+
+    ASSERT_EQ(my_set.shard_count(), 4);
+    ASSERT_EQ(my_set.lower_bound("e"), "a");
+    ASSERT_EQ(my_set.upper_bound("b"), "g");
+    ASSERT_EQ(my_set.lower_bound("0"), std::nullopt);
+    ASSERT_EQ(my_set.upper_bound("h"), std::nullopt);
+
+    auto view = my_set.read();
+    ASSERT_EQ(*view.find("g"), "g");
+    ASSERT_TRUE(view.find("c") == view.end());
+    ASSERT_EQ(*++view.find("a"), "g");
+}
+
+// Writers fill and then half empty their own slices of the key space while shards split and merge under them.
+TEST(NotStdShardedSetTestSuite, ParallelWritersTest) {
+    const int threads = 4;
+    const int keys = 40000;
+    sharded_set<int> my_set(256);
+
+    std::vector<std::thread> writers;
+    for (int thread = 0; thread < threads; ++thread) {
+        writers.emplace_back([&, thread] {
+            for (int i = thread; i < keys; i += threads) {
+                my_set.insert(i * 7919 % keys);
+            }
+            for (int i = thread; i < keys; i += 2 * threads) {
+                my_set.erase(i * 7919 % keys);
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+
+    ASSERT_EQ(my_set.size(), keys / 2);
+    for (int i = 0; i < keys; ++i) {
+        ASSERT_EQ(my_set.contains(i * 7919 % keys), (i % (2 * threads)) >= threads);
+    }
+    auto view = my_set.read();
+    ASSERT_TRUE(std::is_sorted(view.begin(), view.end()));
+    ASSERT_EQ(std::distance(view.begin(), view.end()), keys / 2);
+}
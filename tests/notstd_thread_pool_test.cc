@@ -0,0 +1,49 @@
+#include <lib/notstd/thread_pool.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+
+using namespace notstd;
+
+static long ForkSum(thread_pool& pool, long lo, long hi) {
+    if (hi - lo < 1000) {
+        long sum = 0;
+        for (long i = lo; i < hi; ++i) {
+            sum += i;
+        }
+        return sum;
+    }
+
+    long mid = lo + (hi - lo) / 2;
+    long left = 0;
+    long right = 0;
+    pool.fork_join([&] { left = ForkSum(pool, lo, mid); }, [&] { right = ForkSum(pool, mid, hi); });
+
+    return left + right;
+}
+
+TEST(NotStdThreadPoolTestSuite, NestedForkJoinTest) {
+    thread_pool pool(3);
+
+    ASSERT_EQ(pool.size(), 3);
+    ASSERT_EQ(ForkSum(pool, 0, 1000000), 999999L * 1000000 / 2);
+}
+
+TEST(NotStdThreadPoolTestSuite, NoWorkersTest) {
+    thread_pool pool(0);
+    std::atomic<int> calls = 0;
+
+    pool.fork_join([&] { ++calls; }, [&] { ++calls; });
+
+    ASSERT_EQ(calls, 2);
+}
+
+TEST(NotStdThreadPoolTestSuite, ExceptionTest) {
+    thread_pool pool(2);
+    bool left_done = false;
+
+    ASSERT_THROW(pool.fork_join([&] { left_done = true; }, [] { throw std::runtime_error("right"); }),
+                 std::runtime_error);
+    ASSERT_TRUE(left_done);
+}